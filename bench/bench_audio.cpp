@@ -0,0 +1,153 @@
+#include <benchmark/benchmark.h>
+extern "C" {
+    #include <libavutil/opt.h>
+    #include <libswresample/swresample.h>
+}
+#include "audio_kernels.hpp"
+#include "time_stretch.hpp"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// WSOLA cost per second of 48 kHz input, fed in decoder-sized blocks.
+// Args: channels, tempo in percent. x_realtime is seconds of output audio produced per
+// second of CPU; anything well above 1 keeps up on one core.
+static void BM_TimeStretch(benchmark::State& state) {
+    const int sampleRate = 48000;
+    const int block = 1024;
+    const int channels = static_cast<int>(state.range(0));
+    const double tempo = state.range(1) / 100.0;
+
+    // Tones plus noise, different per channel, so the similarity search has real work
+    std::vector<std::vector<float>> input(channels, std::vector<float>(sampleRate));
+    uint32_t seed = 1;
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < sampleRate; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            float noise = static_cast<float>(seed >> 8) / (1 << 24) - 0.5f;
+            input[c][i] = 0.4f * std::sin(2.0 * M_PI * (220.0 + 55.0 * c) * i / sampleRate) +
+                          0.2f * std::sin(2.0 * M_PI * 1375.0 * i / sampleRate) + 0.1f * noise;
+        }
+    }
+    std::vector<std::vector<float>> output(channels, std::vector<float>(4 * block));
+    std::vector<const float*> in(channels);
+    std::vector<float*> out(channels);
+    for (int c = 0; c < channels; c++) {
+        out[c] = output[c].data();
+    }
+
+    TimeStretcher stretcher(sampleRate, channels);
+    stretcher.setTempo(tempo);
+    int64_t produced = 0;
+    for (auto _ : state) {
+        for (int position = 0; position + block <= sampleRate; position += block) {
+            for (int c = 0; c < channels; c++) {
+                in[c] = input[c].data() + position;
+            }
+            stretcher.push(in.data(), block);
+            while (int count = stretcher.pull(out.data(), 4 * block)) {
+                produced += count;
+            }
+        }
+        benchmark::DoNotOptimize(output[0].data());
+    }
+    state.counters["x_realtime"] = benchmark::Counter(static_cast<double>(produced) / sampleRate,
+                                                      benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(state.iterations() * int64_t(sampleRate / block) * block);
+}
+
+static void timeStretchArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"channels", "tempo"});
+    for (int channels : {2, 6, 8}) {
+        for (int tempo : {50, 150, 200}) {
+            benchmark->Args({channels, tempo});
+        }
+    }
+}
+BENCHMARK(BM_TimeStretch)->Apply(timeStretchArguments)->Unit(benchmark::kMillisecond);
+
+static std::vector<std::vector<float>> makeSurround(int channels, int frames) {
+    std::vector<std::vector<float>> planes(channels, std::vector<float>(frames));
+    for (int c = 0; c < channels; c++) {
+        for (int i = 0; i < frames; i++) {
+            planes[c][i] = 0.5f * std::sin(0.01f * (c + 1) * i);
+        }
+    }
+    return planes;
+}
+
+// 5.1/7.1 planar float -> stereo planar float through the SIMD kernel, one 1024-sample
+// frame per iteration. Arg: source channels.
+static void BM_DownmixKernel(benchmark::State& state) {
+    const int channels = static_cast<int>(state.range(0));
+    const int frames = 1024;
+    std::vector<std::vector<float>> in = makeSurround(channels, frames);
+    std::vector<float> left(frames), right(frames);
+    // Native 5.1 / 7.1 order: FL FR FC LFE BL BR [SL SR]
+    StereoDownmix mix;
+    mix.frontLeft = in[0].data();
+    mix.frontRight = in[1].data();
+    mix.centre = in[2].data();
+    mix.surroundLeft[0] = in[4].data();
+    mix.surroundRight[0] = in[5].data();
+    mix.surroundPairs = 1;
+    if (channels == 8) {
+        mix.surroundLeft[1] = in[6].data();
+        mix.surroundRight[1] = in[7].data();
+        mix.surroundPairs = 2;
+    }
+    mix.centreGain = mix.surroundGain = 0.7071f;
+    for (auto _ : state) {
+        downmixToStereo(mix, left.data(), right.data(), frames);
+        benchmark::DoNotOptimize(left.data());
+        benchmark::DoNotOptimize(right.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_DownmixKernel)->ArgName("channels")->Arg(6)->Arg(8);
+
+// The same fold-down through swr, as AudioConverter would do it without the kernel
+static void BM_DownmixSwr(benchmark::State& state) {
+    const int channels = static_cast<int>(state.range(0));
+    const int frames = 1024;
+    std::vector<std::vector<float>> in = makeSurround(channels, frames);
+    std::vector<float> left(frames), right(frames);
+    std::vector<const uint8_t*> inPlanes;
+    for (std::vector<float>& plane : in) {
+        inPlanes.push_back(reinterpret_cast<const uint8_t*>(plane.data()));
+    }
+    uint8_t* outPlanes[2] = {reinterpret_cast<uint8_t*>(left.data()), reinterpret_cast<uint8_t*>(right.data())};
+
+    AVChannelLayout inLayout, outLayout = AV_CHANNEL_LAYOUT_STEREO;
+    av_channel_layout_default(&inLayout, channels);
+    SwrContext* swr = nullptr;
+    swr_alloc_set_opts2(&swr, &outLayout, AV_SAMPLE_FMT_FLTP, 48000, &inLayout, AV_SAMPLE_FMT_FLTP, 48000, 0, nullptr);
+    av_opt_set_double(swr, "rematrix_maxval", 1.0, 0);
+    swr_init(swr);
+    for (auto _ : state) {
+        swr_convert(swr, outPlanes, frames, inPlanes.data(), frames);
+        benchmark::DoNotOptimize(left.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+    swr_free(&swr);
+}
+BENCHMARK(BM_DownmixSwr)->ArgName("channels")->Arg(6)->Arg(8);
+
+// Planar float -> interleaved, as AudioPlayer queues it for a float device
+static void BM_InterleaveFloat(benchmark::State& state) {
+    const int channels = static_cast<int>(state.range(0));
+    const int frames = 1024;
+    std::vector<std::vector<float>> in = makeSurround(channels, frames);
+    std::vector<const float*> planes;
+    for (std::vector<float>& plane : in) {
+        planes.push_back(plane.data());
+    }
+    std::vector<float> out(static_cast<size_t>(frames) * channels);
+    for (auto _ : state) {
+        interleaveFloat(planes.data(), out.data(), frames, channels);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_InterleaveFloat)->ArgName("channels")->Arg(2)->Arg(6)->Arg(8);
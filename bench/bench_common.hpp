@@ -0,0 +1,64 @@
+#pragma once
+
+#include "media_generator.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Media files the file-based benchmarks run on: MP_BENCH_MEDIA as a ':'-separated list,
+// otherwise synthetic clips generated once into the temp directory. generateMedia renames
+// a clip into place only once it is complete, so any clip found there is safe to reuse.
+inline std::vector<std::string> benchMediaFiles() {
+    std::vector<std::string> files;
+    if (const char* env = std::getenv("MP_BENCH_MEDIA")) {
+        std::stringstream list(env);
+        std::string file;
+        while (std::getline(list, file, ':')) {
+            if (!file.empty()) {
+                files.push_back(file);
+            }
+        }
+        return files;
+    }
+
+    const std::pair<int, int> sizes[] = {{1280, 720}, {1920, 1080}};
+    for (const auto& size : sizes) {
+        MediaGeneratorOptions options;
+        options.width = size.first;
+        options.height = size.second;
+        options.durationSeconds = 5.0;
+        options.outputPath = (std::filesystem::temp_directory_path() /
+            ("mp_bench_" + std::to_string(size.second) + "p.mkv")).string();
+        if (std::filesystem::exists(options.outputPath) || generateMedia(options)) {
+            files.push_back(options.outputPath);
+        }
+    }
+    return files;
+}
+
+// Inputs for the seek benchmarks: MP_BENCH_MEDIA if set, otherwise one generated clip
+// per container and GOP length so the effect of keyframe spacing shows up directly.
+inline std::vector<std::string> benchSeekMediaFiles() {
+    if (std::getenv("MP_BENCH_MEDIA")) {
+        return benchMediaFiles();
+    }
+
+    std::vector<std::string> files;
+    for (const char* container : {"mkv", "mp4"}) {
+        for (int gopSize : {12, 60, 250}) {
+            MediaGeneratorOptions options;
+            options.durationSeconds = 20.0;
+            options.gopSize = gopSize;
+            options.audioChannels = 0;
+            options.outputPath = (std::filesystem::temp_directory_path() /
+                ("mp_seek_gop" + std::to_string(gopSize) + "." + container)).string();
+            if (std::filesystem::exists(options.outputPath) || generateMedia(options)) {
+                files.push_back(options.outputPath);
+            }
+        }
+    }
+    return files;
+}
@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+#include "bench_common.hpp"
+#include "video_decoder.hpp"
+#include <memory>
+
+
+// Raw packet throughput of the demuxer, no decoding
+static void BM_Demux(benchmark::State& state, const std::string& path) {
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_open_input(&formatContext, path.c_str(), nullptr, nullptr) != 0 ||
+        avformat_find_stream_info(formatContext, nullptr) < 0) {
+        avformat_close_input(&formatContext);
+        state.SkipWithError("Couldn't open media file");
+        return;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    int64_t bytes = 0;
+    int64_t packets = 0;
+    for (auto _ : state) {
+        if (av_read_frame(formatContext, packet) < 0) {
+            state.PauseTiming();
+            av_seek_frame(formatContext, -1, 0, AVSEEK_FLAG_BACKWARD);
+            state.ResumeTiming();
+            continue;
+        }
+        bytes += packet->size;
+        packets++;
+        av_packet_unref(packet);
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(packets);
+
+    av_packet_free(&packet);
+    avformat_close_input(&formatContext);
+}
+
+// Demux + video decode through MPDecoder; items/s is decoded frames per second
+static void BM_Decode(benchmark::State& state, const std::string& path, bool convert) {
+    auto decoder = std::make_unique<MPDecoder>();
+    if (!decoder->open(path)) {
+        state.SkipWithError("Couldn't open media file");
+        return;
+    }
+    state.SetLabel(std::string(decoder->getVideoCodecName()) + " " +
+                   std::to_string(decoder->getVideoWidth()) + "x" + std::to_string(decoder->getVideoHeight()));
+
+    int64_t frames = 0;
+    for (auto _ : state) {
+        if (!decoder->decodeFrame()) {
+            // End of file: start over on a fresh decoder outside the timed region
+            state.PauseTiming();
+            decoder = std::make_unique<MPDecoder>();
+            if (!decoder->open(path)) {
+                state.SkipWithError("Couldn't reopen media file");
+                break;
+            }
+            state.ResumeTiming();
+            continue;
+        }
+        if (convert) {
+            decoder->getVideoFrame();
+        }
+        frames++;
+    }
+    state.SetItemsProcessed(frames);
+}
+
+void registerDecoderBenchmarks() {
+    for (const std::string& path : benchMediaFiles()) {
+        benchmark::RegisterBenchmark(("BM_Demux/" + path).c_str(), BM_Demux, path);
+        benchmark::RegisterBenchmark(("BM_Decode/" + path).c_str(), BM_Decode, path, false)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_DecodeConvert/" + path).c_str(), BM_Decode, path, true)
+            ->Unit(benchmark::kMillisecond);
+    }
+}
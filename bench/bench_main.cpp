@@ -0,0 +1,24 @@
+#include <benchmark/benchmark.h>
+extern "C" {
+    #include <libavutil/log.h>
+}
+
+
+// Defined next to the benchmarks that depend on MP_BENCH_MEDIA
+void registerDecoderBenchmarks();
+void registerSeekBenchmarks();
+
+// Use --benchmark_out=<file> --benchmark_out_format=json for results that can be tracked over time
+int main(int argc, char** argv) {
+    av_log_set_level(AV_LOG_ERROR);
+    registerDecoderBenchmarks();
+    registerSeekBenchmarks();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+#include "audio_ring.hpp"
+#include "frame_queue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+static AVFrame* makeSmallFrame() {
+    AVFrame* frame = av_frame_alloc();
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 64;
+    frame->height = 64;
+    av_frame_get_buffer(frame, 0);
+    return frame;
+}
+
+// Uncontended push + pop on one thread: the fixed cost of a queue round trip
+static void BM_FrameQueuePushPop(benchmark::State& state) {
+    FrameQueue queue(static_cast<size_t>(state.range(0)));
+    AVFrame* frame = makeSmallFrame();
+    for (auto _ : state) {
+        queue.push(frame);
+        queue.pop(frame);
+    }
+    state.SetItemsProcessed(state.iterations());
+    av_frame_free(&frame);
+}
+BENCHMARK(BM_FrameQueuePushPop)->Arg(4)->Arg(16);
+
+// Producer thread feeding a consumer: includes wake-up latency of the condition variables
+static void BM_FrameQueueHandoff(benchmark::State& state) {
+    FrameQueue queue(static_cast<size_t>(state.range(0)));
+    AVFrame* source = makeSmallFrame();
+    std::thread producer([&queue, source] {
+        AVFrame* frame = av_frame_alloc();
+        while (true) {
+            av_frame_ref(frame, source);
+            if (!queue.push(frame)) {
+                break;
+            }
+        }
+        av_frame_free(&frame);
+    });
+
+    AVFrame* frame = av_frame_alloc();
+    for (auto _ : state) {
+        queue.pop(frame);
+        av_frame_unref(frame);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    queue.close();
+    producer.join();
+    av_frame_free(&frame);
+    av_frame_free(&source);
+}
+BENCHMARK(BM_FrameQueueHandoff)->Arg(4)->Arg(16)->UseRealTime();
+
+static int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Push-to-pop latency of one frame into an idle consumer blocked in pop(), the case the
+// renderer waiting on the decoder hits. Throughput above hides it behind a full queue.
+// The consumer echoes every frame back, so only one is ever in flight.
+static void BM_FrameQueueLatency(benchmark::State& state) {
+    FrameQueue request(1);
+    FrameQueue reply(1);
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(1 << 20);
+    std::thread echo([&request, &reply, &latenciesNs] {
+        AVFrame* frame = av_frame_alloc();
+        while (request.pop(frame)) {
+            // The stamp travels in the PTS
+            latenciesNs.push_back(steadyNowNs() - frame->pts);
+            if (!reply.push(frame)) {
+                break;
+            }
+        }
+        av_frame_free(&frame);
+    });
+
+    AVFrame* source = makeSmallFrame();
+    AVFrame* frame = av_frame_alloc();
+    for (auto _ : state) {
+        av_frame_ref(frame, source);
+        frame->pts = steadyNowNs();
+        request.push(frame);
+        reply.pop(frame);
+        av_frame_unref(frame);
+    }
+    request.close();
+    reply.close();
+    echo.join();
+    av_frame_free(&frame);
+    av_frame_free(&source);
+
+    if (!latenciesNs.empty()) {
+        std::sort(latenciesNs.begin(), latenciesNs.end());
+        auto percentileUs = [&latenciesNs](double p) {
+            return latenciesNs[static_cast<size_t>(p * (latenciesNs.size() - 1))] / 1000.0;
+        };
+        state.counters["p50_us"] = percentileUs(0.5);
+        state.counters["p99_us"] = percentileUs(0.99);
+        state.counters["max_us"] = latenciesNs.back() / 1000.0;
+    }
+}
+BENCHMARK(BM_FrameQueueLatency)->UseRealTime();
+
+// Write + read of one chunk through the SPSC ring, chunk size in bytes
+static void BM_AudioRingWriteRead(benchmark::State& state) {
+    const size_t chunk = static_cast<size_t>(state.range(0));
+    AudioRing ring(1 << 16);
+    std::vector<uint8_t> input(chunk, 0x5a);
+    std::vector<uint8_t> output(chunk);
+    for (auto _ : state) {
+        ring.write(input.data(), chunk);
+        ring.read(output.data(), chunk);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(state.iterations() * int64_t(chunk));
+}
+BENCHMARK(BM_AudioRingWriteRead)->RangeMultiplier(4)->Range(256, 16384);
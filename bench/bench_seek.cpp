@@ -0,0 +1,170 @@
+#include <benchmark/benchmark.h>
+#include "bench_common.hpp"
+#include "preview_decoder.hpp"
+#include "video_decoder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <random>
+
+
+enum class SeekPattern {
+    Random,
+    Scrub,
+    EndOfFile
+};
+
+static const char* patternName(SeekPattern pattern) {
+    switch (pattern) {
+        case SeekPattern::Random:    return "random";
+        case SeekPattern::Scrub:     return "scrub";
+        case SeekPattern::EndOfFile: return "eof";
+    }
+    return "unknown";
+}
+
+// Time from seek request to the first converted, displayable frame.
+// Cold: every seek runs on a freshly opened decoder without a keyframe index.
+// Warm: one decoder whose keyframe index was built up front.
+static void BM_Seek(benchmark::State& state, const std::string& path, SeekPattern pattern, bool warm) {
+    auto decoder = std::make_unique<MPDecoder>();
+    if (!decoder->open(path)) {
+        state.SkipWithError("Couldn't open media file");
+        return;
+    }
+    const double duration = decoder->getDuration();
+    if (duration <= 1.0) {
+        state.SkipWithError("Clip too short to seek in");
+        return;
+    }
+    if (warm) {
+        decoder->buildKeyframeIndex();
+    }
+    state.SetLabel(decoder->getVideoCodecName());
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> anywhere(0.0, duration - 1.0);
+    std::uniform_real_distribution<double> lastSecond(duration - 1.0, duration - 0.1);
+    double scrubPosition = 0.0;
+    std::vector<double> latenciesMs;
+
+    for (auto _ : state) {
+        double target = 0.0;
+        switch (pattern) {
+            case SeekPattern::Random:
+                target = anywhere(rng);
+                break;
+            case SeekPattern::Scrub:
+                // Small forward steps, like dragging the seek bar
+                scrubPosition += 0.2;
+                if (scrubPosition > duration - 1.0) {
+                    scrubPosition = 0.0;
+                }
+                target = scrubPosition;
+                break;
+            case SeekPattern::EndOfFile:
+                target = lastSecond(rng);
+                break;
+        }
+
+        if (!warm) {
+            decoder = std::make_unique<MPDecoder>();
+            decoder->open(path);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool ok = decoder->seek(target) && decoder->decodeFrame() && decoder->getVideoFrame();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) {
+            state.SkipWithError("Seek did not produce a frame");
+            break;
+        }
+        state.SetIterationTime(elapsed);
+        latenciesMs.push_back(elapsed * 1000.0);
+    }
+
+    if (latenciesMs.empty()) {
+        return;
+    }
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+    auto percentile = [&latenciesMs](double p) {
+        return latenciesMs[static_cast<size_t>(p * (latenciesMs.size() - 1) + 0.5)];
+    };
+    state.counters["p50_ms"] = percentile(0.50);
+    state.counters["p90_ms"] = percentile(0.90);
+    state.counters["p99_ms"] = percentile(0.99);
+    state.counters["max_ms"] = latenciesMs.back();
+}
+
+// Scrub latency through PreviewDecoder: request to a small keyframe preview, the same
+// forward drag as BM_Seek/scrub so the two can be compared directly
+static void BM_PreviewScrub(benchmark::State& state, const std::string& path) {
+    double duration = 0.0;
+    {
+        MPDecoder probe;
+        if (!probe.open(path)) {
+            state.SkipWithError("Couldn't open media file");
+            return;
+        }
+        duration = probe.getDuration();
+    }
+    PreviewDecoder preview;
+    if (duration <= 1.0 || !preview.open(path)) {
+        state.SkipWithError("Couldn't open preview decoder");
+        return;
+    }
+
+    double scrubPosition = 0.0;
+    PreviewFrame frame;
+    std::vector<double> latenciesMs;
+
+    for (auto _ : state) {
+        scrubPosition += 0.2;
+        if (scrubPosition > duration - 1.0) {
+            scrubPosition = 0.0;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        preview.request(scrubPosition);
+        bool ok = preview.waitFrame(frame, std::chrono::milliseconds(2000));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) {
+            state.SkipWithError("Preview did not produce a frame");
+            break;
+        }
+        state.SetIterationTime(elapsed);
+        latenciesMs.push_back(elapsed * 1000.0);
+    }
+
+    if (latenciesMs.empty()) {
+        return;
+    }
+    state.SetLabel(std::to_string(frame.width) + "x" + std::to_string(frame.height));
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+    auto percentile = [&latenciesMs](double p) {
+        return latenciesMs[static_cast<size_t>(p * (latenciesMs.size() - 1) + 0.5)];
+    };
+    state.counters["p50_ms"] = percentile(0.50);
+    state.counters["p99_ms"] = percentile(0.99);
+}
+
+void registerSeekBenchmarks() {
+    for (const std::string& path : benchSeekMediaFiles()) {
+        std::string file = std::filesystem::path(path).filename().string();
+        for (SeekPattern pattern : {SeekPattern::Random, SeekPattern::Scrub, SeekPattern::EndOfFile}) {
+            for (bool warm : {false, true}) {
+                std::string name = std::string("BM_Seek/") + patternName(pattern) + "/" +
+                                   (warm ? "warm" : "cold") + "/" + file;
+                benchmark::RegisterBenchmark(name.c_str(), BM_Seek, path, pattern, warm)
+                    ->UseManualTime()
+                    ->Iterations(100)
+                    ->Unit(benchmark::kMillisecond);
+            }
+        }
+        benchmark::RegisterBenchmark(("BM_PreviewScrub/" + file).c_str(), BM_PreviewScrub, path)
+            ->UseManualTime()
+            ->Iterations(100)
+            ->Unit(benchmark::kMillisecond);
+    }
+}
@@ -0,0 +1,317 @@
+#include "audio_converter.hpp"
+#include "audio_kernels.hpp"
+extern "C" {
+    #include <libavutil/opt.h>
+}
+#include <cmath>
+#include <iostream>
+
+
+namespace {
+
+// -3 dB for the centre and each surround channel, as in the ITU-R BS.775 fold-down
+constexpr float DOWNMIX_CENTRE_GAIN = static_cast<float>(M_SQRT1_2);
+constexpr float DOWNMIX_SURROUND_GAIN = static_cast<float>(M_SQRT1_2);
+
+// The channel order SDL documents for each channel count. FFmpeg's default layouts
+// differ for 3, 4 and 5 channels (3.0, 4.0 and 5.0 rather than 2.1, quad and 4.1).
+void sdlChannelLayout(int channels, AVChannelLayout* layout) {
+    uint64_t mask = 0;
+    switch (channels) {
+        case 1: mask = AV_CH_LAYOUT_MONO; break;
+        case 2: mask = AV_CH_LAYOUT_STEREO; break;
+        case 3: mask = AV_CH_LAYOUT_2POINT1; break;
+        case 4: mask = AV_CH_LAYOUT_QUAD; break;
+        case 5: mask = AV_CH_LAYOUT_QUAD | AV_CH_LOW_FREQUENCY; break;
+        case 6: mask = AV_CH_LAYOUT_5POINT1; break;
+        case 7: mask = AV_CH_LAYOUT_6POINT1; break;
+        case 8: mask = AV_CH_LAYOUT_7POINT1; break;
+    }
+    if (mask == 0 || av_channel_layout_from_mask(layout, mask) < 0) {
+        av_channel_layout_default(layout, channels);
+    }
+}
+
+}
+
+AudioConverter::AudioConverter()
+    : m_path(Path::Passthrough), m_layout(), m_outputLayout(), m_format(AV_SAMPLE_FMT_NONE), m_sampleRate(0), m_outputChannels(0),
+      m_outputRate(0), m_swrContext(nullptr), m_forceResampler(false), m_compensation(0.0), m_compensatedSamples(0),
+      m_lastFrame(av_frame_alloc()), m_frontLeft(-1), m_frontRight(-1), m_centre(-1), m_surroundLeft{-1, -1},
+      m_surroundRight{-1, -1}, m_surroundPairs(0) {
+}
+
+AudioConverter::~AudioConverter() {
+    close();
+    av_frame_free(&m_lastFrame);
+}
+
+bool AudioConverter::configure(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate,
+                               int outputChannels, int outputRate) {
+    m_forceResampler = false;
+    av_frame_unref(m_lastFrame);
+    return setup(layout, format, sampleRate, outputChannels, outputRate);
+}
+
+bool AudioConverter::setup(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate,
+                           int outputChannels, int outputRate) {
+    close();
+    if (layout.nb_channels <= 0 || sampleRate <= 0 || outputChannels <= 0 || outputRate <= 0) {
+        return false;
+    }
+    av_channel_layout_copy(&m_layout, &layout);
+    sdlChannelLayout(outputChannels, &m_outputLayout);
+    m_format = format;
+    m_sampleRate = sampleRate;
+    m_outputChannels = outputChannels;
+    m_outputRate = outputRate;
+
+    // Channels are only copied across when they are the same speakers in the same order.
+    // A source that doesn't say which speakers it has is taken to be in the device's order.
+    const bool sameLayout = layout.order == AV_CHANNEL_ORDER_UNSPEC
+                          ? layout.nb_channels == outputChannels
+                          : av_channel_layout_compare(&layout, &m_outputLayout) == 0;
+    const bool sameRate = sampleRate == outputRate && !m_forceResampler;
+    if (sameRate && format == AV_SAMPLE_FMT_FLTP && sameLayout) {
+        m_path = Path::Passthrough;
+    } else if (sameRate && (format == AV_SAMPLE_FMT_FLT || format == AV_SAMPLE_FMT_S16) && sameLayout) {
+        m_path = Path::Deinterleave;
+    } else if (sameRate && format == AV_SAMPLE_FMT_FLTP && outputChannels == 2 && setupDownmix(layout)) {
+        m_path = Path::Downmix;
+    } else if (setupResampler(layout, format, sampleRate)) {
+        m_path = Path::Resampler;
+    } else {
+        close();
+        return false;
+    }
+    m_planes.assign(outputChannels, std::vector<float>());
+    m_pointers.assign(outputChannels, nullptr);
+    return true;
+}
+
+void AudioConverter::close() {
+    swr_free(&m_swrContext);
+    av_channel_layout_uninit(&m_layout);
+    av_channel_layout_uninit(&m_outputLayout);
+    m_path = Path::Passthrough;
+    m_format = AV_SAMPLE_FMT_NONE;
+    m_sampleRate = 0;
+    m_outputChannels = 0;
+    m_outputRate = 0;
+    m_compensation = 0.0;
+}
+
+int AudioConverter::convert(const AVFrame* frame, const float* const*& planes) {
+    if (frame->format != m_format || frame->sample_rate != m_sampleRate ||
+        av_channel_layout_compare(&frame->ch_layout, &m_layout) != 0) {
+        int outputChannels = m_outputChannels;
+        int outputRate = m_outputRate;
+        double compensation = m_compensation;
+        if (outputChannels <= 0 || !setup(frame->ch_layout, static_cast<AVSampleFormat>(frame->format),
+                                          frame->sample_rate, outputChannels, outputRate)) {
+            return 0;
+        }
+        setCompensation(compensation);
+    }
+
+    const int count = frame->nb_samples;
+    if (m_path != Path::Resampler) {
+        av_frame_unref(m_lastFrame);
+        av_frame_ref(m_lastFrame, frame);
+    }
+    switch (m_path) {
+    case Path::Passthrough:
+        planes = reinterpret_cast<const float* const*>(frame->extended_data);
+        return count;
+    case Path::Deinterleave:
+        reserve(count);
+        if (m_format == AV_SAMPLE_FMT_FLT) {
+            deinterleaveFloat(reinterpret_cast<const float*>(frame->data[0]), m_pointers.data(), count, m_outputChannels);
+        } else {
+            s16ToFloatPlanar(reinterpret_cast<const int16_t*>(frame->data[0]), m_pointers.data(), count, m_outputChannels);
+        }
+        break;
+    case Path::Downmix: {
+        reserve(count);
+        const float* const* in = reinterpret_cast<const float* const*>(frame->extended_data);
+        StereoDownmix mix;
+        mix.frontLeft = in[m_frontLeft];
+        mix.frontRight = in[m_frontRight];
+        mix.centre = in[m_centre];
+        for (int p = 0; p < m_surroundPairs; p++) {
+            mix.surroundLeft[p] = in[m_surroundLeft[p]];
+            mix.surroundRight[p] = in[m_surroundRight[p]];
+        }
+        mix.surroundPairs = m_surroundPairs;
+        mix.centreGain = DOWNMIX_CENTRE_GAIN;
+        mix.surroundGain = DOWNMIX_SURROUND_GAIN;
+        // Full-scale on every channel at once still can't clip
+        mix.scale = 1.0f / (1.0f + DOWNMIX_CENTRE_GAIN + DOWNMIX_SURROUND_GAIN * m_surroundPairs);
+        downmixToStereo(mix, m_pointers[0], m_pointers[1], count);
+        break;
+    }
+    case Path::Resampler: {
+        int outSamples = swr_get_out_samples(m_swrContext, count);
+        reserve(outSamples);
+        int converted = swr_convert(m_swrContext, reinterpret_cast<uint8_t**>(m_pointers.data()), outSamples,
+                                    const_cast<const uint8_t**>(frame->extended_data), count);
+        if (converted <= 0) {
+            return 0;
+        }
+        // A compensation ends after its distance; renew it well before, so a correction
+        // that holds still keeps applying
+        m_compensatedSamples += converted;
+        if (m_compensation != 0.0 && m_compensatedSamples >= static_cast<int64_t>(m_outputRate) * COMPENSATION_SECONDS / 2) {
+            armCompensation();
+        }
+        planes = m_pointers.data();
+        return converted;
+    }
+    }
+    planes = m_pointers.data();
+    return count;
+}
+
+void AudioConverter::flush() {
+    // Initializing again resets swr's internal buffers
+    if (m_swrContext) {
+        swr_init(m_swrContext);
+        if (m_compensation != 0.0) {
+            armCompensation();
+        }
+    }
+    // Nothing after a seek continues this frame
+    av_frame_unref(m_lastFrame);
+}
+
+bool AudioConverter::setCompensation(double correction) {
+    if (m_outputChannels <= 0 || correction == m_compensation) {
+        return m_outputChannels > 0;
+    }
+    if (!m_swrContext) {
+        if (std::abs(correction) < ENGAGE_CORRECTION) {
+            return true;
+        }
+        AVChannelLayout layout;
+        av_channel_layout_copy(&layout, &m_layout);
+        m_forceResampler = true;
+        bool ok = setup(layout, m_format, m_sampleRate, m_outputChannels, m_outputRate);
+        av_channel_layout_uninit(&layout);
+        if (!ok) {
+            return false;
+        }
+        primeResampler();
+    }
+    m_compensation = correction;
+    return armCompensation();
+}
+
+bool AudioConverter::armCompensation() {
+    m_compensatedSamples = 0;
+    const int distance = m_outputRate * COMPENSATION_SECONDS;
+    const int delta = static_cast<int>(std::lround(-m_compensation * distance));
+    return m_swrContext && swr_set_compensation(m_swrContext, delta, distance) >= 0;
+}
+
+void AudioConverter::primeResampler() {
+    const int count = m_lastFrame->nb_samples;
+    if (!m_swrContext || count <= 0 || m_lastFrame->format != m_format || m_lastFrame->sample_rate != m_sampleRate ||
+        av_channel_layout_compare(&m_lastFrame->ch_layout, &m_layout) != 0) {
+        return;
+    }
+    // Engaged at the device rate without compensation yet, so the frame is worth exactly
+    // `count` output samples; whatever swr holds back of them is dropped from what follows
+    int outSamples = swr_get_out_samples(m_swrContext, count);
+    reserve(outSamples);
+    int primed = swr_convert(m_swrContext, reinterpret_cast<uint8_t**>(m_pointers.data()), outSamples,
+                             const_cast<const uint8_t**>(m_lastFrame->extended_data), count);
+    if (primed >= 0 && primed < count) {
+        swr_drop_output(m_swrContext, count - primed);
+    }
+    av_frame_unref(m_lastFrame);
+}
+
+const char* AudioConverter::pathName(Path path) {
+    switch (path) {
+    case Path::Passthrough:
+        return "passthrough";
+    case Path::Deinterleave:
+        return "deinterleave";
+    case Path::Downmix:
+        return "downmix";
+    case Path::Resampler:
+        return "swr";
+    }
+    return "unknown";
+}
+
+std::string AudioConverter::describe() const {
+    if (m_outputChannels <= 0) {
+        return "none";
+    }
+    const char* format = av_get_sample_fmt_name(m_format);
+    std::string text = std::string(pathName(m_path)) + " " + std::to_string(m_layout.nb_channels) + " ch " +
+                       (format ? format : "?") + " " + std::to_string(m_sampleRate) + " Hz";
+    return text + " -> " + std::to_string(m_outputChannels) + " ch fltp " + std::to_string(m_outputRate) + " Hz";
+}
+
+bool AudioConverter::setupDownmix(const AVChannelLayout& layout) {
+    const int channels = layout.nb_channels;
+    if (channels != 6 && channels != 8) {
+        return false;
+    }
+    auto index = [&layout](AVChannel channel) {
+        return av_channel_layout_index_from_channel(&layout, channel);
+    };
+    m_frontLeft = index(AV_CHAN_FRONT_LEFT);
+    m_frontRight = index(AV_CHAN_FRONT_RIGHT);
+    m_centre = index(AV_CHAN_FRONT_CENTER);
+    if (m_frontLeft < 0 || m_frontRight < 0 || m_centre < 0) {
+        return false;
+    }
+    int used = index(AV_CHAN_LOW_FREQUENCY) >= 0 ? 4 : 3;
+    m_surroundPairs = 0;
+    const AVChannel pairs[2][2] = {{AV_CHAN_SIDE_LEFT, AV_CHAN_SIDE_RIGHT}, {AV_CHAN_BACK_LEFT, AV_CHAN_BACK_RIGHT}};
+    for (const auto& pair : pairs) {
+        int left = index(pair[0]);
+        int right = index(pair[1]);
+        if (left >= 0 && right >= 0) {
+            m_surroundLeft[m_surroundPairs] = left;
+            m_surroundRight[m_surroundPairs] = right;
+            m_surroundPairs++;
+            used += 2;
+        }
+    }
+    // Wide or height channels this mix doesn't know about are left to swr
+    return m_surroundPairs > 0 && used == channels;
+}
+
+bool AudioConverter::setupResampler(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate) {
+    int ret = swr_alloc_set_opts2(&m_swrContext, &m_outputLayout, AV_SAMPLE_FMT_FLTP, m_outputRate,
+                                  &layout, format, sampleRate, 0, nullptr);
+    if (ret < 0) {
+        std::cerr << "Couldn't set up audio conversion." << std::endl;
+        return false;
+    }
+    // swr only keeps its mixing matrix clip-safe for integer output unless asked
+    av_opt_set_double(m_swrContext, "rematrix_maxval", 1.0, 0);
+    if (m_forceResampler) {
+        // Compensation needs the resampler even when the rates match
+        av_opt_set_int(m_swrContext, "flags", SWR_FLAG_RESAMPLE, 0);
+    }
+    if (swr_init(m_swrContext) < 0) {
+        std::cerr << "Couldn't set up audio conversion." << std::endl;
+        swr_free(&m_swrContext);
+        return false;
+    }
+    return true;
+}
+
+void AudioConverter::reserve(int frames) {
+    if (!m_planes.empty() && m_planes[0].size() < static_cast<size_t>(frames)) {
+        for (size_t c = 0; c < m_planes.size(); c++) {
+            m_planes[c].resize(frames);
+            m_pointers[c] = m_planes[c].data();
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/channel_layout.h>
+    #include <libavutil/frame.h>
+    #include <libavutil/samplefmt.h>
+    #include <libswresample/swresample.h>
+}
+#include <string>
+#include <vector>
+
+
+// Turns decoded audio frames into float planar with the channel count and sample rate the
+// output device was opened with, in a single pass. The common cases at the device's rate
+// never touch swr and run on the SIMD kernels instead: planar float at the output channel
+// count passes straight through, interleaved float or S16 is split into planes, and
+// planar 5.1/7.1 folds down to stereo. Everything else, including any rate change, is one
+// swr call doing format, layout and rate together. Output channels follow SDL's order for
+// the channel count, e.g. 2.1 for three channels. Not thread-safe.
+class AudioConverter {
+public:
+    enum class Path {
+        Passthrough,
+        Deinterleave,
+        Downmix,
+        Resampler
+    };
+
+    AudioConverter();
+    ~AudioConverter();
+    AudioConverter (const AudioConverter &) =delete;
+    AudioConverter& operator=(const AudioConverter &) =delete;
+
+    bool configure(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate,
+                   int outputChannels, int outputRate);
+    void close();
+    // `planes` is left pointing at outputChannels() planes that stay valid until the next
+    // call. Returns the frame count, 0 when nothing came out. A frame whose format or
+    // layout differs from the configured one reconfigures the converter first.
+    int convert(const AVFrame* frame, const float* const*& planes);
+    // Drops anything held back inside swr, e.g. after a seek
+    void flush();
+    // Produces 1 - correction times as many samples from here on, through swr's
+    // compensation, to follow a clock that drifts against the device's. Corrections
+    // too small to matter leave the fast paths alone; once swr is engaged it stays, primed
+    // with the last frame so the switch is seamless.
+    bool setCompensation(double correction);
+
+    Path path() const { return m_path; }
+    int outputChannels() const { return m_outputChannels; }
+    int outputRate() const { return m_outputRate; }
+    static const char* pathName(Path path);
+    // The conversion as one line, e.g. "swr 6 ch s16 44100 Hz -> 2 ch fltp 48000 Hz"
+    std::string describe() const;
+
+private:
+    // Smallest correction worth giving up the fast paths for: 20 ppm, 72 ms an hour
+    static constexpr double ENGAGE_CORRECTION = 20e-6;
+    // Each compensation is spread over this much output and renewed well before it ends
+    static constexpr int COMPENSATION_SECONDS = 10;
+
+    bool setup(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate, int outputChannels, int outputRate);
+    // Starts a new compensation period for m_compensation
+    bool armCompensation();
+    // Runs the fast paths' last frame through a fresh swr context and drops the output, so
+    // swr's filter history and delay line continue where the fast path left off
+    void primeResampler();
+    bool setupDownmix(const AVChannelLayout& layout);
+    bool setupResampler(const AVChannelLayout& layout, AVSampleFormat format, int sampleRate);
+    void reserve(int frames);
+
+    Path m_path;
+    AVChannelLayout m_layout;
+    // The speakers SDL expects for m_outputChannels, in its order
+    AVChannelLayout m_outputLayout;
+    AVSampleFormat m_format;
+    int m_sampleRate;
+    int m_outputChannels;
+    int m_outputRate;
+    SwrContext* m_swrContext;
+    // Set while compensating: every path goes through swr
+    bool m_forceResampler;
+    double m_compensation;
+    // Output since the compensation was last armed
+    int64_t m_compensatedSamples;
+    // Reference to the last frame a fast path converted
+    AVFrame* m_lastFrame;
+    // Downmix source planes: FL, FR, FC, then left/right surround pairs
+    int m_frontLeft;
+    int m_frontRight;
+    int m_centre;
+    int m_surroundLeft[2];
+    int m_surroundRight[2];
+    int m_surroundPairs;
+    std::vector<std::vector<float>> m_planes;
+    std::vector<float*> m_pointers;
+};
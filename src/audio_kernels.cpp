@@ -0,0 +1,407 @@
+#include "audio_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+void accumulateSampleStats(const float* samples, size_t count, SampleStats& stats) {
+    if (count == 0) {
+        return;
+    }
+    float low = stats.count > 0 ? stats.min : samples[0];
+    float high = stats.count > 0 ? stats.max : samples[0];
+    // Float partial sums are exact enough for a bucket; the running total stays double
+    float squares = 0.0f;
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (count >= 4) {
+        __m128 vlow = _mm_set1_ps(low);
+        __m128 vhigh = _mm_set1_ps(high);
+        __m128 vsquares = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps(samples + i);
+            vlow = _mm_min_ps(vlow, v);
+            vhigh = _mm_max_ps(vhigh, v);
+            vsquares = _mm_add_ps(vsquares, _mm_mul_ps(v, v));
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, vlow);
+        low = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+        _mm_store_ps(lanes, vhigh);
+        high = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        _mm_store_ps(lanes, vsquares);
+        squares = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+#endif
+    for (; i < count; i++) {
+        low = std::min(low, samples[i]);
+        high = std::max(high, samples[i]);
+        squares += samples[i] * samples[i];
+    }
+    stats.min = low;
+    stats.max = high;
+    stats.sumSquares += squares;
+    stats.count += count;
+}
+
+void filterSumSquares(BiquadCascadePair& filter, const float* a, const float* b, size_t count, double sums[2]) {
+#if defined(__SSE2__)
+    __m128d z[2][2];
+    __m128d b0[2], b1[2], b2[2], a1[2], a2[2];
+    for (int s = 0; s < 2; s++) {
+        const BiquadCoefficients& c = filter.stages[s];
+        b0[s] = _mm_set1_pd(c.b0);
+        b1[s] = _mm_set1_pd(c.b1);
+        b2[s] = _mm_set1_pd(c.b2);
+        a1[s] = _mm_set1_pd(c.a1);
+        a2[s] = _mm_set1_pd(c.a2);
+        z[s][0] = _mm_loadu_pd(filter.state[s][0]);
+        z[s][1] = _mm_loadu_pd(filter.state[s][1]);
+    }
+    __m128d squares = _mm_setzero_pd();
+    for (size_t i = 0; i < count; i++) {
+        // Lane 0 is `a`, lane 1 is `b`
+        __m128d x = _mm_set_pd(b ? b[i] : 0.0, a ? a[i] : 0.0);
+        for (int s = 0; s < 2; s++) {
+            // Transposed direct form II
+            __m128d y = _mm_add_pd(_mm_mul_pd(b0[s], x), z[s][0]);
+            z[s][0] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1[s], x), _mm_mul_pd(a1[s], y)), z[s][1]);
+            z[s][1] = _mm_sub_pd(_mm_mul_pd(b2[s], x), _mm_mul_pd(a2[s], y));
+            x = y;
+        }
+        squares = _mm_add_pd(squares, _mm_mul_pd(x, x));
+    }
+    for (int s = 0; s < 2; s++) {
+        _mm_storeu_pd(filter.state[s][0], z[s][0]);
+        _mm_storeu_pd(filter.state[s][1], z[s][1]);
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, squares);
+    sums[0] += lanes[0];
+    sums[1] += lanes[1];
+#else
+    const float* inputs[2] = {a, b};
+    for (int lane = 0; lane < 2; lane++) {
+        double squares = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            double x = inputs[lane] ? inputs[lane][i] : 0.0;
+            for (int s = 0; s < 2; s++) {
+                const BiquadCoefficients& c = filter.stages[s];
+                double (&z)[2][2] = filter.state[s];
+                double y = c.b0 * x + z[0][lane];
+                z[0][lane] = c.b1 * x - c.a1 * y + z[1][lane];
+                z[1][lane] = c.b2 * x - c.a2 * y;
+                x = y;
+            }
+            squares += x * x;
+        }
+        sums[lane] += squares;
+    }
+#endif
+}
+
+float interpolatedPeak(const float* samples, size_t count, const TruePeakFilter& filter) {
+    float peak = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        // Oldest sample first; filters are stored in the same order
+        const float* history = samples + i - (TRUE_PEAK_TAPS - 1);
+        for (int phase = 0; phase < TRUE_PEAK_PHASES; phase++) {
+            float sum = 0.0f;
+            int tap = 0;
+#if defined(__SSE2__)
+            __m128 acc = _mm_setzero_ps();
+            for (; tap + 4 <= TRUE_PEAK_TAPS; tap += 4) {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&filter[phase][tap]), _mm_loadu_ps(history + tap)));
+            }
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, acc);
+            sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+            for (; tap < TRUE_PEAK_TAPS; tap++) {
+                sum += filter[phase][tap] * history[tap];
+            }
+            peak = std::max(peak, std::fabs(sum));
+        }
+    }
+    return peak;
+}
+
+void applyGainS16(int16_t* samples, size_t frames, int channels, float startGain, float endGain) {
+    if (startGain != endGain) {
+        const float step = frames > 0 ? (endGain - startGain) / frames : 0.0f;
+        for (size_t f = 0; f < frames; f++) {
+            float gain = startGain + step * f;
+            for (int c = 0; c < channels; c++) {
+                float value = samples[f * channels + c] * gain;
+                samples[f * channels + c] = static_cast<int16_t>(std::lrint(std::clamp(value, -32768.0f, 32767.0f)));
+            }
+        }
+        return;
+    }
+    const size_t count = frames * channels;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vgain = _mm_set1_ps(endGain);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        // Sign-extend to 32 bits, scale in float, then pack back with saturation
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        low = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(low), vgain));
+        high = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(high), vgain));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_packs_epi32(low, high));
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] = static_cast<int16_t>(std::lrint(std::clamp(samples[i] * endGain, -32768.0f, 32767.0f)));
+    }
+}
+
+void applyGainFloat(float* samples, size_t frames, int channels, float startGain, float endGain) {
+    if (startGain != endGain) {
+        const float step = frames > 0 ? (endGain - startGain) / frames : 0.0f;
+        for (size_t f = 0; f < frames; f++) {
+            float gain = startGain + step * f;
+            for (int c = 0; c < channels; c++) {
+                samples[f * channels + c] = std::clamp(samples[f * channels + c] * gain, -1.0f, 1.0f);
+            }
+        }
+        return;
+    }
+    const size_t count = frames * channels;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vgain = _mm_set1_ps(endGain);
+    const __m128 high = _mm_set1_ps(1.0f);
+    const __m128 low = _mm_set1_ps(-1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(samples + i), vgain);
+        _mm_storeu_ps(samples + i, _mm_max_ps(_mm_min_ps(v, high), low));
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] = std::clamp(samples[i] * endGain, -1.0f, 1.0f);
+    }
+}
+
+namespace {
+
+// Largest float below 2^31; anything from 2^31 up would wrap when converted
+constexpr float S32_MAX_FLOAT = 2147483520.0f;
+constexpr float S32_MIN_FLOAT = -2147483648.0f;
+
+int32_t toS32(float value) {
+    return static_cast<int32_t>(std::lrint(std::clamp(value, S32_MIN_FLOAT, S32_MAX_FLOAT)));
+}
+
+}
+
+void applyGainS32(int32_t* samples, size_t frames, int channels, float startGain, float endGain) {
+    // Float keeps 24 bits of each sample, the precision the audio had before conversion
+    if (startGain != endGain) {
+        const float step = frames > 0 ? (endGain - startGain) / frames : 0.0f;
+        for (size_t f = 0; f < frames; f++) {
+            float gain = startGain + step * f;
+            for (int c = 0; c < channels; c++) {
+                samples[f * channels + c] = toS32(samples[f * channels + c] * gain);
+            }
+        }
+        return;
+    }
+    const size_t count = frames * channels;
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 vgain = _mm_set1_ps(endGain);
+    const __m128 high = _mm_set1_ps(S32_MAX_FLOAT);
+    const __m128 low = _mm_set1_ps(S32_MIN_FLOAT);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+        __m128 scaled = _mm_mul_ps(_mm_cvtepi32_ps(v), vgain);
+        scaled = _mm_max_ps(_mm_min_ps(scaled, high), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), _mm_cvtps_epi32(scaled));
+    }
+#endif
+    for (; i < count; i++) {
+        samples[i] = toS32(samples[i] * endGain);
+    }
+}
+
+float dotProduct(const float* a, const float* b, size_t count) {
+    float sum = 0.0f;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(acc0, acc1));
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void windowedAdd(float* out, const float* add, const float* window, const float* x, size_t count) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(window + i), _mm_loadu_ps(x + i));
+        if (add) {
+            v = _mm_add_ps(v, _mm_loadu_ps(add + i));
+        }
+        _mm_storeu_ps(out + i, v);
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (add ? add[i] : 0.0f) + window[i] * x[i];
+    }
+}
+
+void s16ToFloatPlanar(const int16_t* in, float* const* out, size_t frames, int channels) {
+    const float scale = 1.0f / 32768.0f;
+    size_t f = 0;
+#if defined(__SSE2__)
+    if (channels == 2) {
+        const __m128 vscale = _mm_set1_ps(scale);
+        for (; f + 4 <= frames; f += 4) {
+            // L0 R0 L1 R1 L2 R2 L3 R3, sign-extended to 32 bits
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + f * 2));
+            __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            __m128 a = _mm_cvtepi32_ps(low);
+            __m128 b = _mm_cvtepi32_ps(high);
+            _mm_storeu_ps(out[0] + f, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), vscale));
+            _mm_storeu_ps(out[1] + f, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), vscale));
+        }
+    }
+#endif
+    for (; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            out[c][f] = in[f * channels + c] * scale;
+        }
+    }
+}
+
+void floatPlanarToS16(const float* const* in, int16_t* out, size_t frames, int channels) {
+    size_t f = 0;
+#if defined(__SSE2__)
+    if (channels == 2) {
+        const __m128 vscale = _mm_set1_ps(32768.0f);
+        for (; f + 4 <= frames; f += 4) {
+            __m128 left = _mm_mul_ps(_mm_loadu_ps(in[0] + f), vscale);
+            __m128 right = _mm_mul_ps(_mm_loadu_ps(in[1] + f), vscale);
+            // Round to int32, then pack with saturation and interleave
+            __m128i a = _mm_cvtps_epi32(_mm_unpacklo_ps(left, right));
+            __m128i b = _mm_cvtps_epi32(_mm_unpackhi_ps(left, right));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + f * 2), _mm_packs_epi32(a, b));
+        }
+    }
+#endif
+    for (; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            out[f * channels + c] = static_cast<int16_t>(std::lrint(std::clamp(in[c][f] * 32768.0f, -32768.0f, 32767.0f)));
+        }
+    }
+}
+
+void floatPlanarToS32(const float* const* in, int32_t* out, size_t frames, int channels) {
+    const float scale = 2147483648.0f;
+    size_t f = 0;
+#if defined(__SSE2__)
+    if (channels == 2) {
+        const __m128 vscale = _mm_set1_ps(scale);
+        const __m128 high = _mm_set1_ps(S32_MAX_FLOAT);
+        const __m128 low = _mm_set1_ps(S32_MIN_FLOAT);
+        for (; f + 4 <= frames; f += 4) {
+            __m128 left = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in[0] + f), vscale), high), low);
+            __m128 right = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in[1] + f), vscale), high), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + f * 2), _mm_cvtps_epi32(_mm_unpacklo_ps(left, right)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + f * 2 + 4), _mm_cvtps_epi32(_mm_unpackhi_ps(left, right)));
+        }
+    }
+#endif
+    for (; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            out[f * channels + c] = toS32(in[c][f] * scale);
+        }
+    }
+}
+
+void interleaveFloat(const float* const* in, float* out, size_t frames, int channels) {
+    size_t f = 0;
+#if defined(__SSE2__)
+    if (channels == 2) {
+        for (; f + 4 <= frames; f += 4) {
+            __m128 left = _mm_loadu_ps(in[0] + f);
+            __m128 right = _mm_loadu_ps(in[1] + f);
+            _mm_storeu_ps(out + f * 2, _mm_unpacklo_ps(left, right));
+            _mm_storeu_ps(out + f * 2 + 4, _mm_unpackhi_ps(left, right));
+        }
+    }
+#endif
+    for (; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            out[f * channels + c] = in[c][f];
+        }
+    }
+}
+
+void deinterleaveFloat(const float* in, float* const* out, size_t frames, int channels) {
+    size_t f = 0;
+#if defined(__SSE2__)
+    if (channels == 2) {
+        for (; f + 4 <= frames; f += 4) {
+            __m128 a = _mm_loadu_ps(in + f * 2);
+            __m128 b = _mm_loadu_ps(in + f * 2 + 4);
+            _mm_storeu_ps(out[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(out[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    }
+#endif
+    for (; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            out[c][f] = in[f * channels + c];
+        }
+    }
+}
+
+void downmixToStereo(const StereoDownmix& mix, float* left, float* right, size_t frames) {
+    const float front = mix.scale;
+    const float centre = mix.scale * mix.centreGain;
+    const float surround = mix.scale * mix.surroundGain;
+    size_t f = 0;
+#if defined(__SSE2__)
+    const __m128 vfront = _mm_set1_ps(front);
+    const __m128 vcentre = _mm_set1_ps(centre);
+    const __m128 vsurround = _mm_set1_ps(surround);
+    for (; f + 4 <= frames; f += 4) {
+        __m128 c = _mm_mul_ps(_mm_loadu_ps(mix.centre + f), vcentre);
+        __m128 l = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(mix.frontLeft + f), vfront), c);
+        __m128 r = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(mix.frontRight + f), vfront), c);
+        for (int p = 0; p < mix.surroundPairs; p++) {
+            l = _mm_add_ps(l, _mm_mul_ps(_mm_loadu_ps(mix.surroundLeft[p] + f), vsurround));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(mix.surroundRight[p] + f), vsurround));
+        }
+        _mm_storeu_ps(left + f, l);
+        _mm_storeu_ps(right + f, r);
+    }
+#endif
+    for (; f < frames; f++) {
+        float c = mix.centre[f] * centre;
+        float l = mix.frontLeft[f] * front + c;
+        float r = mix.frontRight[f] * front + c;
+        for (int p = 0; p < mix.surroundPairs; p++) {
+            l += mix.surroundLeft[p][f] * surround;
+            r += mix.surroundRight[p][f] * surround;
+        }
+        left[f] = l;
+        right[f] = r;
+    }
+}
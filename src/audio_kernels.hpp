@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Hot loops over audio samples. SSE2 where available (always on x86-64), with scalar
+// fallbacks that produce the same results up to float rounding.
+
+struct SampleStats {
+    float min = 0.0f;
+    float max = 0.0f;
+    double sumSquares = 0.0;
+    size_t count = 0;
+};
+
+// Folds `count` samples into `stats`
+void accumulateSampleStats(const float* samples, size_t count, SampleStats& stats);
+
+struct BiquadCoefficients {
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+};
+
+// Two cascaded biquads run on two channels at once, one per SIMD lane, in double
+// precision so low-frequency poles near the unit circle stay stable. The delay elements
+// carry over between calls.
+struct BiquadCascadePair {
+    BiquadCoefficients stages[2];
+    // [stage][delay element][lane]
+    double state[2][2][2] = {};
+};
+
+// Filters `count` samples of `a` and `b` (null for silence) and adds each channel's sum
+// of squared output to sums[0] and sums[1]
+void filterSumSquares(BiquadCascadePair& filter, const float* a, const float* b, size_t count, double sums[2]);
+
+// 4x oversampling interpolator for true-peak measurement: a 48-tap filter split into
+// four 12-tap phases
+constexpr int TRUE_PEAK_PHASES = 4;
+constexpr int TRUE_PEAK_TAPS = 12;
+using TruePeakFilter = float[TRUE_PEAK_PHASES][TRUE_PEAK_TAPS];
+
+// Largest absolute value among the interpolated samples around samples[0, count).
+// samples[-(TRUE_PEAK_TAPS - 1)] onwards must be readable, as history.
+float interpolatedPeak(const float* samples, size_t count, const TruePeakFilter& filter);
+
+// Scales interleaved S16 audio in place with saturation. The gain moves linearly from
+// `startGain` to `endGain` across the frames, so changes don't click.
+void applyGainS16(int16_t* samples, size_t frames, int channels, float startGain, float endGain);
+// The same for interleaved float, clipped to [-1, 1], and S32
+void applyGainFloat(float* samples, size_t frames, int channels, float startGain, float endGain);
+void applyGainS32(int32_t* samples, size_t frames, int channels, float startGain, float endGain);
+
+float dotProduct(const float* a, const float* b, size_t count);
+// out[i] = add[i] + window[i] * x[i]; `add` may be null for zero
+void windowedAdd(float* out, const float* add, const float* window, const float* x, size_t count);
+
+// Interleaved S16 <-> float planar in [-1, 1). The way back rounds and saturates.
+void s16ToFloatPlanar(const int16_t* in, float* const* out, size_t frames, int channels);
+void floatPlanarToS16(const float* const* in, int16_t* out, size_t frames, int channels);
+void floatPlanarToS32(const float* const* in, int32_t* out, size_t frames, int channels);
+
+// Interleaved float <-> float planar
+void interleaveFloat(const float* const* in, float* out, size_t frames, int channels);
+void deinterleaveFloat(const float* in, float* const* out, size_t frames, int channels);
+
+// Stereo fold-down of a 5.1 or 7.1 source, LFE dropped:
+//   left = scale * (FL + centreGain * FC + surroundGain * (each left surround)), right alike
+struct StereoDownmix {
+    const float* frontLeft = nullptr;
+    const float* frontRight = nullptr;
+    const float* centre = nullptr;
+    // Side and/or back pairs
+    const float* surroundLeft[2] = {};
+    const float* surroundRight[2] = {};
+    int surroundPairs = 0;
+    float centreGain = 0.0f;
+    float surroundGain = 0.0f;
+    float scale = 1.0f;
+};
+void downmixToStereo(const StereoDownmix& mix, float* left, float* right, size_t frames);
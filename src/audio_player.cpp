@@ -1,8 +1,24 @@
 #include "audio_player.hpp"
+#include "audio_kernels.hpp"
+#include "tracer.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 
-AudioPlayer::AudioPlayer() : m_audioDevice(0) {}
+AudioPlayer::AudioPlayer()
+    : m_audioDevice(0), m_sampleRate(0), m_channels(0), m_format(0), m_deviceFormat(0), m_bufferFrames(0),
+      m_bytesPerFrame(0), m_bufferMode(BufferMode::Robust), m_paused(false), m_targetGain(1.0f), m_openTicks(0),
+      m_lastAdapt(0), m_loggedUnderruns(0), m_cleanSeconds(0.0), m_promoteSeconds(PROMOTE_SECONDS),
+      m_currentGain(1.0f), m_starved(false), m_lastCallbackTicks(0), m_maxJitterUs(0), m_underruns(0),
+      m_primed(false) {
+    for (auto& ticks : m_underrunTicks) {
+        ticks.store(0, std::memory_order_relaxed);
+    }
+}
 
 AudioPlayer::~AudioPlayer() {
     stop();
@@ -15,25 +31,313 @@ bool AudioPlayer::init(int sampleRate, int channels) {
     }
 
     SDL_AudioSpec desiredSpec, obtainedSpec;
+    SDL_zero(desiredSpec);
     desiredSpec.freq = sampleRate;
-    desiredSpec.format = AUDIO_S16SYS;
-    desiredSpec.channels = channels;
-    desiredSpec.samples = 1024;
-    desiredSpec.callback = nullptr;
-    desiredSpec.userdata = nullptr;
+    desiredSpec.format = AUDIO_F32SYS;
+    desiredSpec.channels = static_cast<Uint8>(std::clamp(channels, 1, MAX_CHANNELS));
+    // Robust until the callbacks have shown they keep time; adaptBuffer() decides from there
+    desiredSpec.samples = static_cast<Uint16>(bufferFramesFor(ROBUST_SECONDS, sampleRate));
+    desiredSpec.callback = &AudioPlayer::audioCallback;
+    desiredSpec.userdata = this;
 
-    m_audioDevice = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec, 0);
+    // Taking the device's own rate, format and channel count means SDL has nothing left to
+    // convert: the decoder's converter produces exactly this, in one pass
+    const int allowed = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_FORMAT_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE;
+    m_audioDevice = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec, allowed);
+    m_deviceFormat = obtainedSpec.format;
+    if (m_audioDevice != 0 && !isWritable(obtainedSpec.format)) {
+        // Nothing here writes this format, so SDL has to convert from float after all
+        SDL_CloseAudioDevice(m_audioDevice);
+        desiredSpec.freq = obtainedSpec.freq;
+        desiredSpec.channels = obtainedSpec.channels;
+        m_audioDevice = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec,
+                                            SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+    }
     if (m_audioDevice == 0) {
         std::cerr << "Failed to open audio device: " << SDL_GetError() << std::endl;
         return false;
     }
 
+    // The device starts paused, so the callback can't see any of this half set up
+    m_sampleRate = obtainedSpec.freq;
+    m_channels = obtainedSpec.channels;
+    m_format = obtainedSpec.format;
+    m_bufferFrames = obtainedSpec.samples;
+    m_bufferMode = BufferMode::Robust;
+    m_bytesPerFrame = m_channels * SDL_AUDIO_BITSIZE(m_format) / 8;
+    m_ring = std::make_unique<AudioRing>(static_cast<size_t>(m_sampleRate * RING_SECONDS) * m_bytesPerFrame);
+    m_stretcher = std::make_unique<TimeStretcher>(m_sampleRate, m_channels);
+    m_planes.assign(m_channels, std::vector<float>());
+    m_planePointers.assign(m_channels, nullptr);
+    m_openTicks = SDL_GetPerformanceCounter();
+    m_lastAdapt = m_openTicks;
+    Profiler::instance().setGauge(Gauge::AudioBufferFrames, m_bufferFrames);
+
     SDL_PauseAudioDevice(m_audioDevice, 0);
     return true;
 }
 
-void AudioPlayer::play(const uint8_t* audioData, int dataSize) {
-    SDL_QueueAudio(m_audioDevice, audioData, dataSize);
+int AudioPlayer::bufferFramesFor(double seconds, int sampleRate) {
+    int frames = 64;
+    while (frames < seconds * sampleRate && frames < 16384) {
+        frames *= 2;
+    }
+    return frames;
+}
+
+bool AudioPlayer::reopen(int bufferFrames) {
+    SDL_AudioSpec desiredSpec, obtainedSpec;
+    SDL_zero(desiredSpec);
+    desiredSpec.freq = m_sampleRate;
+    desiredSpec.format = m_format;
+    desiredSpec.channels = static_cast<Uint8>(m_channels);
+    desiredSpec.samples = static_cast<Uint16>(bufferFrames);
+    desiredSpec.callback = &AudioPlayer::audioCallback;
+    desiredSpec.userdata = this;
+
+    // The ring outlives the device, so only what the old buffer still held is lost. No
+    // changes allowed: the decoder already converts to exactly this spec.
+    SDL_CloseAudioDevice(m_audioDevice);
+    m_audioDevice = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &obtainedSpec, 0);
+    if (m_audioDevice == 0) {
+        return false;
+    }
+    m_bufferFrames = obtainedSpec.samples;
+    m_lastCallbackTicks = 0;
+    if (!m_paused) {
+        SDL_PauseAudioDevice(m_audioDevice, 0);
+    }
+    return true;
+}
+
+bool AudioPlayer::setBufferMode(BufferMode mode) {
+    const int previous = m_bufferFrames;
+    const int frames = bufferFramesFor(mode == BufferMode::LowLatency ? LOW_LATENCY_SECONDS : ROBUST_SECONDS, m_sampleRate);
+    if (reopen(frames)) {
+        m_bufferMode = mode;
+    } else if (!reopen(previous)) {
+        std::cerr << "Failed to reopen audio device: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    m_cleanSeconds = 0.0;
+    Profiler::instance().setGauge(Gauge::AudioBufferFrames, m_bufferFrames);
+    std::cerr << "Audio buffer: " << bufferModeName(m_bufferMode) << ", " << m_bufferFrames << " frames" << std::endl;
+    return true;
+}
+
+bool AudioPlayer::adaptBuffer() {
+    if (!m_audioDevice) {
+        return false;
+    }
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    const double elapsed = (now - m_lastAdapt) / frequency;
+    if (elapsed < ADAPT_SECONDS) {
+        return false;
+    }
+    m_lastAdapt = now;
+
+    const uint64_t total = m_underruns.load(std::memory_order_acquire);
+    const uint64_t underruns = total - m_loggedUnderruns;
+    for (uint64_t i = std::max(m_loggedUnderruns, total > UNDERRUN_LOG ? total - UNDERRUN_LOG : 0); i < total; i++) {
+        Uint64 ticks = m_underrunTicks[i % UNDERRUN_LOG].load(std::memory_order_relaxed);
+        std::cerr << "Audio underrun " << i + 1 << " at " << (ticks - m_openTicks) / frequency << " s ("
+                  << bufferModeName(m_bufferMode) << " buffer)" << std::endl;
+    }
+    m_loggedUnderruns = total;
+    const double jitter = m_maxJitterUs.exchange(0, std::memory_order_relaxed) / 1e6;
+    Profiler::instance().setGauge(Gauge::AudioCallbackJitterUs, std::lround(jitter * 1e6));
+    if (m_paused) {
+        return false;
+    }
+
+    // Measured against the small buffer's period whichever is in use: a callback that
+    // late would leave the small buffer close to running dry on the device side
+    const double lowLatencyPeriod = bufferFramesFor(LOW_LATENCY_SECONDS, m_sampleRate) / static_cast<double>(m_sampleRate);
+    if (m_bufferMode == BufferMode::LowLatency) {
+        if (underruns == 0 && jitter < lowLatencyPeriod / 2) {
+            return false;
+        }
+        m_promoteSeconds = std::min(m_promoteSeconds * 2, MAX_PROMOTE_SECONDS);
+        return setBufferMode(BufferMode::Robust);
+    }
+    if (underruns > 0 || jitter >= lowLatencyPeriod / 4) {
+        m_cleanSeconds = 0.0;
+        return false;
+    }
+    m_cleanSeconds += elapsed;
+    return m_cleanSeconds >= m_promoteSeconds && setBufferMode(BufferMode::LowLatency);
+}
+
+const char* AudioPlayer::bufferModeName(BufferMode mode) {
+    switch (mode) {
+    case BufferMode::LowLatency:
+        return "low latency";
+    case BufferMode::Robust:
+        return "robust";
+    }
+    return "unknown";
+}
+
+bool AudioPlayer::isWritable(SDL_AudioFormat format) {
+    return format == AUDIO_F32SYS || format == AUDIO_S16SYS || format == AUDIO_S32SYS;
+}
+
+std::string AudioPlayer::describe() const {
+    auto name = [](SDL_AudioFormat format) {
+        const char* kind = SDL_AUDIO_ISFLOAT(format) ? "f" : SDL_AUDIO_ISSIGNED(format) ? "s" : "u";
+        return kind + std::to_string(SDL_AUDIO_BITSIZE(format));
+    };
+    std::string text = std::to_string(m_channels) + " ch " + name(m_format) + " " + std::to_string(m_sampleRate) +
+                       " Hz, " + std::to_string(m_bufferFrames) + "-frame " + bufferModeName(m_bufferMode) + " buffer";
+    if (m_deviceFormat != m_format) {
+        text += ", SDL converts to " + name(m_deviceFormat);
+    }
+    return text;
+}
+
+int AudioPlayer::play(const float* const* planes, int frames) {
+    TraceScope trace("audio_queue");
+    if (!m_ring || frames <= 0) {
+        return 0;
+    }
+    int queued = frames;
+    if (m_stretcher->tempo() == 1.0) {
+        queued = queue(planes, frames);
+    } else {
+        m_stretcher->push(planes, frames);
+        if (m_planes[0].size() < static_cast<size_t>(frames)) {
+            for (int c = 0; c < m_channels; c++) {
+                m_planes[c].resize(frames);
+                m_planePointers[c] = m_planes[c].data();
+            }
+        }
+        // Slowing down yields more than went in, so drain in blocks the scratch planes hold
+        int64_t pulled = 0;
+        int64_t written = 0;
+        while (int count = m_stretcher->pull(m_planePointers.data(), frames)) {
+            pulled += count;
+            written += queue(m_planePointers.data(), count);
+        }
+        if (written < pulled) {
+            queued = static_cast<int>(frames * written / pulled);
+        }
+    }
+    m_primed = true;
+    Profiler::instance().setGauge(Gauge::AudioQueueBytes, m_ring->available());
+    Profiler::instance().setGauge(Gauge::AudioLatencyUs, std::lround(queuedSeconds() * 1e6));
+    return queued;
+}
+
+int AudioPlayer::queue(const float* const* planes, int frames) {
+    // Whole frames only: a partial one would shift every channel after it. Nothing is
+    // converted that wouldn't fit anyway.
+    frames = static_cast<int>(std::min<size_t>(frames, m_ring->space() / m_bytesPerFrame));
+    if (frames <= 0) {
+        return 0;
+    }
+    m_interleaved.resize(static_cast<size_t>(frames) * m_bytesPerFrame);
+    if (m_format == AUDIO_F32SYS) {
+        interleaveFloat(planes, reinterpret_cast<float*>(m_interleaved.data()), frames, m_channels);
+    } else if (m_format == AUDIO_S32SYS) {
+        floatPlanarToS32(planes, reinterpret_cast<int32_t*>(m_interleaved.data()), frames, m_channels);
+    } else {
+        floatPlanarToS16(planes, reinterpret_cast<int16_t*>(m_interleaved.data()), frames, m_channels);
+    }
+    m_ring->write(m_interleaved.data(), m_interleaved.size());
+    return frames;
+}
+
+void AudioPlayer::setTempo(double tempo) {
+    if (m_stretcher) {
+        m_stretcher->setTempo(tempo);
+    }
+}
+
+void AudioPlayer::setPaused(bool paused) {
+    m_paused = paused;
+    if (m_audioDevice) {
+        SDL_PauseAudioDevice(m_audioDevice, paused ? 1 : 0);
+        // The callback is stopped now; the gap until it runs again isn't jitter
+        m_lastCallbackTicks = 0;
+    }
+}
+
+void AudioPlayer::clear() {
+    if (!m_audioDevice) {
+        return;
+    }
+    // Holding the device lock keeps the callback out of the ring while it's reset
+    SDL_LockAudioDevice(m_audioDevice);
+    m_ring->clear();
+    m_primed = false;
+    SDL_UnlockAudioDevice(m_audioDevice);
+    m_stretcher->reset();
+    Profiler::instance().setGauge(Gauge::AudioQueueBytes, 0);
+}
+
+void AudioPlayer::setGainDb(double gainDb) {
+    m_targetGain = static_cast<float>(std::pow(10.0, gainDb / 20.0));
+}
+
+double AudioPlayer::queuedSeconds() const {
+    if (!m_ring || m_sampleRate <= 0) {
+        return 0.0;
+    }
+    double frames = static_cast<double>(m_ring->available() / m_bytesPerFrame);
+    Uint64 lastCallback = m_lastCallbackTicks.load(std::memory_order_relaxed);
+    if (lastCallback != 0) {
+        double elapsed = static_cast<double>(SDL_GetPerformanceCounter() - lastCallback) / SDL_GetPerformanceFrequency();
+        frames += std::max(0.0, m_bufferFrames - elapsed * m_sampleRate);
+    }
+    return frames / m_sampleRate;
+}
+
+void AudioPlayer::audioCallback(void* userdata, Uint8* stream, int len) {
+    static_cast<AudioPlayer*>(userdata)->fill(stream, len);
+}
+
+void AudioPlayer::fill(uint8_t* stream, int len) {
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const Uint64 previous = m_lastCallbackTicks.exchange(now, std::memory_order_relaxed);
+    if (previous != 0) {
+        // How far this callback is off the steady cadence its own block size implies
+        double interval = static_cast<double>(now - previous) / SDL_GetPerformanceFrequency();
+        double period = static_cast<double>(len / m_bytesPerFrame) / m_sampleRate;
+        int64_t jitterUs = std::llround(std::abs(interval - period) * 1e6);
+        int64_t seen = m_maxJitterUs.load(std::memory_order_relaxed);
+        while (jitterUs > seen && !m_maxJitterUs.compare_exchange_weak(seen, jitterUs, std::memory_order_relaxed)) {
+        }
+    }
+
+    size_t got = m_ring->read(stream, len);
+    if (got < static_cast<size_t>(len)) {
+        std::memset(stream + got, 0, len - got);
+        // One underrun per dry spell, not one per callback until data comes back
+        if (m_primed && !m_starved) {
+            Profiler::instance().increment(Counter::AudioUnderruns);
+            uint64_t count = m_underruns.load(std::memory_order_relaxed);
+            m_underrunTicks[count % UNDERRUN_LOG].store(now, std::memory_order_relaxed);
+            m_underruns.store(count + 1, std::memory_order_release);
+            auto wallClock = std::chrono::system_clock::now().time_since_epoch();
+            Profiler::instance().setGauge(Gauge::AudioLastUnderrunUs,
+                                          std::chrono::duration_cast<std::chrono::microseconds>(wallClock).count());
+        }
+    }
+    m_starved = got < static_cast<size_t>(len);
+
+    float target = m_targetGain.load(std::memory_order_relaxed);
+    if (target != 1.0f || m_currentGain != 1.0f) {
+        size_t frames = got / m_bytesPerFrame;
+        if (m_format == AUDIO_F32SYS) {
+            applyGainFloat(reinterpret_cast<float*>(stream), frames, m_channels, m_currentGain, target);
+        } else if (m_format == AUDIO_S32SYS) {
+            applyGainS32(reinterpret_cast<int32_t*>(stream), frames, m_channels, m_currentGain, target);
+        } else {
+            applyGainS16(reinterpret_cast<int16_t*>(stream), frames, m_channels, m_currentGain, target);
+        }
+    }
+    m_currentGain = target;
 }
 
 void AudioPlayer::stop() {
@@ -42,4 +346,4 @@ void AudioPlayer::stop() {
         m_audioDevice = 0;
     }
     SDL_Quit();
-}
\ No newline at end of file
+}
@@ -1,17 +1,120 @@
 #pragma once
 
+#include "audio_ring.hpp"
+#include "time_stretch.hpp"
 #include <SDL.h>
 #include <libavcodec/avcodec.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
 
+// Plays float planar audio. init() asks for float32 at the source's rate and channel count
+// but takes whatever rate, format and channel count the device prefers, so SDL never adds
+// a conversion stage of its own; the caller resamples to sampleRate() and play() converts
+// each block once, straight into the device's interleaved format. The decoding thread writes
+// into an AudioRing and SDL's callback drains it on the audio thread, applying the
+// loudness normalization gain on the way. Nothing in the callback locks or allocates.
+// Away from 1x, audio goes through a TimeStretcher before it's queued so speed changes
+// keep their pitch. The device buffer starts out robust and drops to a few milliseconds
+// once the callbacks prove punctual, going back up on the first underrun or late callback.
 class AudioPlayer {
 public:
+    enum class BufferMode {
+        LowLatency,
+        Robust
+    };
+
     AudioPlayer();
     ~AudioPlayer();
 
     bool init(int sampleRate, int channels);
-    void play(const uint8_t* audioData, int dataSize);
+    // What the device opened with; play() takes this many planes at this rate
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    SDL_AudioFormat format() const { return m_format; }
+    // E.g. "2 ch f32 48000 Hz, 2048-frame robust buffer", plus any conversion SDL still does
+    std::string describe() const;
+    BufferMode bufferMode() const { return m_bufferMode; }
+    static const char* bufferModeName(BufferMode mode);
+    // Queues as much as fits without blocking; the rest is dropped. Returns how many of
+    // `frames` were queued, proportionally when time-stretching.
+    int play(const float* const* planes, int frames);
+    // Playback speed of the audio passed to play() from now on
+    void setTempo(double tempo);
     void stop();
+    void setPaused(bool paused);
+    // Drops everything queued, e.g. after a seek or when playback leaves 1x
+    void clear();
+    // Takes effect on the next callback, ramped over its buffer so it doesn't click
+    void setGainDb(double gainDb);
+    // Audio queued ahead of the device: the ring plus what's left of the block the last
+    // callback took. Unlike the ring alone it doesn't saw-tooth with every callback. This
+    // is the output latency: what's queued now is heard this much later.
+    double queuedSeconds() const;
+    // Judges the callbacks since the last decision about once a second, logs any new
+    // underruns, and reopens the device with the other buffer size when that's called
+    // for. Call regularly from the thread that calls play(); returns true after a reopen.
+    bool adaptBuffer();
 
 private:
+    // About this much audio fits in the ring
+    static constexpr double RING_SECONDS = 1.0;
+    // Most SDL accepts; 7.1
+    static constexpr int MAX_CHANNELS = 8;
+    // Device buffer sizes, rounded up to a power of two frames
+    static constexpr double LOW_LATENCY_SECONDS = 0.005;
+    static constexpr double ROBUST_SECONDS = 0.04;
+    static constexpr double ADAPT_SECONDS = 1.0;
+    // Clean playback needed before low latency is tried; doubles after every fallback
+    static constexpr double PROMOTE_SECONDS = 10.0;
+    static constexpr double MAX_PROMOTE_SECONDS = 600.0;
+    // Underrun timestamps kept for adaptBuffer() to log
+    static constexpr size_t UNDERRUN_LOG = 16;
+
+    // Sample formats queue() writes itself
+    static bool isWritable(SDL_AudioFormat format);
+    static int bufferFramesFor(double seconds, int sampleRate);
+    // Same spec with another buffer size; false leaves no device open
+    bool reopen(int bufferFrames);
+    bool setBufferMode(BufferMode mode);
+    static void audioCallback(void* userdata, Uint8* stream, int len);
+    void fill(uint8_t* stream, int len);
+    // Converts to the device format and writes what fits to the ring; returns the frames written
+    int queue(const float* const* planes, int frames);
+
     SDL_AudioDeviceID m_audioDevice;
+    std::unique_ptr<AudioRing> m_ring;
+    int m_sampleRate;
+    int m_channels;
+    SDL_AudioFormat m_format;
+    // What the hardware side runs at; differs from m_format only when SDL converts
+    SDL_AudioFormat m_deviceFormat;
+    int m_bufferFrames;
+    int m_bytesPerFrame;
+    BufferMode m_bufferMode;
+    bool m_paused;
+    // Decoding thread only, like play()
+    std::unique_ptr<TimeStretcher> m_stretcher;
+    std::vector<std::vector<float>> m_planes;
+    std::vector<float*> m_planePointers;
+    std::vector<uint8_t> m_interleaved;
+    std::atomic<float> m_targetGain;
+    Uint64 m_openTicks;
+    Uint64 m_lastAdapt;
+    uint64_t m_loggedUnderruns;
+    double m_cleanSeconds;
+    double m_promoteSeconds;
+    // Audio thread only
+    float m_currentGain;
+    bool m_starved;
+    // SDL_GetPerformanceCounter() at the start of the last callback
+    std::atomic<Uint64> m_lastCallbackTicks;
+    // Written by the callback, drained by adaptBuffer()
+    std::atomic<int64_t> m_maxJitterUs;
+    std::atomic<uint64_t> m_underruns;
+    std::array<std::atomic<Uint64>, UNDERRUN_LOG> m_underrunTicks;
+    // Set once audio has been queued; running dry before that isn't an underrun
+    std::atomic<bool> m_primed;
 };
@@ -0,0 +1,60 @@
+#include "audio_ring.hpp"
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+
+size_t nextPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+AudioRing::AudioRing(size_t capacityBytes)
+    : m_buffer(nextPowerOfTwo(capacityBytes)), m_mask(m_buffer.size() - 1), m_readPos(0), m_writePos(0) {
+}
+
+size_t AudioRing::write(const uint8_t* data, size_t bytes) {
+    size_t writePos = m_writePos.load(std::memory_order_relaxed);
+    size_t readPos = m_readPos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, m_buffer.size() - (writePos - readPos));
+
+    size_t offset = writePos & m_mask;
+    size_t first = std::min(count, m_buffer.size() - offset);
+    std::memcpy(m_buffer.data() + offset, data, first);
+    std::memcpy(m_buffer.data(), data + first, count - first);
+
+    m_writePos.store(writePos + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::read(uint8_t* out, size_t bytes) {
+    size_t readPos = m_readPos.load(std::memory_order_relaxed);
+    size_t writePos = m_writePos.load(std::memory_order_acquire);
+    size_t count = std::min(bytes, writePos - readPos);
+
+    size_t offset = readPos & m_mask;
+    size_t first = std::min(count, m_buffer.size() - offset);
+    std::memcpy(out, m_buffer.data() + offset, first);
+    std::memcpy(out + first, m_buffer.data(), count - first);
+
+    m_readPos.store(readPos + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::available() const {
+    return m_writePos.load(std::memory_order_acquire) - m_readPos.load(std::memory_order_acquire);
+}
+
+size_t AudioRing::space() const {
+    return m_buffer.size() - available();
+}
+
+void AudioRing::clear() {
+    m_readPos.store(m_writePos.load(std::memory_order_relaxed), std::memory_order_release);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Lock-free single-producer/single-consumer byte ring between the decoder and the
+// audio device callback. Neither side ever blocks or allocates.
+class AudioRing {
+public:
+    // Capacity is rounded up to a power of two
+    explicit AudioRing(size_t capacityBytes);
+    AudioRing (const AudioRing &) =delete;
+    AudioRing& operator=(const AudioRing &) =delete;
+
+    // Producer side. Returns how many bytes fit.
+    size_t write(const uint8_t* data, size_t bytes);
+    // Consumer side. Returns how many bytes were available.
+    size_t read(uint8_t* out, size_t bytes);
+
+    size_t available() const;
+    size_t space() const;
+    size_t capacity() const { return m_buffer.size(); }
+    // Only safe while neither side is running, e.g. with the audio device paused
+    void clear();
+
+private:
+    std::vector<uint8_t> m_buffer;
+    size_t m_mask;
+    // Free-running positions; the difference is the fill level
+    alignas(64) std::atomic<size_t> m_readPos;
+    alignas(64) std::atomic<size_t> m_writePos;
+};
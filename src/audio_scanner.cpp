@@ -0,0 +1,214 @@
+#include "audio_scanner.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <iostream>
+
+
+namespace {
+
+// Silence is handed to the sink in blocks of this many samples
+constexpr int SILENCE_BLOCK = 4096;
+
+}
+
+AudioScanner::AudioScanner()
+    : m_formatContext(nullptr), m_codecContext(nullptr), m_swrContext(nullptr),
+      m_packet(nullptr), m_frame(nullptr), m_streamIndex(-1), m_failed(false), m_outLayout{} {
+}
+
+AudioScanner::~AudioScanner() {
+    close();
+}
+
+// Polled by libavformat during blocking I/O
+int AudioScanner::interruptCallback(void* opaque) {
+    return static_cast<AudioScanner*>(opaque)->isCancelled() ? 1 : 0;
+}
+
+bool AudioScanner::open(const std::string& filePath, bool mono, CancelCallback cancelled) {
+    close();
+    m_cancelled = std::move(cancelled);
+
+    m_formatContext = avformat_alloc_context();
+    m_formatContext->interrupt_callback.callback = &AudioScanner::interruptCallback;
+    m_formatContext->interrupt_callback.opaque = this;
+    if (avformat_open_input(&m_formatContext, filePath.c_str(), nullptr, nullptr) != 0 ||
+        avformat_find_stream_info(m_formatContext, nullptr) < 0) {
+        std::cerr << "Audio scanner: couldn't open " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    const AVCodec* codec = nullptr;
+    m_streamIndex = av_find_best_stream(m_formatContext, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (m_streamIndex < 0) {
+        close();
+        return false;
+    }
+    for (unsigned int i = 0; i < m_formatContext->nb_streams; i++) {
+        if (static_cast<int>(i) != m_streamIndex) {
+            m_formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    m_codecContext = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codecContext, m_formatContext->streams[m_streamIndex]->codecpar);
+    // One thread: analysis runs in the background and must not take cores from playback
+    m_codecContext->thread_count = 1;
+    if (avcodec_open2(m_codecContext, codec, nullptr) < 0) {
+        close();
+        return false;
+    }
+
+    if (mono) {
+        av_channel_layout_default(&m_outLayout, 1);
+    } else {
+        av_channel_layout_copy(&m_outLayout, &m_codecContext->ch_layout);
+    }
+    // Same rate in and out, so swr only converts format and mixes; it never buffers
+    if (swr_alloc_set_opts2(&m_swrContext, &m_outLayout, AV_SAMPLE_FMT_FLTP, m_codecContext->sample_rate,
+                            &m_codecContext->ch_layout, m_codecContext->sample_fmt, m_codecContext->sample_rate,
+                            0, nullptr) < 0 || swr_init(m_swrContext) < 0) {
+        close();
+        return false;
+    }
+    m_planes.assign(m_outLayout.nb_channels, std::vector<float>(SILENCE_BLOCK));
+    m_pointers.resize(m_outLayout.nb_channels);
+    for (std::vector<float>& plane : m_planes) {
+        m_output.push_back(reinterpret_cast<uint8_t*>(plane.data()));
+    }
+
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    return true;
+}
+
+void AudioScanner::close() {
+    swr_free(&m_swrContext);
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+    avcodec_free_context(&m_codecContext);
+    avformat_close_input(&m_formatContext);
+    av_channel_layout_uninit(&m_outLayout);
+    m_streamIndex = -1;
+    m_planes.clear();
+    m_pointers.clear();
+    m_output.clear();
+}
+
+int AudioScanner::sampleRate() const {
+    return m_codecContext ? m_codecContext->sample_rate : 0;
+}
+
+int64_t AudioScanner::totalSamples() const {
+    if (!isOpen()) {
+        return 0;
+    }
+    AVStream* stream = m_formatContext->streams[m_streamIndex];
+    if (stream->duration != AV_NOPTS_VALUE) {
+        return av_rescale_q(stream->duration, stream->time_base, AVRational{1, sampleRate()});
+    }
+    if (m_formatContext->duration != AV_NOPTS_VALUE) {
+        return av_rescale_q(m_formatContext->duration, AV_TIME_BASE_Q, AVRational{1, sampleRate()});
+    }
+    return 0;
+}
+
+bool AudioScanner::scan(int64_t beginSample, int64_t endSample, const Sink& sink) {
+    TraceScope trace("audio_scan");
+    m_failed = true;
+    if (!isOpen()) {
+        return false;
+    }
+    AVStream* stream = m_formatContext->streams[m_streamIndex];
+    const AVRational sampleBase{1, sampleRate()};
+    const int64_t startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (av_seek_frame(m_formatContext, m_streamIndex,
+                      startTime + av_rescale_q(beginSample, sampleBase, stream->time_base),
+                      AVSEEK_FLAG_BACKWARD) < 0 && beginSample > 0) {
+        return false;
+    }
+    avcodec_flush_buffers(m_codecContext);
+    m_failed = false;
+
+    int64_t next = beginSample;
+    // Sample index of the next decoded sample, from the first frame's timestamp
+    int64_t position = AV_NOPTS_VALUE;
+    bool draining = false;
+    while (next < endSample && !isCancelled()) {
+        int ret = avcodec_receive_frame(m_codecContext, m_frame);
+        if (ret == AVERROR(EAGAIN)) {
+            int readResult = av_read_frame(m_formatContext, m_packet);
+            if (readResult < 0) {
+                // A cancelled read is reported as an error too, but isn't one
+                if (readResult != AVERROR_EOF && !isCancelled()) {
+                    m_failed = true;
+                    break;
+                }
+                if (draining) {
+                    break;
+                }
+                draining = true;
+                avcodec_send_packet(m_codecContext, nullptr);
+                continue;
+            }
+            if (m_packet->stream_index == m_streamIndex) {
+                avcodec_send_packet(m_codecContext, m_packet);
+            }
+            av_packet_unref(m_packet);
+            continue;
+        }
+        if (ret < 0) {
+            m_failed = ret != AVERROR_EOF;
+            break;
+        }
+
+        if (position == AV_NOPTS_VALUE) {
+            position = m_frame->best_effort_timestamp != AV_NOPTS_VALUE
+                ? av_rescale_q(m_frame->best_effort_timestamp - startTime, stream->time_base, sampleBase)
+                : next;
+        }
+        int count = m_frame->nb_samples;
+        if (static_cast<int>(m_planes[0].size()) < count) {
+            for (size_t c = 0; c < m_planes.size(); c++) {
+                m_planes[c].resize(count);
+                m_output[c] = reinterpret_cast<uint8_t*>(m_planes[c].data());
+            }
+        }
+        int converted = swr_convert(m_swrContext, m_output.data(), count,
+                                    const_cast<const uint8_t**>(m_frame->extended_data), count);
+        av_frame_unref(m_frame);
+        if (converted > 0) {
+            deliver(next, endSample, position, converted, sink);
+            position += converted;
+        }
+    }
+    return next >= endSample;
+}
+
+void AudioScanner::deliver(int64_t& next, int64_t endSample, int64_t position, int count, const Sink& sink) {
+    if (position + count <= next) {
+        return;
+    }
+    // A seek that lands after the range start leaves a hole; fill it so positions stay exact
+    if (position > next) {
+        std::vector<float> silence(SILENCE_BLOCK, 0.0f);
+        std::vector<const float*> silent(m_planes.size(), silence.data());
+        int64_t gapEnd = std::min(position, endSample);
+        while (next < gapEnd) {
+            int block = static_cast<int>(std::min<int64_t>(SILENCE_BLOCK, gapEnd - next));
+            sink(silent.data(), block);
+            next += block;
+        }
+        if (next >= endSample) {
+            return;
+        }
+    }
+    int offset = static_cast<int>(next - position);
+    int usable = static_cast<int>(std::min<int64_t>(count - offset, endSample - next));
+    for (size_t c = 0; c < m_planes.size(); c++) {
+        m_pointers[c] = m_planes[c].data() + offset;
+    }
+    sink(m_pointers.data(), usable);
+    next += usable;
+}
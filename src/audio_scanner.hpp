@@ -0,0 +1,67 @@
+#pragma once
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libswresample/swresample.h>
+}
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Offline audio decode for analysis jobs: its own demuxer and single-threaded decoder,
+// delivering float planar samples at the source rate for any range of the file.
+// Several scanners over one file can cover disjoint ranges in parallel.
+// Not thread-safe; one instance per thread.
+class AudioScanner {
+public:
+    // Returns true to abandon the current scan, including blocking reads
+    using CancelCallback = std::function<bool()>;
+    // `planes` holds one pointer per channel to `count` samples
+    using Sink = std::function<void(const float* const* planes, int count)>;
+
+    AudioScanner();
+    ~AudioScanner();
+    AudioScanner (const AudioScanner &) =delete;
+    AudioScanner& operator=(const AudioScanner &) =delete;
+
+    // `mono` downmixes to one channel, otherwise the source layout is kept
+    bool open(const std::string& filePath, bool mono, CancelCallback cancelled = nullptr);
+    void close();
+    bool isOpen() const { return m_codecContext != nullptr; }
+
+    int sampleRate() const;
+    int channels() const { return m_outLayout.nb_channels; }
+    // Layout of the delivered planes
+    const AVChannelLayout& layout() const { return m_outLayout; }
+    // Estimated from the container duration
+    int64_t totalSamples() const;
+
+    // Delivers samples [beginSample, endSample) in order, in blocks of at most one
+    // decoded frame. Samples the seek skips over come back as silence, so positions
+    // stay exact. Returns false if cancelled or if the file ended early.
+    bool scan(int64_t beginSample, int64_t endSample, const Sink& sink);
+    // Whether the last scan() stopped on a seek, read or decode error, as opposed to
+    // reaching endSample, the end of the file or a cancellation
+    bool failed() const { return m_failed; }
+
+private:
+    static int interruptCallback(void* opaque);
+    bool isCancelled() const { return m_cancelled && m_cancelled(); }
+    void deliver(int64_t& next, int64_t endSample, int64_t position, int count, const Sink& sink);
+
+    AVFormatContext* m_formatContext;
+    AVCodecContext* m_codecContext;
+    SwrContext* m_swrContext;
+    AVPacket* m_packet;
+    AVFrame* m_frame;
+    int m_streamIndex;
+    bool m_failed;
+    AVChannelLayout m_outLayout;
+    CancelCallback m_cancelled;
+    std::vector<std::vector<float>> m_planes;
+    std::vector<const float*> m_pointers;
+    std::vector<uint8_t*> m_output;
+};
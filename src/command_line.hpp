@@ -0,0 +1,28 @@
+#pragma once
+
+#include <sstream>
+
+
+// Reads a whole argument as a number; false for anything else, such as "abc" or "10x".
+// `value` is left untouched on failure so option defaults survive.
+template <typename T>
+bool parseNumber(const char* text, T& value) {
+    std::istringstream stream(text);
+    T parsed;
+    if (!(stream >> parsed) || !stream.eof()) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+// As above, and also false outside [min, max]
+template <typename T, typename Min, typename Max>
+bool parseNumber(const char* text, T& value, Min min, Max max) {
+    T parsed;
+    if (!parseNumber(text, parsed) || parsed < static_cast<T>(min) || parsed > static_cast<T>(max)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
@@ -0,0 +1,83 @@
+#include "decode_quality.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+
+
+const char* decodeQualityName(DecodeQuality quality) {
+    switch (quality) {
+        case DecodeQuality::Full:           return "full";
+        case DecodeQuality::SkipLoopFilter: return "skip_loop_filter";
+        case DecodeQuality::SkipIdct:       return "skip_idct";
+        case DecodeQuality::SkipNonRef:     return "skip_nonref";
+        case DecodeQuality::KeyframesOnly:  return "keyframes_only";
+        case DecodeQuality::Count:          break;
+    }
+    return "unknown";
+}
+
+DecodeQualityController::DecodeQualityController() {
+    reset();
+}
+
+void DecodeQualityController::reset() {
+    m_frames = 0;
+    m_misses = 0;
+    m_windowSeconds = 0.0;
+    m_cleanWindows = 0;
+    m_restoreWindows = RESTORE_WINDOWS;
+    m_justRestored = false;
+    setLevel(DecodeQuality::Full);
+}
+
+void DecodeQualityController::setLevel(DecodeQuality level) {
+    m_level = level;
+    Profiler::instance().setGauge(Gauge::DecodeQuality, static_cast<int64_t>(level));
+}
+
+bool DecodeQualityController::record(bool missedDeadline, double seconds) {
+    m_frames++;
+    if (missedDeadline) {
+        m_misses++;
+    }
+    m_windowSeconds += std::max(0.0, seconds);
+    if (m_windowSeconds < WINDOW_SECONDS) {
+        return false;
+    }
+
+    const double missRate = static_cast<double>(m_misses) / m_frames;
+    const int level = static_cast<int>(m_level);
+    const bool justRestored = m_justRestored;
+    m_frames = 0;
+    m_misses = 0;
+    m_windowSeconds = 0.0;
+    m_justRestored = false;
+
+    if (missRate > DEGRADE_MISS_RATE) {
+        m_cleanWindows = 0;
+        if (justRestored) {
+            m_restoreWindows = std::min(m_restoreWindows * 2, MAX_RESTORE_WINDOWS);
+        }
+        if (level + 1 < static_cast<int>(DecodeQuality::Count)) {
+            setLevel(static_cast<DecodeQuality>(level + 1));
+            return true;
+        }
+        return false;
+    }
+
+    if (missRate == 0.0) {
+        m_cleanWindows++;
+    } else {
+        m_cleanWindows = 0;
+    }
+    if (level > 0 && m_cleanWindows >= m_restoreWindows) {
+        m_cleanWindows = 0;
+        m_justRestored = true;
+        setLevel(static_cast<DecodeQuality>(level - 1));
+        return true;
+    }
+    if (level == 0 && m_cleanWindows >= m_restoreWindows) {
+        // Sustained full quality: forgive earlier failed restores
+        m_restoreWindows = RESTORE_WINDOWS;
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+
+// Decoder shortcuts, cheapest loss of quality first. Each level includes the ones before it.
+enum class DecodeQuality {
+    Full,
+    SkipLoopFilter,
+    // IDCT skipped on frames nothing references, so artifacts don't propagate
+    SkipIdct,
+    SkipNonRef,
+    KeyframesOnly,
+    Count
+};
+
+const char* decodeQualityName(DecodeQuality quality);
+
+// Steps decode quality down while presentation keeps missing its deadlines and back up
+// once playback has had headroom for a while. Feed it one observation per presented or
+// dropped frame. Windows are measured in playback time, not frames, so that recovering
+// from keyframes-only decoding, at one frame per GOP, takes as long as at full rate.
+class DecodeQualityController {
+public:
+    // Playback time per evaluation window
+    static constexpr double WINDOW_SECONDS = 2.0;
+    // Misses in a window above this fraction degrade by one level
+    static constexpr double DEGRADE_MISS_RATE = 0.05;
+    // Clean windows needed before trying one level better; doubles each time a restore
+    // has to be taken back straight away, so an overloaded machine doesn't oscillate
+    static constexpr int RESTORE_WINDOWS = 4;
+    static constexpr int MAX_RESTORE_WINDOWS = 64;
+
+    DecodeQualityController();
+
+    // `seconds` is how long the frame was scheduled to stay up. Returns true when the level
+    // changed and should be applied to the decoder.
+    bool record(bool missedDeadline, double seconds);
+    DecodeQuality level() const { return m_level; }
+    void reset();
+
+private:
+    void setLevel(DecodeQuality level);
+
+    DecodeQuality m_level;
+    int m_frames;
+    int m_misses;
+    double m_windowSeconds;
+    int m_cleanWindows;
+    int m_restoreWindows;
+    // Set for the first window after a restore, to detect one that didn't hold
+    bool m_justRestored;
+};
@@ -0,0 +1,53 @@
+#include "drift_controller.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+DriftController::DriftController()
+    : m_filtered(0.0), m_target(0.0), m_integral(0.0), m_correction(0.0), m_startTime(0.0), m_lastTime(0.0),
+      m_lastUpdate(0.0), m_started(false), m_settled(false) {
+}
+
+void DriftController::reset() {
+    m_started = false;
+    m_settled = false;
+    // Until the target is known again only the drift itself is corrected
+    m_correction = m_integral;
+}
+
+void DriftController::update(double fillSeconds, double now) {
+    if (m_started && (now < m_lastTime || now - m_lastTime > MAX_GAP_SECONDS)) {
+        reset();
+    }
+    if (!m_started) {
+        m_started = true;
+        m_filtered = fillSeconds;
+        m_target = fillSeconds;
+        m_startTime = now;
+        m_lastTime = now;
+        return;
+    }
+    const double dt = now - m_lastTime;
+    m_lastTime = now;
+    m_filtered += (fillSeconds - m_filtered) * (1.0 - std::exp(-dt / FILTER_SECONDS));
+
+    if (!m_settled) {
+        // Whatever level playback naturally runs at becomes the target
+        m_target = m_filtered;
+        if (now - m_startTime >= SETTLE_SECONDS) {
+            m_settled = true;
+            m_lastUpdate = now;
+        }
+        return;
+    }
+    if (now - m_lastUpdate < UPDATE_SECONDS) {
+        return;
+    }
+    const double step = now - m_lastUpdate;
+    m_lastUpdate = now;
+
+    const double error = m_filtered - m_target;
+    m_integral = std::clamp(m_integral + KI * error * step, -MAX_CORRECTION, MAX_CORRECTION);
+    const double wanted = std::clamp(KP * error + m_integral, -MAX_CORRECTION, MAX_CORRECTION);
+    m_correction += std::clamp(wanted - m_correction, -MAX_STEP, MAX_STEP);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+
+// Keeps audio output locked to the master clock by watching how full the AudioRing is.
+// The sound card's crystal and the system clock disagree by tens of ppm, and left alone
+// the difference piles up in the ring: over hours it becomes a lip-sync error, then an
+// overflow or an underrun. After a reset the filtered fill level is learnt as the target
+// for a few seconds; from then on a PI loop turns any deviation into a speed correction,
+// moved in small slew-limited steps so it never becomes audible. The integral term ends
+// up as the measured drift and survives resets. Clock-agnostic: callers pass the times.
+class DriftController {
+public:
+    // Largest correction either way, 1000 ppm: under 2 cents of pitch when resampling
+    static constexpr double MAX_CORRECTION = 0.001;
+
+    DriftController();
+
+    // Relearns the target after a seek, pause or rate change; keeps the drift estimate
+    void reset();
+    // `fillSeconds` is the audio queued ahead of the device, `now` the master clock in seconds
+    void update(double fillSeconds, double now);
+
+    // How much faster the master clock supplies audio than the device consumes it;
+    // positive means the ring is filling up. Audio slaved to an external clock is
+    // resampled to 1 - correction() times as many samples; with the audio clock as
+    // master, video frame durations are stretched by 1 + correction() instead.
+    double correction() const { return m_correction; }
+    double driftPpm() const { return m_integral * 1e6; }
+    bool settled() const { return m_settled; }
+
+private:
+    // Proportional and integral gains: critically damped with a 20 s time constant
+    static constexpr double KP = 0.1;
+    static constexpr double KI = KP * KP / 4;
+    // Smoothing of the fill level, which jumps with every decoded burst
+    static constexpr double FILTER_SECONDS = 1.0;
+    static constexpr double SETTLE_SECONDS = 3.0;
+    static constexpr double UPDATE_SECONDS = 0.5;
+    // Largest change of the correction per update
+    static constexpr double MAX_STEP = 50e-6;
+    // A longer gap between updates means playback stopped; start over
+    static constexpr double MAX_GAP_SECONDS = 1.0;
+
+    double m_filtered;
+    double m_target;
+    double m_integral;
+    double m_correction;
+    double m_startTime;
+    double m_lastTime;
+    double m_lastUpdate;
+    bool m_started;
+    bool m_settled;
+};
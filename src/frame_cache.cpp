@@ -0,0 +1,128 @@
+#include "frame_cache.hpp"
+#include "profiler.hpp"
+
+
+namespace {
+
+size_t frameBytes(const AVFrame* frame) {
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+        bytes += frame->buf[i]->size;
+    }
+    return bytes;
+}
+
+} // namespace
+
+FrameCache::FrameCache(size_t byteBudget)
+    : m_budget(byteBudget), m_bytes(0), m_hits(0), m_misses(0), m_evictions(0) {
+}
+
+FrameCache::~FrameCache() {
+    clear();
+}
+
+void FrameCache::insert(const AVFrame* frame) {
+    int64_t pts = frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    auto existing = m_entries.find(pts);
+    if (existing != m_entries.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, existing->second.lru);
+        return;
+    }
+
+    size_t bytes = frameBytes(frame);
+    if (bytes == 0 || bytes > m_budget) {
+        return;
+    }
+    while (m_bytes + bytes > m_budget && !m_lru.empty()) {
+        evictOldest();
+    }
+
+    AVFrame* ref = av_frame_clone(frame);
+    if (!ref) {
+        return;
+    }
+    m_lru.push_front(pts);
+    m_entries.emplace(pts, Entry{ref, bytes, AV_NOPTS_VALUE, AV_NOPTS_VALUE, m_lru.begin()});
+    m_bytes += bytes;
+    Profiler::instance().setGauge(Gauge::FrameCacheBytes, static_cast<int64_t>(m_bytes));
+}
+
+void FrameCache::link(int64_t prev, int64_t next) {
+    auto before = m_entries.find(prev);
+    if (before != m_entries.end()) {
+        before->second.next = next;
+    }
+    auto after = m_entries.find(next);
+    if (after != m_entries.end()) {
+        after->second.prev = prev;
+    }
+}
+
+const AVFrame* FrameCache::hit(std::map<int64_t, Entry>::iterator it) {
+    m_hits++;
+    Profiler::instance().increment(Counter::FrameCacheHits);
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+    return it->second.frame;
+}
+
+const AVFrame* FrameCache::miss() {
+    m_misses++;
+    Profiler::instance().increment(Counter::FrameCacheMisses);
+    return nullptr;
+}
+
+const AVFrame* FrameCache::find(int64_t pts) {
+    auto it = m_entries.find(pts);
+    return it == m_entries.end() ? miss() : hit(it);
+}
+
+const AVFrame* FrameCache::findNext(int64_t pts) {
+    auto current = m_entries.find(pts);
+    if (current == m_entries.end() || current->second.next == AV_NOPTS_VALUE) {
+        return miss();
+    }
+    return find(current->second.next);
+}
+
+const AVFrame* FrameCache::findPrevious(int64_t pts) {
+    auto current = m_entries.find(pts);
+    if (current == m_entries.end() || current->second.prev == AV_NOPTS_VALUE) {
+        return miss();
+    }
+    return find(current->second.prev);
+}
+
+void FrameCache::evictOldest() {
+    auto it = m_entries.find(m_lru.back());
+    m_lru.pop_back();
+    m_bytes -= it->second.bytes;
+    av_frame_free(&it->second.frame);
+    m_entries.erase(it);
+    m_evictions++;
+    Profiler::instance().increment(Counter::FrameCacheEvictions);
+}
+
+void FrameCache::clear() {
+    for (auto& entry : m_entries) {
+        av_frame_free(&entry.second.frame);
+    }
+    m_entries.clear();
+    m_lru.clear();
+    m_bytes = 0;
+    Profiler::instance().setGauge(Gauge::FrameCacheBytes, 0);
+}
+
+FrameCache::Stats FrameCache::stats() const {
+    Stats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evictions = m_evictions;
+    stats.frames = m_entries.size();
+    stats.bytes = m_bytes;
+    stats.budget = m_budget;
+    return stats;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+
+
+// LRU cache of decoded frames keyed by PTS, bounded by the bytes of frame data it keeps
+// alive. Frames are held as references to the decoder's YUV buffers, so caching costs
+// no copy and a fraction of the memory of converted RGB.
+// Each entry also remembers which PTS came right before and after it in decode order,
+// so stepping only hits the cache when no frame in between could be missing.
+class FrameCache {
+public:
+    static constexpr size_t DEFAULT_BYTE_BUDGET = 256u * 1024 * 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t frames = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+
+        double hitRate() const { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+    };
+
+    explicit FrameCache(size_t byteBudget = DEFAULT_BYTE_BUDGET);
+    ~FrameCache();
+    FrameCache (const FrameCache &) =delete;
+    FrameCache& operator=(const FrameCache &) =delete;
+
+    // Takes a new reference to `frame` under its best-effort timestamp
+    void insert(const AVFrame* frame);
+    // Records that `next` was decoded right after `prev`
+    void link(int64_t prev, int64_t next);
+    // The cached frame with exactly this PTS, or nullptr. Each lookup counts as a hit or a miss.
+    const AVFrame* find(int64_t pts);
+    // The cached frame decoded right after / before `pts`, or nullptr when that isn't known
+    const AVFrame* findNext(int64_t pts);
+    const AVFrame* findPrevious(int64_t pts);
+
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        AVFrame* frame;
+        size_t bytes;
+        int64_t prev;
+        int64_t next;
+        std::list<int64_t>::iterator lru;
+    };
+
+    void evictOldest();
+    const AVFrame* hit(std::map<int64_t, Entry>::iterator it);
+    const AVFrame* miss();
+
+    size_t m_budget;
+    size_t m_bytes;
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_evictions;
+    std::map<int64_t, Entry> m_entries;
+    // Most recently used first
+    std::list<int64_t> m_lru;
+};
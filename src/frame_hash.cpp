@@ -0,0 +1,270 @@
+#include "frame_hash.hpp"
+#include "video_decoder.hpp"
+extern "C" {
+    #include <libavutil/pixdesc.h>
+}
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+
+namespace {
+
+constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Input is read as little-endian, which every platform we build for is
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t lanesRound(uint64_t lane, uint64_t input) {
+    lane += input * PRIME2;
+    lane = rotl(lane, 31);
+    return lane * PRIME1;
+}
+
+inline uint64_t mergeRound(uint64_t hash, uint64_t lane) {
+    hash ^= lanesRound(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+std::string formatLine(const char* kind, int64_t pts, size_t size, uint64_t hash) {
+    char line[96];
+    std::snprintf(line, sizeof(line), "%-5s, %12lld, %10zu, %016llx",
+                  kind, static_cast<long long>(pts), size, static_cast<unsigned long long>(hash));
+    return line;
+}
+
+size_t imageSize(AVPixelFormat format, int width, int height) {
+    int size = av_image_get_buffer_size(format, width, height, 1);
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+bool readHashLines(const std::string& path, std::vector<std::string>& lines) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[0] != '#') {
+            lines.push_back(line);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+Xxh64::Xxh64(uint64_t seed)
+    : m_seed(seed),
+      m_lanes{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1},
+      m_buffered(0), m_totalSize(0) {
+}
+
+void Xxh64::update(const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    m_totalSize += size;
+
+    if (m_buffered + size < sizeof(m_buffer)) {
+        std::memcpy(m_buffer + m_buffered, p, size);
+        m_buffered += size;
+        return;
+    }
+
+    if (m_buffered > 0) {
+        size_t fill = sizeof(m_buffer) - m_buffered;
+        std::memcpy(m_buffer + m_buffered, p, fill);
+        for (int i = 0; i < 4; i++) {
+            m_lanes[i] = lanesRound(m_lanes[i], read64(m_buffer + i * 8));
+        }
+        p += fill;
+        m_buffered = 0;
+    }
+
+    // Four independent lanes keep the multipliers busy; this loop is where the time goes
+    uint64_t v1 = m_lanes[0], v2 = m_lanes[1], v3 = m_lanes[2], v4 = m_lanes[3];
+    while (end - p >= 32) {
+        v1 = lanesRound(v1, read64(p));
+        v2 = lanesRound(v2, read64(p + 8));
+        v3 = lanesRound(v3, read64(p + 16));
+        v4 = lanesRound(v4, read64(p + 24));
+        p += 32;
+    }
+    m_lanes[0] = v1; m_lanes[1] = v2; m_lanes[2] = v3; m_lanes[3] = v4;
+
+    m_buffered = static_cast<size_t>(end - p);
+    std::memcpy(m_buffer, p, m_buffered);
+}
+
+uint64_t Xxh64::digest() const {
+    uint64_t hash;
+    if (m_totalSize >= 32) {
+        hash = rotl(m_lanes[0], 1) + rotl(m_lanes[1], 7) + rotl(m_lanes[2], 12) + rotl(m_lanes[3], 18);
+        for (uint64_t lane : m_lanes) {
+            hash = mergeRound(hash, lane);
+        }
+    } else {
+        hash = m_seed + PRIME5;
+    }
+    hash += m_totalSize;
+
+    const uint8_t* p = m_buffer;
+    const uint8_t* end = m_buffer + m_buffered;
+    while (end - p >= 8) {
+        hash ^= lanesRound(0, read64(p));
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        hash ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+        hash = rotl(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= *p * PRIME5;
+        hash = rotl(hash, 11) * PRIME1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t hashImage(const AVFrame* frame, AVPixelFormat format, int width, int height) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    int rowBytes[4];
+    if (!desc || av_image_fill_linesizes(rowBytes, format, width) < 0) {
+        return 0;
+    }
+
+    Xxh64 hasher;
+    for (int plane = 0; plane < av_pix_fmt_count_planes(format); plane++) {
+        // Planes 1 and 2 of YUV formats are the subsampled chroma planes
+        bool chroma = (plane == 1 || plane == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+        int rows = chroma ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+        for (int y = 0; y < rows; y++) {
+            hasher.update(frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane], rowBytes[plane]);
+        }
+    }
+    return hasher.digest();
+}
+
+uint64_t hashAudioPlanes(const float* const* planes, int channels, int frames) {
+    Xxh64 hasher;
+    for (int ch = 0; ch < channels; ch++) {
+        hasher.update(planes[ch], static_cast<size_t>(frames) * sizeof(float));
+    }
+    return hasher.digest();
+}
+
+bool runFrameHash(const FrameHashOptions& options, FrameHashResult& result) {
+    MPDecoder decoder;
+    if (!decoder.open(options.filePath)) {
+        std::cerr << "Failed to open media file " << options.filePath << std::endl;
+        return false;
+    }
+
+    if (!decoder.hasVideo()) {
+        // Demuxing is driven by video decoding; without it no audio is delivered either
+        std::cerr << options.filePath << " has no video stream to hash." << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> lines;
+    if (options.audio && decoder.hasAudio()) {
+        // What the player plays: the converter's float planar output, in demux order
+        const int channels = decoder.getAudioConverter().outputChannels();
+        decoder.setAudioSink([&](const float* const* planes, int frames) {
+            lines.push_back(formatLine("audio", decoder.getAudioFrame()->best_effort_timestamp,
+                                       static_cast<size_t>(frames) * channels * sizeof(float),
+                                       hashAudioPlanes(planes, channels, frames)));
+            result.audioFrames++;
+        });
+    }
+    const int width = decoder.getVideoWidth();
+    const int height = decoder.getVideoHeight();
+    while (decoder.decodeFrame()) {
+        const AVFrame* decoded = decoder.getDecodedFrame();
+        AVPixelFormat format = static_cast<AVPixelFormat>(decoded->format);
+        int64_t pts = decoder.getVideoPts();
+        lines.push_back(formatLine("video", pts, imageSize(format, decoded->width, decoded->height),
+                                   hashImage(decoded, format, decoded->width, decoded->height)));
+        if (options.convert) {
+            lines.push_back(formatLine("rgb", pts, imageSize(AV_PIX_FMT_RGB24, width, height),
+                                       hashImage(decoder.getVideoFrame(), AV_PIX_FMT_RGB24, width, height)));
+        }
+        result.videoFrames++;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream dump;
+    dump << "#format: xxh64 of visible bytes per frame\n"
+         << "#kind, pts, size, hash\n";
+    for (const std::string& line : lines) {
+        dump << line << '\n';
+    }
+    if (options.outputPath.empty()) {
+        std::cout << dump.str();
+    } else {
+        std::ofstream file(options.outputPath);
+        if (!(file << dump.str())) {
+            std::cerr << "Couldn't write " << options.outputPath << std::endl;
+            return false;
+        }
+    }
+
+    result.passed = true;
+    if (options.goldenPath.empty()) {
+        return true;
+    }
+    std::vector<std::string> golden;
+    if (!readHashLines(options.goldenPath, golden)) {
+        return false;
+    }
+    // Report the first few differences; after a dropped or extra frame everything shifts anyway
+    const size_t common = std::min(golden.size(), lines.size());
+    for (size_t i = 0; i < common; i++) {
+        if (golden[i] != lines[i]) {
+            if (result.mismatches < 10) {
+                std::cerr << "mismatch at line " << i + 1 << ":\n  expected " << golden[i]
+                          << "\n  actual   " << lines[i] << '\n';
+            }
+            result.mismatches++;
+        }
+    }
+    if (golden.size() != lines.size()) {
+        std::cerr << "expected " << golden.size() << " frames, got " << lines.size() << '\n';
+        result.mismatches += static_cast<int64_t>(std::max(golden.size(), lines.size()) - common);
+    }
+    result.passed = result.mismatches == 0;
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+    #include <libavutil/pixfmt.h>
+}
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Streaming XXH64. Runs at several GB/s per core, so hashing every frame of a 4K clip
+// costs little next to decoding it.
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0);
+    void update(const void* data, size_t size);
+    uint64_t digest() const;
+
+private:
+    uint64_t m_seed;
+    uint64_t m_lanes[4];
+    uint8_t m_buffer[32];
+    size_t m_buffered;
+    uint64_t m_totalSize;
+};
+
+// Hashes only the visible bytes of each plane, so linesize padding and alignment
+// differences between builds don't change the result
+uint64_t hashImage(const AVFrame* frame, AVPixelFormat format, int width, int height);
+// Hashes converted audio as MPDecoder's audio sink delivers it
+uint64_t hashAudioPlanes(const float* const* planes, int channels, int frames);
+
+// framemd5-style dump: one line per decoded frame, converted frame and audio chunk with
+// its PTS, payload size and hash. Audio is hashed as the player receives it, after
+// AudioConverter, at the source's channel count and rate. Pass a golden file to compare against instead of
+// (or as well as) writing one.
+struct FrameHashOptions {
+    std::string filePath;
+    // Empty prints to stdout
+    std::string outputPath;
+    // Empty skips the comparison
+    std::string goldenPath;
+    bool convert = true;
+    bool audio = true;
+};
+
+struct FrameHashResult {
+    int64_t videoFrames = 0;
+    int64_t audioFrames = 0;
+    int64_t mismatches = 0;
+    double seconds = 0.0;
+    bool passed = false;
+};
+
+bool runFrameHash(const FrameHashOptions& options, FrameHashResult& result);
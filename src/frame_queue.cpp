@@ -0,0 +1,109 @@
+#include "frame_queue.hpp"
+#include "profiler.hpp"
+
+
+FrameQueue::FrameQueue(size_t capacity)
+    : m_slots(capacity, nullptr), m_head(0), m_count(0), m_closed(false) {
+    for (auto& slot : m_slots) {
+        slot = av_frame_alloc();
+    }
+}
+
+FrameQueue::~FrameQueue() {
+    for (auto& slot : m_slots) {
+        av_frame_free(&slot);
+    }
+}
+
+void FrameQueue::pushLocked(AVFrame* frame) {
+    AVFrame* slot = m_slots[(m_head + m_count) % m_slots.size()];
+    av_frame_move_ref(slot, frame);
+    m_count++;
+    Profiler::instance().setGauge(Gauge::VideoQueueDepth, static_cast<int64_t>(m_count));
+}
+
+void FrameQueue::popLocked(AVFrame* frame) {
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, m_slots[m_head]);
+    m_head = (m_head + 1) % m_slots.size();
+    m_count--;
+    Profiler::instance().setGauge(Gauge::VideoQueueDepth, static_cast<int64_t>(m_count));
+}
+
+bool FrameQueue::push(AVFrame* frame) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notFull.wait(lock, [this] { return m_closed || m_count < m_slots.size(); });
+    if (m_closed) {
+        return false;
+    }
+    pushLocked(frame);
+    m_notEmpty.notify_one();
+    return true;
+}
+
+bool FrameQueue::tryPush(AVFrame* frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_closed || m_count == m_slots.size()) {
+        return false;
+    }
+    pushLocked(frame);
+    m_notEmpty.notify_one();
+    return true;
+}
+
+bool FrameQueue::pop(AVFrame* frame) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [this] { return m_closed || m_count > 0; });
+    if (m_count == 0) {
+        return false;
+    }
+    popLocked(frame);
+    m_notFull.notify_one();
+    return true;
+}
+
+bool FrameQueue::tryPop(AVFrame* frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count == 0) {
+        return false;
+    }
+    popLocked(frame);
+    m_notFull.notify_one();
+    return true;
+}
+
+int64_t FrameQueue::frontPts() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count == 0) {
+        return AV_NOPTS_VALUE;
+    }
+    return m_slots[m_head]->best_effort_timestamp;
+}
+
+void FrameQueue::flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& slot : m_slots) {
+        av_frame_unref(slot);
+    }
+    m_head = 0;
+    m_count = 0;
+    Profiler::instance().setGauge(Gauge::VideoQueueDepth, 0);
+    m_notFull.notify_all();
+}
+
+void FrameQueue::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_notEmpty.notify_all();
+    m_notFull.notify_all();
+}
+
+void FrameQueue::reopen() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = false;
+}
+
+size_t FrameQueue::size() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count;
+}
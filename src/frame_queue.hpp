@@ -0,0 +1,52 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+// Bounded FIFO of decoded frames between a producer and a consumer thread.
+// Frames are moved in and out by reference, so pixel data is never copied and
+// the slot frames are allocated once up front.
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity);
+    ~FrameQueue();
+    FrameQueue (const FrameQueue &) =delete;
+    FrameQueue& operator=(const FrameQueue &) =delete;
+
+    // Blocks while full. Takes over the references held by `frame`; returns false once closed.
+    bool push(AVFrame* frame);
+    bool tryPush(AVFrame* frame);
+    // Blocks while empty. Moves the oldest frame into `frame`; returns false once closed and drained.
+    bool pop(AVFrame* frame);
+    bool tryPop(AVFrame* frame);
+    // PTS of the oldest queued frame, AV_NOPTS_VALUE when empty
+    int64_t frontPts() const;
+
+    // Drops every queued frame, e.g. after a seek
+    void flush();
+    // Wakes up blocked callers; push/pop fail from now on until reopen()
+    void close();
+    void reopen();
+
+    size_t size() const;
+    size_t capacity() const { return m_slots.size(); }
+
+private:
+    void pushLocked(AVFrame* frame);
+    void popLocked(AVFrame* frame);
+
+    std::vector<AVFrame*> m_slots;
+    size_t m_head;
+    size_t m_count;
+    bool m_closed;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
@@ -0,0 +1,81 @@
+#include "gpu_timer.hpp"
+
+
+GpuTimer::GpuTimer() : m_next(0), m_active(nullptr), m_available(false) {}
+
+GpuTimer::~GpuTimer() {
+    cleanup();
+}
+
+bool GpuTimer::init() {
+    // Timer queries are core since GL 3.3
+    if (!GLAD_GL_VERSION_3_3) {
+        return false;
+    }
+    for (auto& query : m_queries) {
+        glGenQueries(1, &query.id);
+    }
+    m_available = true;
+    return true;
+}
+
+void GpuTimer::begin(Stage stage) {
+    if (!m_available || m_active) {
+        return;
+    }
+
+    Query& query = m_queries[m_next];
+    if (query.pending) {
+        collect();
+        // The GPU is more than POOL_SIZE queries behind; skip this sample rather than block.
+        if (query.pending) {
+            return;
+        }
+    }
+
+    query.stage = stage;
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    m_active = &query;
+    m_next = (m_next + 1) % POOL_SIZE;
+}
+
+void GpuTimer::end() {
+    if (!m_active) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_active->pending = true;
+    m_active = nullptr;
+}
+
+void GpuTimer::collect() {
+    if (!m_available) {
+        return;
+    }
+    for (auto& query : m_queries) {
+        if (!query.pending) {
+            continue;
+        }
+        GLint ready = 0;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) {
+            continue;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+        Profiler::instance().record(query.stage, static_cast<int64_t>(elapsed));
+        query.pending = false;
+    }
+}
+
+void GpuTimer::cleanup() {
+    if (!m_available) {
+        return;
+    }
+    for (auto& query : m_queries) {
+        glDeleteQueries(1, &query.id);
+        query = Query();
+    }
+    m_active = nullptr;
+    m_available = false;
+}
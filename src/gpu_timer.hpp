@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include "profiler.hpp"
+
+
+// GL_TIME_ELAPSED queries for the GPU side of the render stages.
+// Results are read back a few frames later so measuring never stalls the pipeline.
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+    GpuTimer (const GpuTimer &) =delete;
+    GpuTimer& operator=(const GpuTimer &) =delete;
+
+    // Needs a current GL context. Returns false when timer queries are unavailable.
+    bool init();
+    void begin(Stage stage);
+    void end();
+    // Records every finished query into the Profiler
+    void collect();
+    void cleanup();
+    bool isAvailable() const { return m_available; }
+
+private:
+    static constexpr size_t POOL_SIZE = 16;
+
+    struct Query {
+        GLuint id = 0;
+        Stage stage = Stage::GpuDraw;
+        bool pending = false;
+    };
+
+    std::array<Query, POOL_SIZE> m_queries;
+    size_t m_next;
+    Query* m_active;
+    bool m_available;
+};
@@ -0,0 +1,119 @@
+#include "headless_bench.hpp"
+#include "memory_usage.hpp"
+#include "video_decoder.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+
+
+double processCpuSeconds() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+bool runDecodeBenchmark(const DecodeBenchOptions& options, DecodeBenchResult& result) {
+    MPDecoder decoder;
+    if (!decoder.open(options.filePath)) {
+        std::cerr << "Failed to open media file " << options.filePath << std::endl;
+        return false;
+    }
+
+    result.filePath = options.filePath;
+    result.codec = decoder.getVideoCodecName();
+    result.width = decoder.getVideoWidth();
+    result.height = decoder.getVideoHeight();
+    result.convert = options.convert;
+
+    // Only the decode loop counts, not opening the file
+    Profiler::instance().reset();
+    double cpuStart = processCpuSeconds();
+    auto wallStart = std::chrono::steady_clock::now();
+
+    while (options.maxFrames == 0 || result.frames < options.maxFrames) {
+        if (!decoder.decodeFrame()) {
+            break;
+        }
+        if (options.convert) {
+            decoder.getVideoFrame();
+        }
+        result.frames++;
+    }
+
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    result.cpuSeconds = processCpuSeconds() - cpuStart;
+    result.peakRssBytes = peakRssBytes();
+    for (size_t i = 0; i < result.stages.size(); i++) {
+        result.stages[i] = Profiler::instance().stats(static_cast<Stage>(i));
+        result.stageSeconds[i] = Profiler::instance().cumulative(static_cast<Stage>(i)).sumSeconds;
+    }
+    return true;
+}
+
+void printDecodeBenchReport(const DecodeBenchResult& result, std::ostream& out) {
+    out << std::fixed << std::setprecision(2)
+        << result.filePath << ": " << result.codec << ' ' << result.width << 'x' << result.height
+        << (result.convert ? " (with conversion)" : "") << '\n'
+        << "  frames:      " << result.frames << '\n'
+        << "  wall time:   " << result.wallSeconds << " s\n"
+        << "  fps:         " << result.fps() << '\n'
+        << "  cpu/frame:   " << result.cpuMsPerFrame() << " ms\n"
+        << "  peak RSS:    " << result.peakRssBytes / (1024.0 * 1024.0) << " MiB\n"
+        << "  stage          total s   share   p50 ms   p99 ms   max ms\n";
+    for (size_t i = 0; i < result.stages.size(); i++) {
+        const StageStats& stats = result.stages[i];
+        if (stats.count == 0) {
+            continue;
+        }
+        double share = result.wallSeconds > 0.0 ? 100.0 * result.stageSeconds[i] / result.wallSeconds : 0.0;
+        out << "  " << std::left << std::setw(12) << stageName(static_cast<Stage>(i)) << std::right
+            << std::setw(10) << result.stageSeconds[i]
+            << std::setw(7) << share << '%'
+            << std::setw(9) << stats.p50Ms
+            << std::setw(9) << stats.p99Ms
+            << std::setw(9) << stats.maxMs << '\n';
+    }
+}
+
+bool writeDecodeBenchJson(const DecodeBenchResult& result, const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << " for writing." << std::endl;
+        return false;
+    }
+
+    file << std::setprecision(6)
+         << "{\n"
+         << "  \"file\": \"" << result.filePath << "\",\n"
+         << "  \"codec\": \"" << result.codec << "\",\n"
+         << "  \"width\": " << result.width << ",\n"
+         << "  \"height\": " << result.height << ",\n"
+         << "  \"convert\": " << (result.convert ? "true" : "false") << ",\n"
+         << "  \"frames\": " << result.frames << ",\n"
+         << "  \"wall_seconds\": " << result.wallSeconds << ",\n"
+         << "  \"fps\": " << result.fps() << ",\n"
+         << "  \"cpu_ms_per_frame\": " << result.cpuMsPerFrame() << ",\n"
+         << "  \"peak_rss_bytes\": " << result.peakRssBytes << ",\n"
+         << "  \"stages\": {";
+    bool first = true;
+    for (size_t i = 0; i < result.stages.size(); i++) {
+        const StageStats& stats = result.stages[i];
+        if (stats.count == 0) {
+            continue;
+        }
+        file << (first ? "\n" : ",\n")
+             << "    \"" << stageName(static_cast<Stage>(i)) << "\": {"
+             << "\"total_seconds\": " << result.stageSeconds[i]
+             << ", \"p50_ms\": " << stats.p50Ms
+             << ", \"p99_ms\": " << stats.p99Ms
+             << ", \"max_ms\": " << stats.maxMs << "}";
+        first = false;
+    }
+    file << "\n  }\n}\n";
+    return file.good();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "profiler.hpp"
+
+
+// Decode-only throughput run: no window, no audio device and no frame pacing.
+struct DecodeBenchOptions {
+    std::string filePath;
+    bool convert = false;
+    // 0 decodes the whole file
+    int64_t maxFrames = 0;
+    // Empty skips the JSON report
+    std::string jsonPath;
+};
+
+struct DecodeBenchResult {
+    std::string filePath;
+    std::string codec;
+    int width = 0;
+    int height = 0;
+    bool convert = false;
+    int64_t frames = 0;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0;
+    size_t peakRssBytes = 0;
+    std::array<StageStats, static_cast<size_t>(Stage::Count)> stages;
+    std::array<double, static_cast<size_t>(Stage::Count)> stageSeconds{};
+
+    double fps() const { return wallSeconds > 0.0 ? frames / wallSeconds : 0.0; }
+    double cpuMsPerFrame() const { return frames > 0 ? cpuSeconds * 1000.0 / frames : 0.0; }
+};
+
+bool runDecodeBenchmark(const DecodeBenchOptions& options, DecodeBenchResult& result);
+void printDecodeBenchReport(const DecodeBenchResult& result, std::ostream& out);
+bool writeDecodeBenchJson(const DecodeBenchResult& result, const std::string& path);
+
+// User + system CPU time consumed by this process so far
+double processCpuSeconds();
@@ -0,0 +1,135 @@
+#include "jitter_harness.hpp"
+#include "renderer.hpp"
+#include "video_decoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+bool runJitterTest(const JitterTestOptions& options, JitterTestResult& result) {
+    MPDecoder decoder;
+    if (!decoder.open(options.filePath)) {
+        std::cerr << "Failed to open media file " << options.filePath << std::endl;
+        return false;
+    }
+
+    Renderer renderer;
+    if (!renderer.init(decoder.getVideoWidth(), decoder.getVideoHeight(), false)) {
+        std::cerr << "Failed to create an offscreen GL context.\n";
+        return false;
+    }
+
+    // Only the fallback for frames without a next timestamp; pacing follows the PTS gaps
+    AVRational frameRate = decoder.getFrameRate();
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        std::cerr << "The video stream has no usable frame rate.\n";
+        return false;
+    }
+    double nominalDelay = av_q2d(av_inv_q(frameRate));
+    double timeBase = av_q2d(decoder.getVideoTimeBase());
+
+    // Decoding runs one frame ahead: how long a frame stays up is the gap to the next
+    // one's PTS, which matters on variable frame rate clips
+    AVFrame* shown = av_frame_alloc();
+    int64_t shownPts = AV_NOPTS_VALUE;
+    int64_t firstPts = AV_NOPTS_VALUE;
+    double frameDelay = nominalDelay;
+    // Each presented frame's slot length, for judging misses
+    std::vector<double> delaysMs;
+    std::chrono::steady_clock::time_point start;
+    while (true) {
+        bool decoded = decoder.decodeFrame();
+        int64_t pts = decoded ? decoder.getVideoPts() : AV_NOPTS_VALUE;
+        if (decoded && pts == AV_NOPTS_VALUE) {
+            continue;
+        }
+        if (shownPts != AV_NOPTS_VALUE) {
+            if (decoded && pts > shownPts) {
+                frameDelay = (pts - shownPts) * timeBase;
+            }
+            const AVFrame* rgb = decoder.convertFrame(shown);
+            renderer.renderFrame(rgb->data[0], decoder.getVideoWidth(), decoder.getVideoHeight(), frameDelay, shownPts);
+            // The first presentation anchors the timeline
+            if (result.samples.empty()) {
+                start = renderer.lastPresentTime();
+            }
+            double intendedMs = (shownPts - firstPts) * timeBase * 1000.0;
+            double actualMs = std::chrono::duration<double, std::milli>(renderer.lastPresentTime() - start).count();
+            result.samples.push_back({intendedMs, actualMs});
+            delaysMs.push_back(frameDelay * 1000.0);
+        }
+        if (!decoded) {
+            break;
+        }
+        if (firstPts == AV_NOPTS_VALUE) {
+            firstPts = pts;
+        }
+        if ((pts - firstPts) * timeBase > options.seconds) {
+            break;
+        }
+        av_frame_unref(shown);
+        av_frame_ref(shown, decoder.getDecodedFrame());
+        shownPts = pts;
+    }
+    av_frame_free(&shown);
+
+    if (result.samples.empty()) {
+        std::cerr << "No frames were presented.\n";
+        return false;
+    }
+
+    // A frame shown more than its own slot length off its slot counts as missed
+    std::vector<double> jitter;
+    jitter.reserve(result.samples.size());
+    for (size_t i = 0; i < result.samples.size(); i++) {
+        double offset = std::fabs(result.samples[i].actualMs - result.samples[i].intendedMs);
+        jitter.push_back(offset);
+        if (offset > delaysMs[i]) {
+            result.missed++;
+        }
+    }
+    std::sort(jitter.begin(), jitter.end());
+    auto percentile = [&jitter](double p) {
+        return jitter[static_cast<size_t>(p * (jitter.size() - 1) + 0.5)];
+    };
+    result.p50JitterMs = percentile(0.50);
+    result.p99JitterMs = percentile(0.99);
+    result.maxJitterMs = jitter.back();
+    result.dropRate = static_cast<double>(result.missed) / result.samples.size();
+    result.passed = result.p99JitterMs <= options.maxP99JitterMs && result.dropRate <= options.maxDropRate;
+    return true;
+}
+
+void printJitterReport(const JitterTestOptions& options, const JitterTestResult& result) {
+    std::cout << options.filePath << ": " << result.samples.size() << " frames\n"
+              << "  jitter p50: " << result.p50JitterMs << " ms\n"
+              << "  jitter p99: " << result.p99JitterMs << " ms (limit " << options.maxP99JitterMs << ")\n"
+              << "  jitter max: " << result.maxJitterMs << " ms\n"
+              << "  missed:     " << result.missed << " (" << result.dropRate * 100.0 << "%, limit "
+              << options.maxDropRate * 100.0 << "%)\n"
+              << (result.passed ? "PASS" : "FAIL") << std::endl;
+}
+
+bool writeJitterJson(const JitterTestResult& result, const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << " for writing." << std::endl;
+        return false;
+    }
+    file << "{\n"
+         << "  \"passed\": " << (result.passed ? "true" : "false") << ",\n"
+         << "  \"frames\": " << result.samples.size() << ",\n"
+         << "  \"missed\": " << result.missed << ",\n"
+         << "  \"drop_rate\": " << result.dropRate << ",\n"
+         << "  \"jitter_p50_ms\": " << result.p50JitterMs << ",\n"
+         << "  \"jitter_p99_ms\": " << result.p99JitterMs << ",\n"
+         << "  \"jitter_max_ms\": " << result.maxJitterMs << ",\n"
+         << "  \"samples\": [";
+    for (size_t i = 0; i < result.samples.size(); i++) {
+        file << (i ? ",\n    " : "\n    ")
+             << "[" << result.samples[i].intendedMs << ", " << result.samples[i].actualMs << "]";
+    }
+    file << "\n  ]\n}\n";
+    return file.good();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+// Plays a clip through Renderer::renderFrame at real-time pace in a hidden window and
+// compares every frame's actual presentation time with the one its PTS asks for.
+// On machines without a display run it under xvfb-run with LIBGL_ALWAYS_SOFTWARE=1
+// so Mesa's software rasterizer provides the context.
+struct JitterTestOptions {
+    std::string filePath;
+    // Media time to play; stops earlier at end of file
+    double seconds = 30.0;
+    double maxP99JitterMs = 8.0;
+    double maxDropRate = 0.01;
+    // Empty skips the JSON report
+    std::string jsonPath;
+};
+
+struct JitterTestResult {
+    struct Sample {
+        double intendedMs;
+        double actualMs;
+    };
+
+    std::vector<Sample> samples;
+    int64_t missed = 0;
+    double p50JitterMs = 0.0;
+    double p99JitterMs = 0.0;
+    double maxJitterMs = 0.0;
+    double dropRate = 0.0;
+    bool passed = false;
+};
+
+bool runJitterTest(const JitterTestOptions& options, JitterTestResult& result);
+void printJitterReport(const JitterTestOptions& options, const JitterTestResult& result);
+bool writeJitterJson(const JitterTestResult& result, const std::string& path);
@@ -0,0 +1,161 @@
+#include "keyframe_decoder.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <iostream>
+
+
+KeyframeDecoder::KeyframeDecoder()
+    : m_formatContext(nullptr), m_codecContext(nullptr), m_packet(nullptr), m_frame(nullptr),
+      m_swsContext(nullptr), m_streamIndex(-1), m_maxWidth(0) {
+}
+
+KeyframeDecoder::~KeyframeDecoder() {
+    close();
+}
+
+// Polled by libavformat during blocking I/O
+int KeyframeDecoder::interruptCallback(void* opaque) {
+    return static_cast<KeyframeDecoder*>(opaque)->isCancelled() ? 1 : 0;
+}
+
+bool KeyframeDecoder::open(const std::string& filePath, int maxWidth, CancelCallback cancelled) {
+    close();
+    m_maxWidth = maxWidth;
+    m_cancelled = std::move(cancelled);
+
+    m_formatContext = avformat_alloc_context();
+    m_formatContext->interrupt_callback.callback = &KeyframeDecoder::interruptCallback;
+    m_formatContext->interrupt_callback.opaque = this;
+    if (avformat_open_input(&m_formatContext, filePath.c_str(), nullptr, nullptr) != 0 ||
+        avformat_find_stream_info(m_formatContext, nullptr) < 0) {
+        std::cerr << "Keyframe decoder: couldn't open " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    const AVCodec* codec = nullptr;
+    m_streamIndex = av_find_best_stream(m_formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (m_streamIndex < 0) {
+        close();
+        return false;
+    }
+    for (unsigned int i = 0; i < m_formatContext->nb_streams; i++) {
+        if (static_cast<int>(i) != m_streamIndex) {
+            m_formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    m_codecContext = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(m_codecContext, m_formatContext->streams[m_streamIndex]->codecpar);
+    // One thread: background decodes must not take cores from playback
+    m_codecContext->thread_count = 1;
+    m_codecContext->skip_frame = AVDISCARD_NONKEY;
+    m_codecContext->skip_loop_filter = AVDISCARD_ALL;
+    // Each lowres step halves both dimensions; stop before going below the output size
+    int lowres = 0;
+    while (lowres < codec->max_lowres && (m_codecContext->width >> (lowres + 1)) >= m_maxWidth) {
+        lowres++;
+    }
+    m_codecContext->lowres = lowres;
+    if (avcodec_open2(m_codecContext, codec, nullptr) < 0) {
+        close();
+        return false;
+    }
+
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    return true;
+}
+
+void KeyframeDecoder::close() {
+    sws_freeContext(m_swsContext);
+    m_swsContext = nullptr;
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+    avcodec_free_context(&m_codecContext);
+    avformat_close_input(&m_formatContext);
+    m_streamIndex = -1;
+}
+
+double KeyframeDecoder::getDuration() const {
+    if (!m_formatContext || m_formatContext->duration == AV_NOPTS_VALUE) {
+        return 0.0;
+    }
+    return m_formatContext->duration / static_cast<double>(AV_TIME_BASE);
+}
+
+int KeyframeDecoder::outputWidth() const {
+    if (!m_formatContext) {
+        return 0;
+    }
+    return std::min(m_maxWidth, m_formatContext->streams[m_streamIndex]->codecpar->width);
+}
+
+int KeyframeDecoder::outputHeight() const {
+    if (!m_formatContext) {
+        return 0;
+    }
+    const AVCodecParameters* params = m_formatContext->streams[m_streamIndex]->codecpar;
+    if (params->width <= 0) {
+        return 0;
+    }
+    return std::max(1, static_cast<int>(static_cast<int64_t>(params->height) * outputWidth() / params->width));
+}
+
+bool KeyframeDecoder::decodeNear(double seconds, PreviewFrame& frame) {
+    TraceScope trace("keyframe_decode");
+    if (!isOpen()) {
+        return false;
+    }
+    AVStream* stream = m_formatContext->streams[m_streamIndex];
+    int64_t target = av_rescale_q(static_cast<int64_t>(seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        target += stream->start_time;
+    }
+    if (av_seek_frame(m_formatContext, m_streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+    avcodec_flush_buffers(m_codecContext);
+
+    // The first keyframe after the seek point is the one we landed on. Draining right after
+    // it gets the picture out without waiting for the packets a reordering decoder wants.
+    bool sent = false;
+    while (!sent && !isCancelled() && av_read_frame(m_formatContext, m_packet) >= 0) {
+        if (m_packet->stream_index == m_streamIndex && (m_packet->flags & AV_PKT_FLAG_KEY)) {
+            sent = avcodec_send_packet(m_codecContext, m_packet) == 0;
+        }
+        av_packet_unref(m_packet);
+    }
+    if (!sent || isCancelled()) {
+        return false;
+    }
+    avcodec_send_packet(m_codecContext, nullptr);
+    int ret = avcodec_receive_frame(m_codecContext, m_frame);
+    // Drained decoders only accept new input after a flush, which the next call does
+    if (ret < 0) {
+        return false;
+    }
+
+    // Scale to the size computed from the stream, not from the lowres frame, so every
+    // frame of a file comes out the same size
+    int width = outputWidth();
+    int height = outputHeight();
+    m_swsContext = sws_getCachedContext(m_swsContext,
+        m_frame->width, m_frame->height, static_cast<AVPixelFormat>(m_frame->format),
+        width, height, AV_PIX_FMT_RGB24, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    if (!m_swsContext) {
+        av_frame_unref(m_frame);
+        return false;
+    }
+    frame.rgb.resize(static_cast<size_t>(width) * height * 3);
+    uint8_t* dst[4] = {frame.rgb.data(), nullptr, nullptr, nullptr};
+    int dstStride[4] = {width * 3, 0, 0, 0};
+    sws_scale(m_swsContext, m_frame->data, m_frame->linesize, 0, m_frame->height, dst, dstStride);
+
+    frame.pts = m_frame->best_effort_timestamp;
+    frame.seconds = (frame.pts - (stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0)) * av_q2d(stream->time_base);
+    frame.width = width;
+    frame.height = height;
+    av_frame_unref(m_frame);
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libswscale/swscale.h>
+}
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+struct PreviewFrame {
+    // PTS in the video stream's time base, and the same position in seconds
+    int64_t pts = 0;
+    double seconds = 0.0;
+    int width = 0;
+    int height = 0;
+    // Tightly packed RGB24
+    std::vector<uint8_t> rgb;
+};
+
+// Synchronous keyframe grabber behind PreviewDecoder and ThumbnailService. Owns its own
+// demuxer and a single-threaded decoder that only decodes keyframes, with the loop filter
+// off and at the codec's reduced `lowres` scale where supported, and downscales the
+// result to RGB24 no wider than maxWidth. Not thread-safe; one instance per thread.
+class KeyframeDecoder {
+public:
+    // Returns true to abandon the current decode, including blocking reads
+    using CancelCallback = std::function<bool()>;
+
+    KeyframeDecoder();
+    ~KeyframeDecoder();
+    KeyframeDecoder (const KeyframeDecoder &) =delete;
+    KeyframeDecoder& operator=(const KeyframeDecoder &) =delete;
+
+    bool open(const std::string& filePath, int maxWidth, CancelCallback cancelled = nullptr);
+    void close();
+    bool isOpen() const { return m_codecContext != nullptr; }
+
+    // Decodes the keyframe at or before `seconds`
+    bool decodeNear(double seconds, PreviewFrame& frame);
+    double getDuration() const;
+    // Size decodeNear produces, before any frame has been decoded
+    int outputWidth() const;
+    int outputHeight() const;
+
+private:
+    static int interruptCallback(void* opaque);
+    bool isCancelled() const { return m_cancelled && m_cancelled(); }
+
+    AVFormatContext* m_formatContext;
+    AVCodecContext* m_codecContext;
+    AVPacket* m_packet;
+    AVFrame* m_frame;
+    SwsContext* m_swsContext;
+    int m_streamIndex;
+    int m_maxWidth;
+    CancelCallback m_cancelled;
+};
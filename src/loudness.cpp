@@ -0,0 +1,356 @@
+#include "loudness.hpp"
+#include "audio_kernels.hpp"
+#include "media_cache.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'M', 'P', 'L', 'O', 'U', 'D', '0', '1'};
+
+struct CacheHeader {
+    char magic[8];
+    double integratedLufs;
+    double maxMomentaryLufs;
+    double maxShortTermLufs;
+    double truePeakDbtp;
+    int64_t steps;
+};
+
+// Sub-blocks per window: BS.1770 gating blocks are 400 ms, EBU R128 short-term is 3 s
+constexpr int MOMENTARY_STEPS = 4;
+constexpr int SHORT_TERM_STEPS = 30;
+constexpr double ABSOLUTE_GATE_LUFS = -70.0;
+constexpr double RELATIVE_GATE_LU = -10.0;
+
+double powerToLufs(double power) {
+    return power > 0.0 ? -0.691 + 10.0 * std::log10(power) : -std::numeric_limits<double>::infinity();
+}
+
+// BS.1770 K-weighting: a high shelf for the head's acoustic effect, then the RLB high-pass.
+// Derived per sample rate from the analog prototypes rather than the 48 kHz table.
+void kWeighting(int sampleRate, BiquadCoefficients stages[2]) {
+    const double pi = 3.14159265358979323846;
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        stages[0].b0 = (vh + vb * k / q + k * k) / a0;
+        stages[0].b1 = 2.0 * (k * k - vh) / a0;
+        stages[0].b2 = (vh - vb * k / q + k * k) / a0;
+        stages[0].a1 = 2.0 * (k * k - 1.0) / a0;
+        stages[0].a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        stages[1].b0 = 1.0;
+        stages[1].b1 = -2.0;
+        stages[1].b2 = 1.0;
+        stages[1].a1 = 2.0 * (k * k - 1.0) / a0;
+        stages[1].a2 = (1.0 - k / q + k * k) / a0;
+    }
+}
+
+// Blackman-windowed sinc for 4x interpolation. Phase 0 reproduces the input samples, the
+// other three land between them.
+void truePeakFilter(TruePeakFilter& filter) {
+    const double pi = 3.14159265358979323846;
+    const int length = TRUE_PEAK_PHASES * TRUE_PEAK_TAPS;
+    const double centre = length / 2.0;
+    double h[TRUE_PEAK_PHASES * TRUE_PEAK_TAPS];
+    for (int n = 0; n < length; n++) {
+        double t = (n - centre) / TRUE_PEAK_PHASES;
+        double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+        double window = 0.42 - 0.5 * std::cos(2.0 * pi * n / length) + 0.08 * std::cos(4.0 * pi * n / length);
+        h[n] = sinc * window;
+    }
+    // The kernel walks history oldest first
+    for (int phase = 0; phase < TRUE_PEAK_PHASES; phase++) {
+        for (int tap = 0; tap < TRUE_PEAK_TAPS; tap++) {
+            filter[phase][tap] = static_cast<float>(h[phase + TRUE_PEAK_PHASES * (TRUE_PEAK_TAPS - 1 - tap)]);
+        }
+    }
+}
+
+// BS.1770 channel weights: surrounds count 1.41x, LFE not at all
+double channelWeight(AVChannel channel) {
+    switch (channel) {
+        case AV_CHAN_LOW_FREQUENCY:
+        case AV_CHAN_LOW_FREQUENCY_2:
+            return 0.0;
+        case AV_CHAN_BACK_LEFT:
+        case AV_CHAN_BACK_RIGHT:
+        case AV_CHAN_SIDE_LEFT:
+        case AV_CHAN_SIDE_RIGHT:
+            return 1.41;
+        default:
+            return 1.0;
+    }
+}
+
+}
+
+LoudnessMeter::LoudnessMeter(int sampleRate, const AVChannelLayout& layout)
+    : m_channels(layout.nb_channels),
+      m_subBlockSamples(static_cast<int>(std::lround(sampleRate * LoudnessResult::STEP_SECONDS))),
+      m_subBlockFill(0), m_weights(m_channels), m_filters((m_channels + 1) / 2),
+      m_sums(m_filters.size() * 2, 0.0), m_history(m_channels), m_peak(0.0f) {
+    BiquadCoefficients stages[2];
+    kWeighting(sampleRate, stages);
+    for (BiquadCascadePair& filter : m_filters) {
+        filter.stages[0] = stages[0];
+        filter.stages[1] = stages[1];
+    }
+    for (int c = 0; c < m_channels; c++) {
+        m_weights[c] = channelWeight(av_channel_layout_channel_from_index(&layout, c));
+        m_history[c].assign(TRUE_PEAK_TAPS - 1, 0.0f);
+    }
+    truePeakFilter(m_peakFilter);
+}
+
+void LoudnessMeter::process(const float* const* planes, int count) {
+    updatePeak(planes, count);
+    int offset = 0;
+    while (offset < count) {
+        int take = std::min(count - offset, m_subBlockSamples - m_subBlockFill);
+        for (size_t pair = 0; pair < m_filters.size(); pair++) {
+            int a = static_cast<int>(pair * 2);
+            const float* second = a + 1 < m_channels ? planes[a + 1] + offset : nullptr;
+            filterSumSquares(m_filters[pair], planes[a] + offset, second, take, &m_sums[a]);
+        }
+        offset += take;
+        m_subBlockFill += take;
+        if (m_subBlockFill == m_subBlockSamples) {
+            endSubBlock();
+        }
+    }
+}
+
+void LoudnessMeter::finish(LoudnessResult& result) {
+    const double negativeInfinity = -std::numeric_limits<double>::infinity();
+    const size_t steps = m_powers.size();
+    result.momentary.assign(steps, static_cast<float>(negativeInfinity));
+    result.shortTerm.assign(steps, static_cast<float>(negativeInfinity));
+    result.maxMomentaryLufs = negativeInfinity;
+    result.maxShortTermLufs = negativeInfinity;
+
+    // Window means from prefix sums; windows near the start average what exists so far
+    std::vector<double> prefix(steps + 1, 0.0);
+    for (size_t i = 0; i < steps; i++) {
+        prefix[i + 1] = prefix[i] + m_powers[i];
+    }
+    auto windowPower = [&prefix](size_t end, size_t length) {
+        size_t begin = end + 1 >= length ? end + 1 - length : 0;
+        return (prefix[end + 1] - prefix[begin]) / (end + 1 - begin);
+    };
+    std::vector<double> blocks;
+    for (size_t i = 0; i < steps; i++) {
+        double momentary = windowPower(i, MOMENTARY_STEPS);
+        double shortTerm = windowPower(i, SHORT_TERM_STEPS);
+        result.momentary[i] = static_cast<float>(powerToLufs(momentary));
+        result.shortTerm[i] = static_cast<float>(powerToLufs(shortTerm));
+        if (i + 1 >= MOMENTARY_STEPS) {
+            blocks.push_back(momentary);
+            result.maxMomentaryLufs = std::max(result.maxMomentaryLufs, powerToLufs(momentary));
+        }
+        if (i + 1 >= SHORT_TERM_STEPS) {
+            result.maxShortTermLufs = std::max(result.maxShortTermLufs, powerToLufs(shortTerm));
+        }
+    }
+
+    // Two-stage gating: absolute at -70 LUFS, then 10 LU below the absolutely-gated mean
+    auto gatedMean = [&blocks](double threshold) {
+        double sum = 0.0;
+        size_t count = 0;
+        for (double power : blocks) {
+            if (powerToLufs(power) > threshold) {
+                sum += power;
+                count++;
+            }
+        }
+        return count > 0 ? sum / count : 0.0;
+    };
+    double absoluteMean = gatedMean(ABSOLUTE_GATE_LUFS);
+    double relativeGate = std::max(ABSOLUTE_GATE_LUFS, powerToLufs(absoluteMean) + RELATIVE_GATE_LU);
+    result.integratedLufs = absoluteMean > 0.0 ? powerToLufs(gatedMean(relativeGate)) : negativeInfinity;
+    result.truePeakDbtp = m_peak > 0.0f ? 20.0 * std::log10(m_peak) : negativeInfinity;
+}
+
+void LoudnessMeter::endSubBlock() {
+    double power = 0.0;
+    for (int c = 0; c < m_channels; c++) {
+        power += m_weights[c] * m_sums[c] / m_subBlockSamples;
+    }
+    m_powers.push_back(power);
+    std::fill(m_sums.begin(), m_sums.end(), 0.0);
+    m_subBlockFill = 0;
+}
+
+void LoudnessMeter::updatePeak(const float* const* planes, int count) {
+    const size_t history = TRUE_PEAK_TAPS - 1;
+    for (int c = 0; c < m_channels; c++) {
+        std::vector<float>& buffer = m_history[c];
+        buffer.resize(history + count);
+        std::copy_n(planes[c], count, buffer.begin() + history);
+        m_peak = std::max(m_peak, interpolatedPeak(buffer.data() + history, count, m_peakFilter));
+        // Keep the newest samples as history for the next block
+        std::copy(buffer.end() - history, buffer.end(), buffer.begin());
+        buffer.resize(history);
+    }
+}
+
+double normalizationGainDb(const LoudnessResult& result, double targetLufs, double ceilingDbtp) {
+    if (!std::isfinite(result.integratedLufs)) {
+        return 0.0;
+    }
+    double gain = targetLufs - result.integratedLufs;
+    if (std::isfinite(result.truePeakDbtp)) {
+        gain = std::min(gain, ceilingDbtp - result.truePeakDbtp);
+    }
+    return gain;
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer()
+    : m_totalSamples(0), m_fromCache(false), m_succeeded(false), m_stop(false), m_finished(false),
+      m_samplesScanned(0) {
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer() {
+    stop();
+}
+
+bool LoudnessAnalyzer::start(const std::string& filePath, const LoudnessOptions& options) {
+    stop();
+    m_stop = false;
+    m_finished = false;
+    m_fromCache = false;
+    m_succeeded = false;
+    m_samplesScanned = 0;
+    m_totalSamples = 0;
+    m_filePath = filePath;
+    m_result = LoudnessResult();
+
+    m_cachePath.clear();
+    std::string cacheDir = options.cacheDir.empty() ? mediaCacheDir("loudness") : options.cacheDir;
+    if (!cacheDir.empty()) {
+        int32_t layout[1] = {1};
+        m_cachePath = mediaCachePath(cacheDir, filePath, layout, sizeof(layout), ".loudness");
+    }
+    if (!m_cachePath.empty() && loadCache()) {
+        m_fromCache = true;
+        m_succeeded = true;
+        m_finished = true;
+        return true;
+    }
+    m_worker = std::thread(&LoudnessAnalyzer::run, this);
+    return true;
+}
+
+void LoudnessAnalyzer::stop() {
+    m_stop = true;
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+double LoudnessAnalyzer::progress() const {
+    if (m_finished) {
+        return 1.0;
+    }
+    return m_totalSamples > 0 ? std::min(1.0, static_cast<double>(m_samplesScanned) / m_totalSamples) : 0.0;
+}
+
+void LoudnessAnalyzer::run() {
+    Tracer::instance().setThreadName("loudness");
+#ifdef __linux__
+    // Only runs on otherwise idle cores
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    AudioScanner scanner;
+    if (!scanner.open(m_filePath, false, [this] { return m_stop.load(); })) {
+        m_finished = true;
+        return;
+    }
+    m_totalSamples = scanner.totalSamples();
+    LoudnessMeter meter(scanner.sampleRate(), scanner.layout());
+    // Scan to the real end even when the container duration is short; running out of
+    // file is the expected way for this scan to end
+    scanner.scan(0, std::numeric_limits<int64_t>::max(), [&](const float* const* planes, int count) {
+        meter.process(planes, count);
+        m_samplesScanned += count;
+    });
+    if (m_stop) {
+        return;
+    }
+    meter.finish(m_result);
+    // A read or decode error part way leaves a measurement of only part of the file,
+    // which is neither applied nor cached
+    m_succeeded = m_samplesScanned > 0 && !scanner.failed();
+    if (m_succeeded && !m_cachePath.empty()) {
+        writeCache();
+    }
+    m_finished = true;
+}
+
+bool LoudnessAnalyzer::loadCache() {
+    std::ifstream file(m_cachePath, std::ios::binary);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.steps < 0) {
+        return false;
+    }
+    m_result.integratedLufs = header.integratedLufs;
+    m_result.maxMomentaryLufs = header.maxMomentaryLufs;
+    m_result.maxShortTermLufs = header.maxShortTermLufs;
+    m_result.truePeakDbtp = header.truePeakDbtp;
+    m_result.momentary.resize(header.steps);
+    m_result.shortTerm.resize(header.steps);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(m_result.momentary.data()), header.steps * sizeof(float)) &&
+                             file.read(reinterpret_cast<char*>(m_result.shortTerm.data()), header.steps * sizeof(float)));
+}
+
+void LoudnessAnalyzer::writeCache() const {
+    // Write then rename so a crash never leaves a truncated cache entry behind
+    std::string tempPath = m_cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header;
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.integratedLufs = m_result.integratedLufs;
+        header.maxMomentaryLufs = m_result.maxMomentaryLufs;
+        header.maxShortTermLufs = m_result.maxShortTermLufs;
+        header.truePeakDbtp = m_result.truePeakDbtp;
+        header.steps = static_cast<int64_t>(m_result.momentary.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(m_result.momentary.data()), m_result.momentary.size() * sizeof(float));
+        file.write(reinterpret_cast<const char*>(m_result.shortTerm.data()), m_result.shortTerm.size() * sizeof(float));
+        if (!file) {
+            std::cerr << "Couldn't write loudness cache " << tempPath << std::endl;
+            file.close();
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+    if (std::rename(tempPath.c_str(), m_cachePath.c_str()) != 0) {
+        std::cerr << "Couldn't update loudness cache " << m_cachePath << std::endl;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "audio_kernels.hpp"
+#include "audio_scanner.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// EBU R128 / ITU-R BS.1770-4 measurements of a whole file. Silence reads as -inf.
+struct LoudnessResult {
+    double integratedLufs = 0.0;
+    double maxMomentaryLufs = 0.0;
+    double maxShortTermLufs = 0.0;
+    double truePeakDbtp = 0.0;
+    // One value every STEP_SECONDS: loudness of the 400 ms (momentary) and 3 s (short-term)
+    // windows ending there
+    static constexpr double STEP_SECONDS = 0.1;
+    std::vector<float> momentary;
+    std::vector<float> shortTerm;
+};
+
+// Gain that brings the integrated loudness to `targetLufs`, lowered where needed so the
+// true peak stays below `ceilingDbtp`. 0 for silence.
+double normalizationGainDb(const LoudnessResult& result, double targetLufs = -23.0, double ceilingDbtp = -1.0);
+
+// Streaming meter: K-weighted power per 100 ms sub-block plus the running true peak.
+// The windows and gating are evaluated from the sub-blocks by finish().
+class LoudnessMeter {
+public:
+    LoudnessMeter(int sampleRate, const AVChannelLayout& layout);
+
+    // `planes` holds one pointer per channel of the layout to `count` samples
+    void process(const float* const* planes, int count);
+    void finish(LoudnessResult& result);
+
+private:
+    void endSubBlock();
+    void updatePeak(const float* const* planes, int count);
+
+    int m_channels;
+    int m_subBlockSamples;
+    int m_subBlockFill;
+    std::vector<double> m_weights;
+    std::vector<BiquadCascadePair> m_filters;
+    // K-weighted sum of squares per channel in the current sub-block
+    std::vector<double> m_sums;
+    // Weighted mean square of each finished sub-block
+    std::vector<double> m_powers;
+    // Per channel, the last TRUE_PEAK_TAPS - 1 samples followed by the current block
+    std::vector<std::vector<float>> m_history;
+    TruePeakFilter m_peakFilter;
+    float m_peak;
+};
+
+struct LoudnessOptions {
+    // Empty uses mediaCacheDir("loudness"); caching is skipped if there's none
+    std::string cacheDir;
+};
+
+// Scans a file's audio on one idle-priority background thread with its own
+// AudioScanner, so playback keeps every core it had. K-weighting and the 4x true-peak
+// interpolator run through the SIMD kernels. Results are cached on disk.
+class LoudnessAnalyzer {
+public:
+    LoudnessAnalyzer();
+    ~LoudnessAnalyzer();
+    LoudnessAnalyzer (const LoudnessAnalyzer &) =delete;
+    LoudnessAnalyzer& operator=(const LoudnessAnalyzer &) =delete;
+
+    bool start(const std::string& filePath, const LoudnessOptions& options = LoudnessOptions());
+    void stop();
+
+    bool finished() const { return m_finished.load(); }
+    // Whether the scan got through the whole file; false results are partial
+    bool succeeded() const { return m_succeeded; }
+    // Fraction of the audio scanned so far
+    double progress() const;
+    bool loadedFromCache() const { return m_fromCache; }
+    // Only valid once finished()
+    const LoudnessResult& result() const { return m_result; }
+
+private:
+    void run();
+    bool loadCache();
+    void writeCache() const;
+
+    std::thread m_worker;
+    std::string m_filePath;
+    std::string m_cachePath;
+    int64_t m_totalSamples;
+    bool m_fromCache;
+    bool m_succeeded;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_finished;
+    std::atomic<int64_t> m_samplesScanned;
+    LoudnessResult m_result;
+};
@@ -1,15 +1,397 @@
 #include "video_decoder.hpp"
+#include "command_line.hpp"
 #include "renderer.hpp"
 #include "audio_player.hpp"
+#include "tracer.hpp"
+#include "metrics_exporter.hpp"
+#include "headless_bench.hpp"
+#include "jitter_harness.hpp"
+#include "soak_test.hpp"
+#include "frame_hash.hpp"
+#include "trick_play.hpp"
+#include "thumbnail_service.hpp"
+#include "waveform.hpp"
+#include "loudness.hpp"
+#include "drift_controller.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
 
 
-int main() {
+static void printUsage() {
+    std::cerr << "usage: MediaPlayer [file] [--clock audio|external]\n"
+              << "       MediaPlayer --bench-decode <file> [--convert] [--frames N] [--json out.json]\n"
+              << "       MediaPlayer --jitter-test <file> [--seconds S] [--max-p99-ms MS] [--max-drop-rate R] [--json out.json]\n"
+              << "       MediaPlayer --soak <file> [--hours H] [--max-growth-mb MB] [--json out.json]\n"
+              << "       MediaPlayer --frame-hash <file> [--out hashes.txt] [--compare golden.txt] [--no-convert] [--no-audio]\n"
+              << "       MediaPlayer --thumbnails <file> [--count N] [--workers N] [--width W] [--cache-dir DIR] [--out atlas.ppm]\n"
+              << "       MediaPlayer --waveform <file> [--workers N] [--pixels N] [--cache-dir DIR] [--out columns.csv]\n";
+}
+
+// Decode as fast as possible without a window; prints a text report and optionally writes JSON
+static int decodeBenchCommand(int argc, char** argv) {
+    DecodeBenchOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--convert") {
+            options.convert = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.maxFrames, 1, std::numeric_limits<int64_t>::max())) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else if (options.filePath.empty() && arg[0] != '-') {
+            options.filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (options.filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    DecodeBenchResult result;
+    if (!runDecodeBenchmark(options, result)) {
+        return -1;
+    }
+    printDecodeBenchReport(result, std::cout);
+    if (!options.jsonPath.empty() && !writeDecodeBenchJson(result, options.jsonPath)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Real-time playback in a hidden window; exits non-zero when jitter or missed frames exceed the limits
+static int jitterTestCommand(int argc, char** argv) {
+    JitterTestOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.seconds, 0.1, 24.0 * 3600.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--max-p99-ms" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.maxP99JitterMs, 0.0, 1000.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--max-drop-rate" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.maxDropRate, 0.0, 1.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else if (options.filePath.empty() && arg[0] != '-') {
+            options.filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (options.filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    JitterTestResult result;
+    if (!runJitterTest(options, result)) {
+        return -1;
+    }
+    printJitterReport(options, result);
+    if (!options.jsonPath.empty()) {
+        writeJitterJson(result, options.jsonPath);
+    }
+    return result.passed ? 0 : 1;
+}
+
+// Reopen, decode and seek the same file for hours; exits non-zero on memory growth or leaked frame buffers
+static int soakCommand(int argc, char** argv) {
+    SoakTestOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--hours" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.hours, 0.001, 1000.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--max-growth-mb" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.maxGrowthMb, 0.0, 1024.0 * 1024.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else if (options.filePath.empty() && arg[0] != '-') {
+            options.filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (options.filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    SoakTestResult result;
+    if (!runSoakTest(options, result)) {
+        return -1;
+    }
+    printSoakReport(options, result);
+    if (!options.jsonPath.empty()) {
+        writeSoakJson(result, options.jsonPath);
+    }
+    return result.passed ? 0 : 1;
+}
+
+// Hash every decoded, converted and audio frame; exits non-zero when a golden file doesn't match
+static int frameHashCommand(int argc, char** argv) {
+    FrameHashOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            options.goldenPath = argv[++i];
+        } else if (arg == "--no-convert") {
+            options.convert = false;
+        } else if (arg == "--no-audio") {
+            options.audio = false;
+        } else if (options.filePath.empty() && arg[0] != '-') {
+            options.filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (options.filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    FrameHashResult result;
+    if (!runFrameHash(options, result)) {
+        return -1;
+    }
+    std::cerr << result.videoFrames << " video and " << result.audioFrames << " audio frames hashed in "
+              << result.seconds << " s";
+    if (!options.goldenPath.empty()) {
+        std::cerr << ", " << result.mismatches << " mismatches";
+    }
+    std::cerr << std::endl;
+    return result.passed ? 0 : 1;
+}
+
+static int thumbnailsCommand(int argc, char** argv) {
+    std::string filePath;
+    std::string outputPath;
+    ThumbnailOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.count, 1, 10000)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--workers" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.workers, 1, 64)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--width" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.maxWidth, 16, 4096)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (filePath.empty() && arg[0] != '-') {
+            filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ThumbnailService thumbnails;
+    if (!thumbnails.start(filePath, options)) {
+        return -1;
+    }
+    // Assemble the atlas from the progressive updates, as a texture upload would
+    std::vector<uint8_t> atlas(static_cast<size_t>(thumbnails.atlasWidth()) * thumbnails.atlasHeight() * 3, 0);
+    std::vector<ThumbnailUpdate> updates;
+    int received = 0;
+    double firstSeconds = -1.0;
+    while (received < thumbnails.count()) {
+        // Checked first: everything finished by now is in the updates taken next
+        bool finished = thumbnails.finished();
+        if (!thumbnails.takeUpdates(updates)) {
+            if (finished) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (firstSeconds < 0.0) {
+            firstSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        for (const ThumbnailUpdate& update : updates) {
+            size_t rowBytes = static_cast<size_t>(update.width) * 3;
+            for (int row = 0; row < update.height; row++) {
+                std::copy_n(update.rgb.data() + row * rowBytes, rowBytes,
+                            atlas.data() + ((update.y + row) * static_cast<size_t>(thumbnails.atlasWidth()) + update.x) * 3);
+            }
+        }
+        received += static_cast<int>(updates.size());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << received << "/" << thumbnails.count() << " thumbnails of " << thumbnails.cellWidth() << "x"
+              << thumbnails.cellHeight() << (thumbnails.loadedFromCache() ? " from cache" : "")
+              << ", first after " << firstSeconds * 1000.0 << " ms, all after " << seconds * 1000.0 << " ms" << std::endl;
+
+    if (!outputPath.empty()) {
+        std::ofstream file(outputPath, std::ios::binary);
+        file << "P6\n" << thumbnails.atlasWidth() << " " << thumbnails.atlasHeight() << "\n255\n";
+        file.write(reinterpret_cast<const char*>(atlas.data()), atlas.size());
+    }
+    return received == thumbnails.count() ? 0 : 1;
+}
+
+static int waveformCommand(int argc, char** argv) {
+    std::string filePath;
+    std::string outputPath;
+    int pixels = 1000;
+    WaveformOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--workers" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], options.workers, 1, 64)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--pixels" && i + 1 < argc) {
+            if (!parseNumber(argv[++i], pixels, 1, 1 << 20)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (filePath.empty() && arg[0] != '-') {
+            filePath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (filePath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    WaveformAnalyzer analyzer;
+    if (!analyzer.start(filePath, options)) {
+        return -1;
+    }
+    while (!analyzer.finished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const WaveformPyramid& pyramid = analyzer.pyramid();
+    if (pyramid.empty()) {
+        std::cerr << "No audio could be scanned" << std::endl;
+        return 1;
+    }
+    double duration = static_cast<double>(pyramid.totalSamples()) / pyramid.sampleRate();
+    std::cerr << duration << " s of audio, " << pyramid.levelCount() << " levels"
+              << (analyzer.loadedFromCache() ? " from cache" : "") << " in " << seconds * 1000.0 << " ms" << std::endl;
+
+    if (!outputPath.empty()) {
+        std::vector<WaveformBucket> columns;
+        pyramid.query(0.0, duration, pixels, columns);
+        std::ofstream file(outputPath);
+        file << "column,min,max,rms\n";
+        for (size_t i = 0; i < columns.size(); i++) {
+            file << i << "," << columns[i].min << "," << columns[i].max << "," << columns[i].rms << "\n";
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string filePath = "resource/vid.mkv";
+    // External: video keeps its own clock and audio is resampled to follow it.
+    // Audio: the sound card is the master and video frame durations follow it instead.
+    bool audioMaster = false;
+    if (argc > 1) {
+        std::string arg = argv[1];
+        if (arg == "--bench-decode") {
+            return decodeBenchCommand(argc, argv);
+        }
+        if (arg == "--jitter-test") {
+            return jitterTestCommand(argc, argv);
+        }
+        if (arg == "--soak") {
+            return soakCommand(argc, argv);
+        }
+        if (arg == "--frame-hash") {
+            return frameHashCommand(argc, argv);
+        }
+        if (arg == "--thumbnails") {
+            return thumbnailsCommand(argc, argv);
+        }
+        if (arg == "--waveform") {
+            return waveformCommand(argc, argv);
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--clock" && i + 1 < argc) {
+            std::string clock = argv[++i];
+            if (clock != "audio" && clock != "external") {
+                printUsage();
+                return -1;
+            }
+            audioMaster = clock == "audio";
+        } else if (arg[0] == '-') {
+            printUsage();
+            return -1;
+        } else {
+            filePath = arg;
+        }
+    }
+
     MPDecoder decoder;
     Renderer renderer;
     AudioPlayer audioPlayer;
+    Tracer::instance().setThreadName("main");
+
+    // Opt-in: only runs when one of the MP_METRICS_* variables is set
+    MetricsExporter metricsExporter;
+    metricsExporter.startFromEnvironment();
 
-    if (!decoder.open("resource/vid.mkv")) {
+    if (!decoder.open(filePath)) {
         std::cerr << "Failed to open media file.\n";
         return -1;
     }
@@ -19,28 +401,236 @@ int main() {
         return -1;
     }
 
-    // if (decoder.getAudioChannels() > 0) {
-    //     if (!audioPlayer.init(decoder.getAudioSampleRate(), decoder.getAudioChannels())) {
-    //         std::cerr << "Failed to initialize audio player.\n";
-    //         return -1;
-    //     }
-    // }
+    // Loudness is measured in the background; normalization kicks in once it's known
+    LoudnessAnalyzer loudness;
+    bool loudnessApplied = false;
+    bool audioEnabled = false;
+    if (decoder.hasAudio()) {
+        // The device settles its spec first; the decoder then converts to exactly that
+        audioEnabled = audioPlayer.init(decoder.getAudioSampleRate(), decoder.getAudioChannels()) &&
+                       decoder.setAudioOutput(audioPlayer.channels(), audioPlayer.sampleRate());
+        if (audioEnabled) {
+            std::cerr << "Audio: " << decoder.getAudioConverter().describe() << " -> device "
+                      << audioPlayer.describe() << std::endl;
+            loudness.start(filePath);
+        } else {
+            std::cerr << "Failed to initialize audio player, playing without sound.\n";
+        }
+    }
+
+    // Dropping never goes on for longer than this, so a slow machine still shows something
+    constexpr int MAX_CONSECUTIVE_DROPS = 5;
+    // A/V offsets within this are left alone; it scales with the frame duration, as in ffplay
+    constexpr double AV_SYNC_MIN_THRESHOLD = 0.04;
+    constexpr double AV_SYNC_MAX_THRESHOLD = 0.1;
+    // Holding video lets the audio queue drain; it is never held below this
+    constexpr double AV_SYNC_MIN_QUEUED = 0.05;
+    DecodeQualityController quality;
+    TrickPlay trickPlay(decoder);
+    int consecutiveDrops = 0;
+    bool paused = false;
+    // Frame steps requested while paused, negative for backwards
+    int pendingSteps = 0;
+    int64_t loopStart = AV_NOPTS_VALUE;
+    // The frame cache only pays off for stepping and loops; plain playback never revisits a
+    // frame, so it's kept only while paused or looping and its memory is released after
+    auto updateFrameCache = [&] {
+        bool wanted = paused || trickPlay.hasLoop();
+        if (wanted != (decoder.getFrameCache() != nullptr)) {
+            decoder.setFrameCacheBudget(wanted ? FrameCache::DEFAULT_BYTE_BUDGET : 0);
+        }
+    };
+    DriftController drift;
+    // Container time just past the last audio queued, NaN until some has been
+    double audioQueuedEnd = std::nan("");
+    // Audio queued before a jump would play over the frames after it
+    auto resetAudio = [&] {
+        audioPlayer.clear();
+        drift.reset();
+        audioQueuedEnd = std::nan("");
+    };
+    trickPlay.setDiscontinuityHandler(resetAudio);
+    auto steadySeconds = [] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    if (audioEnabled) {
+        decoder.setAudioSink([&](const float* const* planes, int frames) {
+            // Up to 2x is time-stretched; faster and reverse rates are muted. Following the
+            // rate here also catches step(), which drops back to 1x on its own.
+            TrickPlay::AudioMode mode = trickPlay.audioMode();
+            if (!paused && mode != TrickPlay::AudioMode::Mute) {
+                audioPlayer.setTempo(mode == TrickPlay::AudioMode::TimeStretch ? trickPlay.rate() : 1.0);
+                int queued = audioPlayer.play(planes, frames);
+                // A full ring drops the tail of the chunk, which is never heard
+                if (queued > 0) {
+                    audioQueuedEnd = decoder.getAudioFrameEndSeconds() -
+                                     (frames - queued) / static_cast<double>(audioPlayer.sampleRate());
+                }
+                if (audioPlayer.adaptBuffer()) {
+                    // Another device buffer shifts the fill level the drift loop holds
+                    drift.reset();
+                }
+                // The renderer paces video off steady_clock, so that is what the ring drifts against
+                drift.update(audioPlayer.queuedSeconds(), steadySeconds());
+                if (!audioMaster) {
+                    decoder.setAudioCompensation(drift.correction());
+                }
+                Profiler::instance().setGauge(Gauge::AudioDriftPpm, std::lround(drift.driftPpm()));
+            }
+        });
+    }
+
+    // J/K/L shuttle: L speeds up forward, J speeds up in reverse, K returns to 1x.
+    // Space pauses, the arrow keys step a frame while paused, I and O set an A-B loop
+    // and Backspace clears it.
+    renderer.setKeyHandler([&](int key, bool repeat) {
+        if (key == GLFW_KEY_RIGHT || key == GLFW_KEY_LEFT) {
+            if (paused) {
+                pendingSteps += key == GLFW_KEY_RIGHT ? 1 : -1;
+            }
+            return;
+        }
+        if (repeat) {
+            return;
+        }
+        if (key == GLFW_KEY_SPACE) {
+            paused = !paused;
+            pendingSteps = 0;
+            audioPlayer.setPaused(paused);
+            updateFrameCache();
+            return;
+        }
+        if (key == GLFW_KEY_I) {
+            loopStart = trickPlay.displayPts();
+            return;
+        }
+        if (key == GLFW_KEY_O) {
+            trickPlay.setLoop(loopStart, trickPlay.displayPts());
+            updateFrameCache();
+            return;
+        }
+        if (key == GLFW_KEY_BACKSPACE) {
+            trickPlay.clearLoop();
+            updateFrameCache();
+            return;
+        }
+        double previousRate = trickPlay.rate();
+        if (key == GLFW_KEY_L) {
+            trickPlay.faster();
+        } else if (key == GLFW_KEY_J) {
+            trickPlay.slower();
+        } else if (key == GLFW_KEY_K) {
+            trickPlay.normal();
+        }
+        if (trickPlay.rate() != previousRate) {
+            // Whatever is queued belongs to the old rate
+            resetAudio();
+            // Misses measured at another rate say nothing about this one
+            quality.reset();
+            if (trickPlay.mode() == TrickPlay::Mode::Forward) {
+                decoder.setDecodeQuality(quality.level());
+            }
+            std::cerr << "Playback rate: " << trickPlay.rate() << "x" << std::endl;
+        }
+    });
 
     while (!glfwWindowShouldClose(renderer.getWindow())) {
-        if (decoder.decodeFrame()) {
-            if (decoder.getVideoFrame()) {
-                auto frame_rate = decoder.getFrameRate();
-                double delay = 1.0 / frame_rate.num * frame_rate.den;
+        if (!loudnessApplied && loudness.finished()) {
+            loudnessApplied = true;
+            if (loudness.succeeded()) {
+                double gainDb = normalizationGainDb(loudness.result());
+                audioPlayer.setGainDb(gainDb);
+                std::cerr << "Loudness: " << loudness.result().integratedLufs << " LUFS, true peak "
+                          << loudness.result().truePeakDbtp << " dBTP, normalization gain " << gainDb << " dB" << std::endl;
+            }
+        }
+        if (paused) {
+            if (pendingSteps != 0) {
+                int direction = pendingSteps > 0 ? 1 : -1;
+                pendingSteps -= direction;
+                AVFrame* frame = trickPlay.step(direction) ? trickPlay.displayFrame() : nullptr;
+                if (frame) {
+                    renderer.renderFrame(frame->data[0], decoder.getVideoWidth(), decoder.getVideoHeight(),
+                                         0.0, trickPlay.displayPts());
+                }
+            } else {
+                glfwWaitEventsTimeout(0.05);
+            }
+            continue;
+        }
+
+        double delay = 0.0;
+        if (trickPlay.nextFrame(delay)) {
+            int64_t pts = trickPlay.displayPts();
+            if (audioMaster && audioEnabled && trickPlay.mode() == TrickPlay::Mode::Forward) {
+                // Stretch frame durations so video consumes at the sound card's pace
+                delay *= 1.0 + drift.correction();
+            }
+            if (trickPlay.mode() == TrickPlay::Mode::Forward && trickPlay.rate() == 1.0 &&
+                std::isfinite(audioQueuedEnd) && audioPlayer.queuedSeconds() > 0.0) {
+                // Audio queued now reaches the speaker the output latency later. Compare it
+                // with this frame at its deadline, and correct with this frame's duration,
+                // which sets when the next one is shown.
+                auto now = std::chrono::steady_clock::now();
+                double untilShown = renderer.nextDeadline().time_since_epoch().count() == 0 ? 0.0
+                                  : std::max(0.0, std::chrono::duration<double>(renderer.nextDeadline() - now).count());
+                double queued = audioPlayer.queuedSeconds();
+                double heard = audioQueuedEnd - queued + untilShown;
+                double offset = pts * av_q2d(decoder.getVideoTimeBase()) - heard;
+                Profiler::instance().setGauge(Gauge::AvOffsetUs, std::lround(offset * 1e6));
+                double threshold = std::clamp(delay, AV_SYNC_MIN_THRESHOLD, AV_SYNC_MAX_THRESHOLD);
+                if (offset >= threshold) {
+                    // Video ahead: hold it while the queued audio plays out
+                    delay += std::min(offset, std::max(0.0, queued - AV_SYNC_MIN_QUEUED));
+                } else if (offset <= -threshold) {
+                    // Video behind: cut the frame short, and once a whole frame behind the
+                    // schedule check below drops frames until it has caught up
+                    delay = std::max(0.0, delay + offset);
+                }
+            }
+            if (trickPlay.mode() == TrickPlay::Mode::Keyframes) {
+                // Keyframes come on a fixed display clock; there is nothing to drop or degrade
+                if (AVFrame* frame = trickPlay.displayFrame()) {
+                    renderer.renderFrame(frame->data[0], decoder.getVideoWidth(), decoder.getVideoHeight(), delay, pts);
+                }
+                continue;
+            }
+
+            // A late frame is dropped before displayFrame(), so it is never converted
+            bool missed;
+            if (consecutiveDrops < MAX_CONSECUTIVE_DROPS && renderer.isBehindSchedule(delay)) {
+                renderer.dropFrame(delay);
+                consecutiveDrops++;
+                missed = true;
+            } else if (AVFrame* frame = trickPlay.displayFrame()) {
+                consecutiveDrops = 0;
                 renderer.renderFrame(
-                    decoder.getVideoFrame()->data[0],
+                    frame->data[0],
                     decoder.getVideoWidth(),
-                    decoder.getVideoHeight(), delay);
+                    decoder.getVideoHeight(), delay,
+                    pts);
+                missed = renderer.lastFrameLate();
+            } else {
+                continue;
             }
-            // if (decoder.getAudioFrame()) {
-            //     audioPlayer.play(decoder.getAudioFrame()->data[0], decoder.getAudioFrame()->linesize[0]);
-            // }
+
+            // Degrading the main decoder only helps forward playback
+            if (trickPlay.mode() == TrickPlay::Mode::Forward && quality.record(missed, delay)) {
+                decoder.setDecodeQuality(quality.level());
+                std::cerr << "Decode quality: " << decodeQualityName(quality.level()) << std::endl;
+            }
+        } else {
+            // At either end of the file, or reverse decoding is catching up: keep the window
+            // responsive so playback can be turned around. Only catching up needs a quick look.
+            glfwWaitEventsTimeout(trickPlay.isCatchingUp() ? 0.005 : 0.05);
         }
     }
 
+    // Flush a capture that was still running when the window closed
+    if (Tracer::instance().isEnabled()) {
+        Tracer::instance().stop();
+        Tracer::instance().writeJson("trace.json");
+    }
+
     return 0;
 }
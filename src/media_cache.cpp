@@ -0,0 +1,52 @@
+#include "media_cache.hpp"
+#include "frame_hash.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+
+std::string mediaCacheDir(const std::string& kind) {
+    std::filesystem::path base;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME"); home && *home) {
+        base = std::filesystem::path(home) / ".cache";
+    } else {
+        base = std::filesystem::temp_directory_path();
+    }
+    std::filesystem::path dir = base / "media-player" / kind;
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    return error ? std::string() : dir.string();
+}
+
+std::string mediaCachePath(const std::string& cacheDir, const std::string& filePath,
+                           const void* layout, size_t layoutSize, const std::string& extension) {
+    // An explicit cache directory may not exist yet either; every entry is written into it
+    std::error_code error;
+    std::filesystem::create_directories(cacheDir, error);
+    if (error) {
+        return std::string();
+    }
+    std::string absolute = std::filesystem::absolute(filePath, error).string();
+    if (error) {
+        return std::string();
+    }
+    uint64_t size = std::filesystem::file_size(filePath, error);
+    if (error) {
+        return std::string();
+    }
+    int64_t modified = std::filesystem::last_write_time(filePath, error).time_since_epoch().count();
+    if (error) {
+        return std::string();
+    }
+    Xxh64 key;
+    key.update(absolute.data(), absolute.size());
+    key.update(&size, sizeof(size));
+    key.update(&modified, sizeof(modified));
+    key.update(layout, layoutSize);
+    char name[24];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key.digest());
+    return (std::filesystem::path(cacheDir) / (name + extension)).string();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+// On-disk caches for per-file analysis results (thumbnails, waveforms, ...)
+
+// $XDG_CACHE_HOME/media-player/<kind>, falling back to ~/.cache and then the temp
+// directory. Created if missing; empty if it can't be.
+std::string mediaCacheDir(const std::string& kind);
+
+// Entry path in `cacheDir` for `filePath`, keyed by the file's absolute path, size and
+// modification time plus the caller's `layout` bytes, so edits or different
+// parameters never hit a stale entry. Creates `cacheDir` if missing; empty if it can't,
+// or if the file can't be examined.
+std::string mediaCachePath(const std::string& cacheDir, const std::string& filePath,
+                           const void* layout, size_t layoutSize, const std::string& extension);
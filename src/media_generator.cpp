@@ -0,0 +1,370 @@
+#include "media_generator.hpp"
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+    #include <libavutil/channel_layout.h>
+    #include <libavutil/mathematics.h>
+    #include <libavutil/pixdesc.h>
+    #include <libswscale/swscale.h>
+}
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+
+namespace {
+
+struct OutputStream {
+    AVStream* stream = nullptr;
+    AVCodecContext* codecContext = nullptr;
+    AVFrame* frame = nullptr;
+    // In codec time base: frame ticks for video, samples for audio
+    int64_t nextPts = 0;
+    int64_t frameCount = 0;
+};
+
+void closeStream(OutputStream& output) {
+    av_frame_free(&output.frame);
+    avcodec_free_context(&output.codecContext);
+}
+
+bool encodeAndWrite(AVFormatContext* formatContext, OutputStream& output, const AVFrame* frame, AVPacket* packet) {
+    if (avcodec_send_frame(output.codecContext, frame) < 0) {
+        std::cerr << "Error sending a frame to the encoder." << std::endl;
+        return false;
+    }
+    while (true) {
+        int ret = avcodec_receive_packet(output.codecContext, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            std::cerr << "Error encoding a frame." << std::endl;
+            return false;
+        }
+        av_packet_rescale_ts(packet, output.codecContext->time_base, output.stream->time_base);
+        packet->stream_index = output.stream->index;
+        if (av_interleaved_write_frame(formatContext, packet) < 0) {
+            std::cerr << "Error writing a packet." << std::endl;
+            return false;
+        }
+    }
+}
+
+bool openVideo(AVFormatContext* formatContext, const MediaGeneratorOptions& options, OutputStream& output) {
+    const AVCodec* codec = avcodec_find_encoder_by_name(options.videoCodec.c_str());
+    if (!codec) {
+        std::cerr << "Unknown video encoder " << options.videoCodec << std::endl;
+        return false;
+    }
+    AVPixelFormat pixelFormat = av_get_pix_fmt(options.pixelFormat.c_str());
+    if (pixelFormat == AV_PIX_FMT_NONE) {
+        std::cerr << "Unknown pixel format " << options.pixelFormat << std::endl;
+        return false;
+    }
+
+    output.stream = avformat_new_stream(formatContext, nullptr);
+    output.codecContext = avcodec_alloc_context3(codec);
+    AVCodecContext* context = output.codecContext;
+    context->width = options.width;
+    context->height = options.height;
+    context->pix_fmt = pixelFormat;
+    // VFR durations are whole multiples of 1/fps, so one tick per nominal frame is enough
+    context->framerate = AVRational{options.fps, 1};
+    context->time_base = AVRational{1, options.fps};
+    context->gop_size = options.gopSize;
+    context->max_b_frames = options.maxBFrames;
+    if (formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+        std::cerr << "Couldn't open video encoder " << options.videoCodec << std::endl;
+        return false;
+    }
+    avcodec_parameters_from_context(output.stream->codecpar, context);
+    output.stream->time_base = context->time_base;
+
+    output.frame = av_frame_alloc();
+    output.frame->format = pixelFormat;
+    output.frame->width = options.width;
+    output.frame->height = options.height;
+    return av_frame_get_buffer(output.frame, 0) >= 0;
+}
+
+AVSampleFormat pickSampleFormat(const AVCodecContext* context, const AVCodec* codec) {
+    const AVSampleFormat* formats = nullptr;
+    int count = 0;
+    avcodec_get_supported_config(context, codec, AV_CODEC_CONFIG_SAMPLE_FORMAT, 0,
+                                 reinterpret_cast<const void**>(&formats), &count);
+    if (!formats) {
+        return AV_SAMPLE_FMT_FLTP;
+    }
+    for (AVSampleFormat preferred : {AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S16}) {
+        for (int i = 0; i < count; i++) {
+            if (formats[i] == preferred) {
+                return preferred;
+            }
+        }
+    }
+    return AV_SAMPLE_FMT_NONE;
+}
+
+bool openAudio(AVFormatContext* formatContext, const MediaGeneratorOptions& options, OutputStream& output) {
+    const AVCodec* codec = avcodec_find_encoder_by_name(options.audioCodec.c_str());
+    if (!codec) {
+        std::cerr << "Unknown audio encoder " << options.audioCodec << std::endl;
+        return false;
+    }
+
+    output.stream = avformat_new_stream(formatContext, nullptr);
+    output.codecContext = avcodec_alloc_context3(codec);
+    AVCodecContext* context = output.codecContext;
+    context->sample_rate = options.sampleRate;
+    av_channel_layout_default(&context->ch_layout, options.audioChannels);
+    context->sample_fmt = pickSampleFormat(context, codec);
+    if (context->sample_fmt == AV_SAMPLE_FMT_NONE) {
+        std::cerr << "Audio encoder " << options.audioCodec << " takes no float or s16 input." << std::endl;
+        return false;
+    }
+    context->time_base = AVRational{1, options.sampleRate};
+    context->bit_rate = 64000 * options.audioChannels;
+    if (formatContext->oformat->flags & AVFMT_GLOBALHEADER) {
+        context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(context, codec, nullptr) < 0) {
+        std::cerr << "Couldn't open audio encoder " << options.audioCodec << std::endl;
+        return false;
+    }
+    avcodec_parameters_from_context(output.stream->codecpar, context);
+    output.stream->time_base = context->time_base;
+
+    output.frame = av_frame_alloc();
+    output.frame->format = context->sample_fmt;
+    output.frame->sample_rate = context->sample_rate;
+    output.frame->nb_samples = context->frame_size > 0 ? context->frame_size : 1024;
+    av_channel_layout_copy(&output.frame->ch_layout, &context->ch_layout);
+    return av_frame_get_buffer(output.frame, 0) >= 0;
+}
+
+// Moving gradient, frame index band on top, and a white bar at the bottom on flash frames
+void drawPattern(AVFrame* frame, int64_t index, bool flash) {
+    const int width = frame->width;
+    const int height = frame->height;
+    const int blockWidth = width / FRAME_INDEX_BITS;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < width; x++) {
+            if (y < FRAME_INDEX_BAND && blockWidth > 0 && x < blockWidth * FRAME_INDEX_BITS) {
+                int bit = FRAME_INDEX_BITS - 1 - x / blockWidth;
+                row[x] = ((index >> bit) & 1) ? 235 : 16;
+            } else if (flash && y >= height - FRAME_INDEX_BAND) {
+                row[x] = 235;
+            } else {
+                row[x] = static_cast<uint8_t>(16 + (x + 2 * y + 3 * index) % 220);
+            }
+        }
+    }
+
+    for (int y = 0; y < height / 2; y++) {
+        uint8_t* u = frame->data[1] + y * frame->linesize[1];
+        uint8_t* v = frame->data[2] + y * frame->linesize[2];
+        bool neutral = y < FRAME_INDEX_BAND / 2 || (flash && y >= (height - FRAME_INDEX_BAND) / 2);
+        for (int x = 0; x < width / 2; x++) {
+            u[x] = neutral ? 128 : static_cast<uint8_t>(64 + x * 128 / (width / 2));
+            v[x] = neutral ? 128 : static_cast<uint8_t>(64 + y * 128 / (height / 2));
+        }
+    }
+}
+
+void fillTone(AVFrame* frame, int64_t firstSample, const MediaGeneratorOptions& options) {
+    const int channels = frame->ch_layout.nb_channels;
+    const AVSampleFormat format = static_cast<AVSampleFormat>(frame->format);
+    for (int i = 0; i < frame->nb_samples; i++) {
+        double t = static_cast<double>(firstSample + i) / options.sampleRate;
+        bool inBurst = std::fmod(t, 1.0) * 1000.0 < options.burstMs;
+        float value = inBurst ? static_cast<float>(0.5 * std::sin(2.0 * M_PI * options.toneHz * t)) : 0.0f;
+        int16_t value16 = static_cast<int16_t>(value * 32767.0f);
+        for (int ch = 0; ch < channels; ch++) {
+            switch (format) {
+                case AV_SAMPLE_FMT_FLTP: reinterpret_cast<float*>(frame->extended_data[ch])[i] = value; break;
+                case AV_SAMPLE_FMT_FLT:  reinterpret_cast<float*>(frame->data[0])[i * channels + ch] = value; break;
+                case AV_SAMPLE_FMT_S16P: reinterpret_cast<int16_t*>(frame->extended_data[ch])[i] = value16; break;
+                case AV_SAMPLE_FMT_S16:  reinterpret_cast<int16_t*>(frame->data[0])[i * channels + ch] = value16; break;
+                default: break;
+            }
+        }
+    }
+}
+
+// Values the generator can't honour, e.g. a 0 fps that would divide by zero per frame
+bool validOptions(const MediaGeneratorOptions& options) {
+    const char* problem = nullptr;
+    if (!std::isfinite(options.durationSeconds) || options.durationSeconds <= 0.0) {
+        problem = "duration must be positive";
+    } else if (options.width <= 0 || options.height <= 0) {
+        problem = "frame size must be positive";
+    } else if (options.fps <= 0) {
+        problem = "frame rate must be positive";
+    } else if (options.gopSize < 0 || options.maxBFrames < 0) {
+        problem = "GOP size and B-frame count can't be negative";
+    } else if (std::any_of(options.vfrPattern.begin(), options.vfrPattern.end(), [](int d) { return d <= 0; })) {
+        problem = "frame durations must be positive";
+    } else if (options.audioChannels < 0 || (options.audioChannels > 0 && options.sampleRate <= 0)) {
+        problem = "audio channels and sample rate must be positive";
+    }
+    if (problem) {
+        std::cerr << "Can't generate " << options.outputPath << ": " << problem << "." << std::endl;
+    }
+    return !problem;
+}
+
+} // namespace
+
+bool generateMedia(const MediaGeneratorOptions& options) {
+    if (!validOptions(options)) {
+        return false;
+    }
+    AVFormatContext* formatContext = nullptr;
+    if (avformat_alloc_output_context2(&formatContext, nullptr, nullptr, options.outputPath.c_str()) < 0) {
+        std::cerr << "Couldn't pick a container for " << options.outputPath << std::endl;
+        return false;
+    }
+
+    OutputStream video;
+    OutputStream audio;
+    AVFrame* pattern = nullptr;
+    SwsContext* swsContext = nullptr;
+    AVPacket* packet = av_packet_alloc();
+    bool headerWritten = false;
+    bool ok = openVideo(formatContext, options, video) &&
+              (options.audioChannels == 0 || openAudio(formatContext, options, audio));
+
+    // The pattern is drawn in YUV420P and converted if the target format differs
+    if (ok && video.codecContext->pix_fmt != AV_PIX_FMT_YUV420P) {
+        pattern = av_frame_alloc();
+        pattern->format = AV_PIX_FMT_YUV420P;
+        pattern->width = options.width;
+        pattern->height = options.height;
+        ok = av_frame_get_buffer(pattern, 0) >= 0;
+        swsContext = sws_getContext(options.width, options.height, AV_PIX_FMT_YUV420P,
+                                    options.width, options.height, video.codecContext->pix_fmt,
+                                    SWS_POINT, nullptr, nullptr, nullptr);
+        ok = ok && swsContext;
+    }
+
+    // Written under a temporary name and renamed once complete, so an interrupted run never
+    // leaves a truncated clip where tests and benchmarks look for a finished one
+    const bool writesFile = !(formatContext->oformat->flags & AVFMT_NOFILE);
+    std::filesystem::path partialPath(options.outputPath);
+    partialPath.replace_filename(partialPath.stem().string() + ".partial" + partialPath.extension().string());
+    if (ok && writesFile) {
+        ok = avio_open(&formatContext->pb, partialPath.string().c_str(), AVIO_FLAG_WRITE) >= 0;
+        if (!ok) {
+            std::cerr << "Couldn't open " << partialPath.string() << " for writing." << std::endl;
+        }
+    }
+    if (ok) {
+        ok = avformat_write_header(formatContext, nullptr) >= 0;
+        headerWritten = ok;
+    }
+
+    const int64_t videoEnd = static_cast<int64_t>(options.durationSeconds * options.fps);
+    const int64_t audioEnd = static_cast<int64_t>(options.durationSeconds * options.sampleRate);
+    while (ok) {
+        bool videoDone = video.nextPts >= videoEnd;
+        bool audioDone = !audio.codecContext || audio.nextPts >= audioEnd;
+        if (videoDone && audioDone) {
+            break;
+        }
+
+        // Always write whichever stream is behind so the muxer interleaves cheaply
+        if (!videoDone && (audioDone || av_compare_ts(video.nextPts, video.codecContext->time_base,
+                                                      audio.nextPts, audio.codecContext->time_base) <= 0)) {
+            int duration = options.vfrPattern.empty()
+                ? 1 : options.vfrPattern[video.frameCount % options.vfrPattern.size()];
+            // Flash on the frame that covers each whole second
+            bool flash = video.nextPts % options.fps == 0 ||
+                         video.nextPts / options.fps != (video.nextPts + duration - 1) / options.fps;
+
+            av_frame_make_writable(video.frame);
+            if (pattern) {
+                drawPattern(pattern, video.frameCount, flash);
+                sws_scale(swsContext, pattern->data, pattern->linesize, 0, options.height,
+                          video.frame->data, video.frame->linesize);
+            } else {
+                drawPattern(video.frame, video.frameCount, flash);
+            }
+            video.frame->pts = video.nextPts;
+            video.frame->duration = duration;
+            ok = encodeAndWrite(formatContext, video, video.frame, packet);
+            video.nextPts += duration;
+            video.frameCount++;
+        } else {
+            av_frame_make_writable(audio.frame);
+            fillTone(audio.frame, audio.nextPts, options);
+            audio.frame->pts = audio.nextPts;
+            ok = encodeAndWrite(formatContext, audio, audio.frame, packet);
+            audio.nextPts += audio.frame->nb_samples;
+        }
+    }
+
+    // Drain the encoders
+    if (ok) {
+        ok = encodeAndWrite(formatContext, video, nullptr, packet);
+    }
+    if (ok && audio.codecContext) {
+        ok = encodeAndWrite(formatContext, audio, nullptr, packet);
+    }
+    if (headerWritten) {
+        ok = av_write_trailer(formatContext) >= 0 && ok;
+    }
+
+    sws_freeContext(swsContext);
+    av_frame_free(&pattern);
+    av_packet_free(&packet);
+    closeStream(video);
+    closeStream(audio);
+    if (writesFile) {
+        avio_closep(&formatContext->pb);
+        std::error_code error;
+        if (ok) {
+            std::filesystem::rename(partialPath, options.outputPath, error);
+            if (error) {
+                std::cerr << "Couldn't move the clip to " << options.outputPath << ": " << error.message() << std::endl;
+                ok = false;
+            }
+        }
+        if (!ok) {
+            std::filesystem::remove(partialPath, error);
+        }
+    }
+    avformat_free_context(formatContext);
+    return ok;
+}
+
+int64_t readFrameIndex(const AVFrame* frame) {
+    const int blockWidth = frame->width / FRAME_INDEX_BITS;
+    if (blockWidth < 4 || frame->height < FRAME_INDEX_BAND) {
+        return -1;
+    }
+
+    // Average the middle of each block so compression ringing at the edges doesn't matter
+    int64_t index = 0;
+    for (int bit = 0; bit < FRAME_INDEX_BITS; bit++) {
+        int sum = 0;
+        int count = 0;
+        for (int y = FRAME_INDEX_BAND / 4; y < FRAME_INDEX_BAND * 3 / 4; y++) {
+            const uint8_t* row = frame->data[0] + y * frame->linesize[0];
+            for (int x = bit * blockWidth + blockWidth / 4; x < bit * blockWidth + blockWidth * 3 / 4; x++) {
+                sum += row[x];
+                count++;
+            }
+        }
+        index = (index << 1) | (sum / count > 125 ? 1 : 0);
+    }
+    return index;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Synthetic clips for benchmarks and tests, encoded with whatever libavcodec provides.
+// Every video frame carries its index as a row of black/white blocks along the top edge
+// (see readFrameIndex), and every second starts with a tone burst on the audio track
+// together with a white bar at the bottom of the matching video frame, so A/V sync can
+// be checked without reference files.
+struct MediaGeneratorOptions {
+    std::string outputPath;         // container is picked from the extension
+    double durationSeconds = 10.0;
+
+    int width = 1280;
+    int height = 720;
+    int fps = 30;
+    std::string videoCodec = "mpeg4";
+    std::string pixelFormat = "yuv420p";
+    int gopSize = 30;
+    int maxBFrames = 0;
+    // Frame durations as multiples of 1/fps, repeated; empty means constant frame rate
+    std::vector<int> vfrPattern;
+
+    // 0 channels writes a video-only file
+    int audioChannels = 2;
+    int sampleRate = 48000;
+    std::string audioCodec = "aac";
+    double toneHz = 1000.0;
+    double burstMs = 100.0;
+};
+
+// False, without touching outputPath, for options out of range or when encoding fails
+bool generateMedia(const MediaGeneratorOptions& options);
+
+// Number of blocks in the frame index band
+constexpr int FRAME_INDEX_BITS = 32;
+// Height of the band in pixels
+constexpr int FRAME_INDEX_BAND = 16;
+
+// Decodes the index drawn by generateMedia from a frame with an 8-bit luma plane.
+// Returns -1 if the frame is too small to carry one.
+int64_t readFrameIndex(const AVFrame* frame);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+
+// Resident set size of this process, in bytes. Returns 0 where unsupported.
+size_t currentRssBytes();
+size_t peakRssBytes();
@@ -0,0 +1,282 @@
+#include "metrics_exporter.hpp"
+#include "profiler.hpp"
+#include "memory_usage.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace {
+
+// How long blocking calls wait before checking whether stop() was requested
+constexpr int POLL_TIMEOUT_MS = 200;
+
+// Integer counters and gauges stay integers: through a double, a byte count past 2^53 or
+// one printed in exponent form would lose its low digits
+template <typename T>
+void writeMetric(std::ostringstream& out, const char* name, const char* type, const char* help, T value) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n'
+        << name << ' ' << value << '\n';
+}
+
+bool sendAll(int fd, const std::string& data) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, flags);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+MetricsExporter::MetricsExporter()
+    : m_running(false), m_listenFd(-1), m_ownsSocketPath(false), m_interval(0) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+std::string MetricsExporter::render() {
+    Profiler& profiler = Profiler::instance();
+    std::ostringstream out;
+    // Only affects the values that are really fractional, such as seconds
+    out.precision(9);
+
+    writeMetric(out, "mp_frames_decoded_total", "counter", "Video frames decoded.",
+                profiler.counter(Counter::FramesDecoded));
+    writeMetric(out, "mp_frames_presented_total", "counter", "Video frames presented.",
+                profiler.counter(Counter::FramesPresented));
+    writeMetric(out, "mp_frames_dropped_total", "counter", "Video frames dropped for lateness.",
+                profiler.counter(Counter::FramesDropped));
+    writeMetric(out, "mp_frames_duplicated_total", "counter", "Video frames presented more than once.",
+                profiler.counter(Counter::FramesDuplicated));
+    writeMetric(out, "mp_audio_underruns_total", "counter", "Audio device buffer underruns.",
+                profiler.counter(Counter::AudioUnderruns));
+    writeMetric(out, "mp_io_read_bytes_total", "counter", "Bytes read from the input.",
+                profiler.counter(Counter::IoBytesRead));
+    writeMetric(out, "mp_io_wait_seconds_total", "counter", "Time spent blocked in av_read_frame.",
+                profiler.cumulative(Stage::Demux).sumSeconds);
+    writeMetric(out, "mp_frame_cache_hits_total", "counter", "Frame steps served from the decoded-frame cache.",
+                profiler.counter(Counter::FrameCacheHits));
+    writeMetric(out, "mp_frame_cache_misses_total", "counter", "Frame steps that had to decode.",
+                profiler.counter(Counter::FrameCacheMisses));
+    writeMetric(out, "mp_frame_cache_evictions_total", "counter", "Frames evicted from the decoded-frame cache.",
+                profiler.counter(Counter::FrameCacheEvictions));
+    writeMetric(out, "mp_video_queue_depth", "gauge", "Decoded video frames waiting to be shown.",
+                profiler.gauge(Gauge::VideoQueueDepth));
+    writeMetric(out, "mp_audio_queue_bytes", "gauge", "Audio bytes queued for the device.",
+                profiler.gauge(Gauge::AudioQueueBytes));
+    writeMetric(out, "mp_audio_output_latency_seconds", "gauge", "Audio queued ahead of the speaker.",
+                profiler.gauge(Gauge::AudioLatencyUs) / 1e6);
+    writeMetric(out, "mp_audio_device_buffer_frames", "gauge", "Audio device buffer size in frames.",
+                profiler.gauge(Gauge::AudioBufferFrames));
+    writeMetric(out, "mp_audio_callback_jitter_seconds", "gauge", "Worst recent audio callback deviation from its cadence.",
+                profiler.gauge(Gauge::AudioCallbackJitterUs) / 1e6);
+    writeMetric(out, "mp_audio_last_underrun_timestamp_seconds", "gauge", "Unix time of the last audio underrun, 0 if none.",
+                profiler.gauge(Gauge::AudioLastUnderrunUs) / 1e6);
+    writeMetric(out, "mp_av_offset_seconds", "gauge", "Video on screen minus audio at the speaker.",
+                profiler.gauge(Gauge::AvOffsetUs) / 1e6);
+    writeMetric(out, "mp_audio_clock_drift_ppm", "gauge", "Sound card clock drift against the master clock.",
+                profiler.gauge(Gauge::AudioDriftPpm));
+    writeMetric(out, "mp_decode_quality_level", "gauge", "Decode degradation level, 0 is full quality.",
+                profiler.gauge(Gauge::DecodeQuality));
+    writeMetric(out, "mp_frame_cache_bytes", "gauge", "Frame data held by the decoded-frame cache.",
+                profiler.gauge(Gauge::FrameCacheBytes));
+    writeMetric(out, "mp_decoder_buffers", "gauge", "Frame buffers currently held from the decoder.",
+                profiler.gauge(Gauge::DecoderBuffers));
+    writeMetric(out, "mp_decoder_buffer_bytes", "gauge", "Bytes in frame buffers currently held from the decoder.",
+                profiler.gauge(Gauge::DecoderBufferBytes));
+    writeMetric(out, "mp_resident_memory_bytes", "gauge", "Resident set size.",
+                currentRssBytes());
+
+    out << "# HELP mp_stage_duration_seconds Time spent per pipeline stage.\n"
+        << "# TYPE mp_stage_duration_seconds histogram\n";
+    for (size_t i = 0; i < static_cast<size_t>(Stage::Count); i++) {
+        const char* stage = stageName(static_cast<Stage>(i));
+        CumulativeHistogram histogram = profiler.cumulative(static_cast<Stage>(i));
+        for (size_t b = 0; b < LATENCY_BUCKETS.size(); b++) {
+            out << "mp_stage_duration_seconds_bucket{stage=\"" << stage << "\",le=\"" << LATENCY_BUCKETS[b] << "\"} "
+                << histogram.buckets[b] << '\n';
+        }
+        out << "mp_stage_duration_seconds_bucket{stage=\"" << stage << "\",le=\"+Inf\"} " << histogram.count << '\n'
+            << "mp_stage_duration_seconds_sum{stage=\"" << stage << "\"} " << histogram.sumSeconds << '\n'
+            << "mp_stage_duration_seconds_count{stage=\"" << stage << "\"} " << histogram.count << '\n';
+    }
+    return out.str();
+}
+
+bool MetricsExporter::startHttp(int port) {
+    if (m_running) {
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Couldn't create metrics socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Couldn't bind metrics port " << port << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    return startListening(fd);
+}
+
+bool MetricsExporter::startUnixSocket(const std::string& socketPath) {
+    if (m_running) {
+        return false;
+    }
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Metrics socket path too long." << std::endl;
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Couldn't create metrics socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Couldn't bind metrics socket " << socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    m_path = socketPath;
+    m_ownsSocketPath = true;
+    return startListening(fd);
+}
+
+bool MetricsExporter::startListening(int listenFd) {
+    if (listen(listenFd, 4) < 0) {
+        std::cerr << "Couldn't listen for metrics scrapes: " << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        return false;
+    }
+    m_listenFd = listenFd;
+    m_running = true;
+    m_thread = std::thread(&MetricsExporter::serveLoop, this);
+    return true;
+}
+
+bool MetricsExporter::startFile(const std::string& filePath, std::chrono::milliseconds interval) {
+    if (m_running) {
+        return false;
+    }
+    m_path = filePath;
+    m_ownsSocketPath = false;
+    m_interval = interval;
+    m_running = true;
+    m_thread = std::thread(&MetricsExporter::fileLoop, this);
+    return true;
+}
+
+bool MetricsExporter::startFromEnvironment() {
+    if (const char* port = std::getenv("MP_METRICS_PORT")) {
+        return startHttp(std::atoi(port));
+    }
+    if (const char* socketPath = std::getenv("MP_METRICS_SOCKET")) {
+        return startUnixSocket(socketPath);
+    }
+    if (const char* filePath = std::getenv("MP_METRICS_FILE")) {
+        return startFile(filePath, std::chrono::seconds(5));
+    }
+    return false;
+}
+
+void MetricsExporter::stop() {
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_listenFd >= 0) {
+        ::close(m_listenFd);
+        m_listenFd = -1;
+    }
+    if (m_ownsSocketPath) {
+        unlink(m_path.c_str());
+        m_ownsSocketPath = false;
+    }
+}
+
+void MetricsExporter::serveLoop() {
+    while (m_running) {
+        pollfd listener{m_listenFd, POLLIN, 0};
+        if (poll(&listener, 1, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+        int client = accept(m_listenFd, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+
+        // Any request gets the metrics; drain what the scraper sent without waiting on a slow client
+        pollfd request{client, POLLIN, 0};
+        if (poll(&request, 1, POLL_TIMEOUT_MS) > 0) {
+            char discard[4096];
+            (void)recv(client, discard, sizeof(discard), 0);
+        }
+
+        std::string body = render();
+        std::string response =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + body;
+        sendAll(client, response);
+        ::close(client);
+    }
+}
+
+void MetricsExporter::fileLoop() {
+    auto nextWrite = std::chrono::steady_clock::now();
+    while (m_running) {
+        if (std::chrono::steady_clock::now() >= nextWrite) {
+            // Write then rename so collectors never see a half-written file
+            std::string tempPath = m_path + ".tmp";
+            {
+                std::ofstream file(tempPath, std::ios::trunc);
+                file << render();
+            }
+            if (std::rename(tempPath.c_str(), m_path.c_str()) != 0) {
+                std::cerr << "Couldn't update metrics file " << m_path << std::endl;
+            }
+            nextWrite += m_interval;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(POLL_TIMEOUT_MS));
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+
+// Publishes Profiler counters in the Prometheus text exposition format, either by
+// answering HTTP scrapes on a local TCP port / Unix socket or by periodically
+// rewriting a file for node_exporter's textfile collector. Nothing runs until started.
+class MetricsExporter {
+public:
+    MetricsExporter();
+    ~MetricsExporter();
+    MetricsExporter (const MetricsExporter &) =delete;
+    MetricsExporter& operator=(const MetricsExporter &) =delete;
+
+    // Listens on 127.0.0.1 only
+    bool startHttp(int port);
+    bool startUnixSocket(const std::string& socketPath);
+    bool startFile(const std::string& filePath, std::chrono::milliseconds interval);
+    // Reads MP_METRICS_PORT, MP_METRICS_SOCKET or MP_METRICS_FILE; returns false if none is set
+    bool startFromEnvironment();
+    void stop();
+    bool isRunning() const { return m_running.load(); }
+
+    // Current metrics as a Prometheus text payload
+    static std::string render();
+
+private:
+    bool startListening(int listenFd);
+    void serveLoop();
+    void fileLoop();
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    int m_listenFd;
+    std::string m_path;
+    bool m_ownsSocketPath;
+    std::chrono::milliseconds m_interval;
+};
@@ -0,0 +1,99 @@
+#include "preview_decoder.hpp"
+#include "tracer.hpp"
+#include <iostream>
+
+
+PreviewDecoder::PreviewDecoder()
+    : m_target(0.0), m_stop(false), m_generation(0), m_activeGeneration(0),
+      m_readyGeneration(0), m_takenGeneration(0) {
+}
+
+PreviewDecoder::~PreviewDecoder() {
+    close();
+}
+
+bool PreviewDecoder::open(const std::string& filePath, int maxWidth) {
+    close();
+    m_stop = false;
+    // Aborts reads made for a superseded request
+    auto cancelled = [this] { return m_stop || isCancelled(m_activeGeneration); };
+    if (!m_decoder.open(filePath, maxWidth, cancelled)) {
+        return false;
+    }
+    m_worker = std::thread(&PreviewDecoder::run, this);
+    return true;
+}
+
+void PreviewDecoder::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_generation++;
+    m_wake.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    m_decoder.close();
+    m_activeGeneration = m_generation.load();
+    m_readyGeneration = 0;
+    m_takenGeneration = 0;
+}
+
+void PreviewDecoder::request(double seconds) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_target = seconds;
+        m_generation++;
+    }
+    m_wake.notify_one();
+}
+
+bool PreviewDecoder::takeFrame(PreviewFrame& frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_readyGeneration == m_takenGeneration || m_readyGeneration != m_generation.load()) {
+        return false;
+    }
+    m_takenGeneration = m_readyGeneration;
+    frame = m_readyFrame;
+    return true;
+}
+
+bool PreviewDecoder::waitFrame(PreviewFrame& frame, std::chrono::milliseconds timeout) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait_for(lock, timeout, [this] {
+            return m_stop || (m_readyGeneration == m_generation.load() && m_readyGeneration != m_takenGeneration);
+        });
+    }
+    return takeFrame(frame);
+}
+
+void PreviewDecoder::run() {
+    Tracer::instance().setThreadName("preview");
+    // Nothing has been asked of this file yet
+    uint64_t handled = m_generation.load();
+    PreviewFrame frame;
+    while (true) {
+        double target;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation.load() != handled; });
+            if (m_stop) {
+                return;
+            }
+            target = m_target;
+            generation = m_generation.load();
+        }
+        handled = generation;
+        m_activeGeneration = generation;
+
+        if (m_decoder.decodeNear(target, frame) && !isCancelled(generation)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(m_readyFrame, frame);
+            m_readyGeneration = generation;
+            m_ready.notify_all();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "keyframe_decoder.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+// Small, fast frames for seek-bar scrubbing. Runs a KeyframeDecoder on one worker thread,
+// so it never competes with MPDecoder for decoder threads, and even 8K sources come back
+// in milliseconds.
+// Every request supersedes the previous one: a decode in progress for an older target is
+// abandoned between packets, and blocking reads are interrupted.
+class PreviewDecoder {
+public:
+    static constexpr int DEFAULT_MAX_WIDTH = 320;
+
+    PreviewDecoder();
+    ~PreviewDecoder();
+    PreviewDecoder (const PreviewDecoder &) =delete;
+    PreviewDecoder& operator=(const PreviewDecoder &) =delete;
+
+    bool open(const std::string& filePath, int maxWidth = DEFAULT_MAX_WIDTH);
+    void close();
+
+    // Asks for the keyframe at or before `seconds`; cancels whatever was asked before
+    void request(double seconds);
+    // Takes the preview for the latest request once it's ready
+    bool takeFrame(PreviewFrame& frame);
+    bool waitFrame(PreviewFrame& frame, std::chrono::milliseconds timeout);
+
+private:
+    void run();
+    bool isCancelled(uint64_t generation) const { return m_generation.load() != generation; }
+
+    KeyframeDecoder m_decoder;
+
+    std::thread m_worker;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_ready;
+    double m_target;
+    std::atomic<bool> m_stop;
+    // Bumped by every request; the worker gives up on anything older
+    std::atomic<uint64_t> m_generation;
+    // Request the worker is busy with
+    std::atomic<uint64_t> m_activeGeneration;
+    uint64_t m_readyGeneration;
+    uint64_t m_takenGeneration;
+    PreviewFrame m_readyFrame;
+};
@@ -0,0 +1,144 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <vector>
+
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::Demux:     return "demux";
+        case Stage::Decode:    return "decode";
+        case Stage::Convert:   return "convert";
+        case Stage::Upload:    return "upload";
+        case Stage::Draw:      return "draw";
+        case Stage::Swap:      return "swap";
+        case Stage::GpuUpload: return "gpu_upload";
+        case Stage::GpuDraw:   return "gpu_draw";
+        default:               return "unknown";
+    }
+}
+
+void StageHistogram::record(int64_t nanoseconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_samples[m_next] = nanoseconds;
+    m_next = (m_next + 1) % WINDOW;
+    m_size = std::min(m_size + 1, WINDOW);
+    m_count++;
+
+    double seconds = nanoseconds / 1e9;
+    for (size_t i = 0; i < LATENCY_BUCKETS.size(); i++) {
+        if (seconds <= LATENCY_BUCKETS[i]) {
+            m_cumulative.buckets[i]++;
+        }
+    }
+    m_cumulative.count++;
+    m_cumulative.sumSeconds += seconds;
+}
+
+StageStats StageHistogram::stats() const {
+    std::vector<int64_t> samples;
+    StageStats result;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_size == 0) {
+            return result;
+        }
+        samples.assign(m_samples.begin(), m_samples.begin() + m_size);
+        result.lastMs = m_samples[(m_next + WINDOW - 1) % WINDOW] / 1e6;
+        result.count = m_count;
+    }
+
+    // Nearest-rank percentiles over the window
+    auto percentile = [&samples](double p) {
+        size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+        std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+        return samples[rank] / 1e6;
+    };
+    result.p50Ms = percentile(0.50);
+    result.p99Ms = percentile(0.99);
+    result.maxMs = *std::max_element(samples.begin(), samples.end()) / 1e6;
+    return result;
+}
+
+CumulativeHistogram StageHistogram::cumulative() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cumulative;
+}
+
+void StageHistogram::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_next = 0;
+    m_size = 0;
+    m_count = 0;
+    m_cumulative = CumulativeHistogram();
+}
+
+Profiler::Profiler() {
+    for (auto& counter : m_counters) counter.store(0);
+    for (size_t i = 0; i < m_gauges.size(); i++) {
+        Gauge gauge = static_cast<Gauge>(i);
+        // Running balances; clearing them would leave them negative once the buffers are freed
+        if (gauge != Gauge::DecoderBuffers && gauge != Gauge::DecoderBufferBytes) {
+            m_gauges[i].store(0);
+        }
+    }
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::record(Stage stage, int64_t nanoseconds) {
+    m_histograms[static_cast<size_t>(stage)].record(nanoseconds);
+}
+
+StageStats Profiler::stats(Stage stage) const {
+    return m_histograms[static_cast<size_t>(stage)].stats();
+}
+
+CumulativeHistogram Profiler::cumulative(Stage stage) const {
+    return m_histograms[static_cast<size_t>(stage)].cumulative();
+}
+
+void Profiler::increment(Counter counter, uint64_t amount) {
+    m_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint64_t Profiler::counter(Counter counter) const {
+    return m_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+void Profiler::setGauge(Gauge gauge, int64_t value) {
+    m_gauges[static_cast<size_t>(gauge)].store(value, std::memory_order_relaxed);
+}
+
+void Profiler::addGauge(Gauge gauge, int64_t delta) {
+    m_gauges[static_cast<size_t>(gauge)].fetch_add(delta, std::memory_order_relaxed);
+}
+
+int64_t Profiler::gauge(Gauge gauge) const {
+    return m_gauges[static_cast<size_t>(gauge)].load(std::memory_order_relaxed);
+}
+
+void Profiler::reset() {
+    for (auto& histogram : m_histograms) {
+        histogram.reset();
+    }
+    for (auto& counter : m_counters) counter.store(0);
+    for (size_t i = 0; i < m_gauges.size(); i++) {
+        Gauge gauge = static_cast<Gauge>(i);
+        // Running balances; clearing them would leave them negative once the buffers are freed
+        if (gauge != Gauge::DecoderBuffers && gauge != Gauge::DecoderBufferBytes) {
+            m_gauges[i].store(0);
+        }
+    }
+}
+
+ScopedStageTimer::ScopedStageTimer(Stage stage)
+    : m_stage(stage), m_start(std::chrono::steady_clock::now()) {
+}
+
+ScopedStageTimer::~ScopedStageTimer() {
+    auto elapsed = std::chrono::steady_clock::now() - m_start;
+    Profiler::instance().record(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
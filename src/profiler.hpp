@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+
+// Pipeline stages that get timed. Gpu* stages are measured with GL timer queries,
+// everything else is wall-clock time on the calling thread.
+enum class Stage {
+    Demux,
+    Decode,
+    Convert,
+    Upload,
+    Draw,
+    Swap,
+    GpuUpload,
+    GpuDraw,
+    Count
+};
+
+const char* stageName(Stage stage);
+
+// Monotonic event counts
+enum class Counter {
+    FramesDecoded,
+    FramesPresented,
+    FramesDropped,
+    FramesDuplicated,
+    AudioUnderruns,
+    IoBytesRead,
+    FrameCacheHits,
+    FrameCacheMisses,
+    FrameCacheEvictions,
+    Count
+};
+
+// Point-in-time values, overwritten by their owner
+enum class Gauge {
+    VideoQueueDepth,
+    AudioQueueBytes,
+    // Audio queued ahead of the speaker: ring plus the unplayed part of the device buffer
+    AudioLatencyUs,
+    AudioBufferFrames,
+    // Worst callback deviation from its steady cadence over the last adaptation interval
+    AudioCallbackJitterUs,
+    // Wall-clock time of the most recent underrun, microseconds since the Unix epoch
+    AudioLastUnderrunUs,
+    // Video on screen minus audio at the speaker; positive means video is ahead
+    AvOffsetUs,
+    // Sound card clock relative to the master clock, as measured by the DriftController
+    AudioDriftPpm,
+    // Current DecodeQuality level, 0 is full quality
+    DecodeQuality,
+    // Live frame buffers handed out by the decoder, adjusted with addGauge() and never reset
+    DecoderBuffers,
+    DecoderBufferBytes,
+    FrameCacheBytes,
+    Count
+};
+
+struct StageStats {
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+    double lastMs = 0.0;
+    uint64_t count = 0;
+};
+
+// Upper bounds of the cumulative buckets, in seconds. Samples above the last bound only count towards +Inf.
+constexpr std::array<double, 12> LATENCY_BUCKETS = {
+    0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.133, 0.25, 0.5, 1.0
+};
+
+// Since-start totals in the shape of a Prometheus histogram
+struct CumulativeHistogram {
+    std::array<uint64_t, LATENCY_BUCKETS.size()> buckets{};
+    uint64_t count = 0;
+    double sumSeconds = 0.0;
+};
+
+// Keeps the most recent samples of one stage so percentiles follow what is happening now,
+// not what happened at startup.
+class StageHistogram {
+public:
+    static constexpr size_t WINDOW = 512;
+
+    void record(int64_t nanoseconds);
+    StageStats stats() const;
+    CumulativeHistogram cumulative() const;
+    void reset();
+
+private:
+    mutable std::mutex m_mutex;
+    std::array<int64_t, WINDOW> m_samples{};
+    size_t m_next = 0;
+    size_t m_size = 0;
+    uint64_t m_count = 0;
+    CumulativeHistogram m_cumulative;
+};
+
+class Profiler {
+public:
+    static Profiler& instance();
+
+    void record(Stage stage, int64_t nanoseconds);
+    StageStats stats(Stage stage) const;
+    CumulativeHistogram cumulative(Stage stage) const;
+
+    void increment(Counter counter, uint64_t amount = 1);
+    uint64_t counter(Counter counter) const;
+    void setGauge(Gauge gauge, int64_t value);
+    void addGauge(Gauge gauge, int64_t delta);
+    int64_t gauge(Gauge gauge) const;
+
+    void reset();
+
+private:
+    Profiler();
+
+    std::array<StageHistogram, static_cast<size_t>(Stage::Count)> m_histograms;
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> m_counters;
+    std::array<std::atomic<int64_t>, static_cast<size_t>(Gauge::Count)> m_gauges;
+};
+
+// Times the enclosing scope and records it against a stage.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage stage);
+    ~ScopedStageTimer();
+    ScopedStageTimer(const ScopedStageTimer &) =delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer &) =delete;
+
+private:
+    Stage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
@@ -3,13 +3,13 @@
 
 const char* GLSL_VERSION;
 
-Renderer::Renderer() : m_window(nullptr), m_texture(0), m_shader(nullptr), VAO(0), VBO(0), EBO(0) {}
+Renderer::Renderer() : m_window(nullptr), m_texture(0), m_shader(nullptr), VAO(0), VBO(0), EBO(0), m_lastFrameLate(false) {}
 
 Renderer::~Renderer() {
     cleanup();
 }
 
-bool Renderer::init(int width, int height) {
+bool Renderer::init(int width, int height, bool visible) {
     std::cout<<"width: "<<width<< "height: "<<height<<"\n";
     // Initialize GLFW
     if (!glfwInit()) {
@@ -41,6 +41,9 @@ bool Renderer::init(int width, int height) {
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);            // 3.0+ only
 #endif
 
+    // A hidden window still gets a full GL context, which is enough for offscreen runs
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
     // Create a m_windowed mode m_window and its OpenGL context
     m_window = glfwCreateWindow(width, height, "Media Player", nullptr, nullptr);
     if (!m_window) {
@@ -62,6 +65,10 @@ bool Renderer::init(int width, int height) {
     // Set up the viewport
     glViewport(0, 0, width, height);
 
+    // Installed before ImGui so its GLFW backend chains to our callback
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetKeyCallback(m_window, key_callback);
+
     // Initialize ImGui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -87,10 +94,14 @@ bool Renderer::init(int width, int height) {
     // Set up the quad for rendering
     setupQuad();
 
+    if (!m_gpuTimer.init()) {
+        std::cerr << "GL timer queries unavailable, GPU stage timings disabled." << std::endl;
+    }
+
     return true;
 }
 
-void Renderer::renderFrame(const uint8_t* frameData, int width, int height, double frameDelay) {
+void Renderer::renderFrame(const uint8_t* frameData, int width, int height, double frameDelay, int64_t pts) {
     // Clear the screen
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -99,42 +110,97 @@ void Renderer::renderFrame(const uint8_t* frameData, int width, int height, doub
     glViewport(0, 0, display_w, display_h);
 
     // Bind the texture and upload the frame data
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, frameData);
+    {
+        ScopedStageTimer timer(Stage::Upload);
+        TraceScope trace("upload", pts);
+        m_gpuTimer.begin(Stage::GpuUpload);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, frameData);
+        m_gpuTimer.end();
+    }
 
     // Use the shader program and draw the quad
-    m_shader->use();
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    {
+        ScopedStageTimer timer(Stage::Draw);
+        TraceScope trace("draw", pts);
+        m_gpuTimer.begin(Stage::GpuDraw);
+        m_shader->use();
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+        // Render the ImGui UI
+        render();
+        m_gpuTimer.end();
+    }
 
-    // Render the ImGui UI
-    render();
+    // Hold the frame until its slot. Deadlines advance by the frame duration instead of
+    // sleeping a full frame after the swap, so decode and draw time don't add up as drift.
+    auto now = std::chrono::steady_clock::now();
+    auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(frameDelay));
+    m_lastFrameLate = m_nextDeadline.time_since_epoch().count() != 0 && now > m_nextDeadline + LATE_TOLERANCE;
+    if (m_nextDeadline.time_since_epoch().count() == 0 || now > m_nextDeadline + frameDuration) {
+        // First frame, or more than a frame behind: restart the schedule rather than rushing to catch up
+        m_nextDeadline = now;
+    }
+    std::this_thread::sleep_until(m_nextDeadline);
+    m_nextDeadline += frameDuration;
 
     // Swap buffers
-    glfwSwapBuffers(m_window);
-    glfwPollEvents();
+    {
+        ScopedStageTimer timer(Stage::Swap);
+        TraceScope trace("present", pts);
+        glfwSwapBuffers(m_window);
+        m_lastPresentTime = std::chrono::steady_clock::now();
+        glfwPollEvents();
+    }
+    m_gpuTimer.collect();
+    Profiler::instance().increment(Counter::FramesPresented);
+}
 
-    std::cout<<"frameDelay: "<<frameDelay<<std::endl;
-    std::this_thread::sleep_for(std::chrono::duration<double>(frameDelay));
+void Renderer::handleKey(int key, bool repeat) const {
+    if (m_keyHandler) {
+        m_keyHandler(key, repeat);
+    }
+}
+
+bool Renderer::isBehindSchedule(double frameDelay) const {
+    if (m_nextDeadline.time_since_epoch().count() == 0) {
+        return false;
+    }
+    return std::chrono::steady_clock::now() > m_nextDeadline + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(frameDelay));
+}
+
+void Renderer::dropFrame(double frameDelay) {
+    m_nextDeadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(frameDelay));
+    Profiler::instance().increment(Counter::FramesDropped);
 }
 
 void Renderer::render() {
     processInput();
+    // Skip the whole ImGui pass while nothing is shown
+    if (!m_statsOverlay.isVisible()) {
+        return;
+    }
+
     // Start a new ImGui frame
-    // ImGui_ImplOpenGL3_NewFrame();
-    // ImGui_ImplGlfw_NewFrame();
-    // ImGui::NewFrame();
-    //
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    m_statsOverlay.draw();
     // ImGui::Begin("Media Player Controls");
     // ImGui::Text("Hello, world!");
     // if (ImGui::Button("Play/Pause")) {
     //     // Add play/pause logic here
     // }
     // ImGui::End();
-    //
-    // // Render ImGui
-    // ImGui::Render();
-    // ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // Render ImGui
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void Renderer::cleanup() {
@@ -144,6 +210,7 @@ void Renderer::cleanup() {
     ImGui::DestroyContext();
 
     // Clean up OpenGL resources
+    m_gpuTimer.cleanup();
     glDeleteTextures(1, &m_texture);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
@@ -239,5 +306,31 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int actions,
     {
         if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
+
+        // F1 shows or hides the stats overlay
+        if (key == GLFW_KEY_F1 && actions == GLFW_PRESS) {
+            auto* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(window));
+            if (renderer) {
+                renderer->toggleStatsOverlay();
+            }
+        }
+
+        // T starts a trace capture, pressing it again writes it out
+        if (key == GLFW_KEY_T && actions == GLFW_PRESS) {
+            Tracer& tracer = Tracer::instance();
+            if (tracer.isEnabled()) {
+                tracer.stop();
+                tracer.writeJson("trace.json");
+            } else {
+                std::cout << "Trace capture started." << std::endl;
+                tracer.start();
+            }
+        } else if (key != GLFW_KEY_F1 && actions != GLFW_RELEASE) {
+            // Everything else goes to the application
+            auto* renderer = static_cast<Renderer*>(glfwGetWindowUserPointer(window));
+            if (renderer) {
+                renderer->handleKey(key, actions == GLFW_REPEAT);
+            }
+        }
     }
 }
@@ -9,7 +9,11 @@
 #include <chrono>
 #include <thread>
 #include <map>
+#include <functional>
 #include "shader.hpp"
+#include "gpu_timer.hpp"
+#include "tracer.hpp"
+#include "stats_overlay.hpp"
 
 
 static void glfw_error_callback(int error, const char* description);
@@ -26,18 +30,44 @@ public:
     Renderer();
     ~Renderer();
 
-    bool init(int width, int height);
-    void renderFrame(const uint8_t* frameData, int width, int height,  double frameDelay=0.0f);
+    bool init(int width, int height, bool visible = true);
+    void renderFrame(const uint8_t* frameData, int width, int height,  double frameDelay=0.0f, int64_t pts=Tracer::NO_PTS);
     void render();
     void cleanup();
     GLFWwindow* getWindow() const { return m_window; }
     void processInput() const;
+    bool hasGpuTiming() const { return m_gpuTimer.isAvailable(); }
+    void toggleStatsOverlay() { m_statsOverlay.toggle(); }
+    // Receives key presses the renderer doesn't handle itself, e.g. playback controls.
+    // `repeat` is set for auto-repeat while the key is held.
+    void setKeyHandler(std::function<void(int key, bool repeat)> handler) { m_keyHandler = std::move(handler); }
+    void handleKey(int key, bool repeat) const;
+    // When the last frame's buffer swap returned
+    std::chrono::steady_clock::time_point lastPresentTime() const { return m_lastPresentTime; }
+    // When the next frame is due; the clock's epoch before the first frame
+    std::chrono::steady_clock::time_point nextDeadline() const { return m_nextDeadline; }
+    // Whether the last frame was ready only after its presentation deadline had passed
+    bool lastFrameLate() const { return m_lastFrameLate; }
+    // True when the next frame would be shown more than a frame period late. Dropping it
+    // instead skips its conversion and upload and lets the following frames catch up.
+    bool isBehindSchedule(double frameDelay) const;
+    // Accounts for a frame that is dropped instead of shown, keeping the schedule
+    void dropFrame(double frameDelay);
 
 private:
+    // Scheduler wake-up slop that shouldn't count as a missed deadline
+    static constexpr std::chrono::milliseconds LATE_TOLERANCE{2};
+
     GLFWwindow* m_window;
     GLuint m_texture;
     GLuint VAO, VBO, EBO;
     Shader* m_shader;
+    GpuTimer m_gpuTimer;
+    StatsOverlay m_statsOverlay;
+    std::chrono::steady_clock::time_point m_nextDeadline;
+    std::chrono::steady_clock::time_point m_lastPresentTime;
+    bool m_lastFrameLate;
+    std::function<void(int key, bool repeat)> m_keyHandler;
 
     void setupQuad();
 
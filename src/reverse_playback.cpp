@@ -0,0 +1,132 @@
+#include "reverse_playback.hpp"
+#include "tracer.hpp"
+#include "video_decoder.hpp"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+
+
+namespace {
+
+// Below this a chunk costs more in repeated keyframe decodes than it saves in memory
+constexpr size_t MIN_CHUNK_FRAMES = 8;
+
+} // namespace
+
+ReversePlayback::ReversePlayback(const std::string& filePath, size_t byteBudget)
+    : m_filePath(filePath), m_byteBudget(byteBudget), m_chunkFrames(MIN_CHUNK_FRAMES),
+      m_stop(false), m_done(false) {
+}
+
+ReversePlayback::~ReversePlayback() {
+    stop();
+}
+
+bool ReversePlayback::start(int64_t pts, const std::vector<int64_t>& keyframes) {
+    stop();
+    if (!m_decoder) {
+        auto decoder = std::make_unique<MPDecoder>();
+        if (!decoder->open(m_filePath)) {
+            return false;
+        }
+        m_decoder = std::move(decoder);
+        // Half the budget waits in the queue, the other half is the chunk being decoded.
+        // 10-bit and 4:4:4 frames are two to four times the size of 8-bit 4:2:0 ones.
+        int frameSize = av_image_get_buffer_size(m_decoder->getVideoPixelFormat(), m_decoder->getVideoWidth(),
+                                                 m_decoder->getVideoHeight(), 1);
+        if (frameSize <= 0) {
+            // Format not known until the first frame: assume 8-bit 4:2:0
+            frameSize = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, m_decoder->getVideoWidth(),
+                                                 m_decoder->getVideoHeight(), 1);
+        }
+        size_t frameBytes = std::max<size_t>(1, static_cast<size_t>(std::max(frameSize, 0)));
+        m_chunkFrames = std::max(MIN_CHUNK_FRAMES, m_byteBudget / 2 / frameBytes);
+    }
+    if (!m_decoder->hasKeyframeIndex() && !keyframes.empty()) {
+        m_decoder->setKeyframeIndex(keyframes);
+    }
+    m_queue = std::make_unique<FrameQueue>(m_chunkFrames);
+
+    m_stop = false;
+    m_done = false;
+    m_worker = std::thread(&ReversePlayback::run, this, pts);
+    return true;
+}
+
+void ReversePlayback::stop() {
+    m_stop = true;
+    if (m_queue) {
+        // Unblocks a worker waiting for room in the queue
+        m_queue->close();
+    }
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    m_queue.reset();
+    // Nothing more is coming until the next start()
+    m_done = true;
+}
+
+bool ReversePlayback::nextFrame(AVFrame* frame) {
+    return m_queue && m_queue->tryPop(frame);
+}
+
+bool ReversePlayback::finished() const {
+    return m_done && (!m_queue || m_queue->size() == 0);
+}
+
+void ReversePlayback::run(int64_t endPts) {
+    Tracer::instance().setThreadName("reverse");
+    if (!m_decoder->hasKeyframeIndex() && !m_decoder->buildKeyframeIndex()) {
+        std::cerr << "Reverse playback needs a keyframe index, none could be built." << std::endl;
+        m_done = true;
+        return;
+    }
+    while (!m_stop && endPts != AV_NOPTS_VALUE) {
+        endPts = decodeChunk(endPts);
+    }
+    m_done = true;
+}
+
+int64_t ReversePlayback::decodeChunk(int64_t endPts) {
+    int64_t keyframe = m_decoder->keyframeAtOrBefore(endPts - 1);
+    if (keyframe == AV_NOPTS_VALUE) {
+        return AV_NOPTS_VALUE;
+    }
+    TraceScope trace("reverse_gop", keyframe);
+    if (!m_decoder->seek(m_decoder->ptsToSeconds(keyframe), false)) {
+        return AV_NOPTS_VALUE;
+    }
+
+    // Frames come out in presentation order; keep a sliding window of the newest ones before endPts
+    std::deque<AVFrame*> chunk;
+    while (!m_stop && m_decoder->decodeFrame()) {
+        AVFrame* decoded = m_decoder->getDecodedFrame();
+        int64_t pts = decoded->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE || pts < keyframe) {
+            // Leading pictures of an open GOP; they're shown as part of the GOP before
+            continue;
+        }
+        if (pts >= endPts) {
+            break;
+        }
+        chunk.push_back(av_frame_clone(decoded));
+        if (chunk.size() > m_chunkFrames) {
+            av_frame_free(&chunk.front());
+            chunk.pop_front();
+        }
+    }
+
+    int64_t oldest = chunk.empty() ? keyframe : chunk.front()->best_effort_timestamp;
+    while (!chunk.empty()) {
+        AVFrame* frame = chunk.back();
+        chunk.pop_back();
+        // Blocks while the previous chunk is still being shown
+        if (!m_stop) {
+            m_queue->push(frame);
+        }
+        av_frame_free(&frame);
+    }
+    // Reaching the keyframe means the whole GOP is out; otherwise the rest of it comes next
+    return oldest;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_queue.hpp"
+
+class MPDecoder;
+
+
+// Plays a file backwards at normal speed. A worker thread with its own decoder seeks to
+// the keyframe before the current position, decodes that GOP and hands its frames over
+// newest first through a FrameQueue, then moves on to the GOP before it while those are
+// being shown. A GOP whose frames don't fit the memory budget is split into chunks taken
+// from its end; every chunk decodes from the keyframe again, trading decode time for memory.
+// The decoder and its keyframe index outlive stop(), so playback can be reversed again
+// without reopening or rescanning the file.
+class ReversePlayback {
+public:
+    // Decoded frames held at once, across the queue and the chunk being decoded
+    static constexpr size_t DEFAULT_BYTE_BUDGET = 256u * 1024 * 1024;
+
+    explicit ReversePlayback(const std::string& filePath, size_t byteBudget = DEFAULT_BYTE_BUDGET);
+    ~ReversePlayback();
+    ReversePlayback (const ReversePlayback &) =delete;
+    ReversePlayback& operator=(const ReversePlayback &) =delete;
+
+    // Starts producing the frames before `pts` (video stream time base), newest first.
+    // `keyframes` is an index another decoder already built for the file; without one the
+    // worker scans the file the first time.
+    bool start(int64_t pts, const std::vector<int64_t>& keyframes = {});
+    void stop();
+
+    // Moves the next frame back into `frame`. Returns false when none is ready yet, or once
+    // the start of the file has been reached (see finished()).
+    bool nextFrame(AVFrame* frame);
+    // Everything up to the start of the file has been handed out
+    bool finished() const;
+
+private:
+    void run(int64_t endPts);
+    // Decodes the frames before `endPts` from the keyframe at or before it and queues the
+    // last m_chunkFrames of them newest first. Returns the PTS of the oldest one queued,
+    // or AV_NOPTS_VALUE when nothing is left.
+    int64_t decodeChunk(int64_t endPts);
+
+    std::string m_filePath;
+    size_t m_byteBudget;
+    size_t m_chunkFrames;
+    std::unique_ptr<MPDecoder> m_decoder;
+    std::unique_ptr<FrameQueue> m_queue;
+    std::thread m_worker;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_done;
+};
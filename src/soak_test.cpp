@@ -0,0 +1,176 @@
+#include "soak_test.hpp"
+#include "memory_usage.hpp"
+#include "profiler.hpp"
+#include "video_decoder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+
+namespace {
+
+constexpr int FRAMES_PER_CYCLE = 100;
+constexpr int SEEKS_PER_CYCLE = 5;
+constexpr int FRAMES_PER_SEEK = 10;
+constexpr int STEPS_PER_CYCLE = 5;
+// A typical device format, so sources at other rates or channel counts go through swr
+constexpr int OUTPUT_CHANNELS = 2;
+constexpr int OUTPUT_RATE = 48000;
+// Small enough that a cycle fills and evicts, without the cache itself dominating RSS
+constexpr size_t CACHE_BYTES = 32u * 1024 * 1024;
+
+// Converts every frame like playback does, so the sws context and RGB frame are exercised too
+int64_t decodeFrames(MPDecoder& decoder, int count) {
+    int64_t decoded = 0;
+    while (decoded < count && decoder.decodeFrame()) {
+        decoder.getVideoFrame();
+        decoded++;
+    }
+    return decoded;
+}
+
+// Back and then forward again over the frames just decoded
+int64_t stepFrames(MPDecoder& decoder) {
+    int64_t steps = 0;
+    for (int i = 0; i < STEPS_PER_CYCLE && decoder.stepBackward(); i++) {
+        decoder.getVideoFrame();
+        steps++;
+    }
+    for (int i = 0; i < STEPS_PER_CYCLE && decoder.stepForward(); i++) {
+        decoder.getVideoFrame();
+        steps++;
+    }
+    return steps;
+}
+
+} // namespace
+
+bool runSoakTest(const SoakTestOptions& options, SoakTestResult& result) {
+    MPDecoder decoder;
+    if (!decoder.open(options.filePath)) {
+        std::cerr << "Failed to open media file " << options.filePath << std::endl;
+        return false;
+    }
+    const double duration = decoder.getDuration();
+    decoder.close();
+
+    const double runSeconds = options.hours * 3600.0;
+    const double warmupSeconds = runSeconds * options.warmupFraction;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> anywhere(0.0, std::max(0.0, duration - 1.0));
+
+    decoder.setAudioSink([&result](const float* const*, int frames) { result.audioFrames += frames; });
+
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    while (elapsed < runSeconds) {
+        bool ok = decoder.open(options.filePath);
+        if (ok) {
+            if (decoder.hasAudio() && !decoder.setAudioOutput(OUTPUT_CHANNELS, OUTPUT_RATE)) {
+                ok = false;
+            }
+            decoder.setFrameCacheBudget(CACHE_BYTES);
+        }
+        if (ok) {
+            // Alternate so both the indexed and the plain seek paths get exercised
+            if (result.cycles % 2 == 1) {
+                decoder.buildKeyframeIndex();
+            }
+            result.framesDecoded += decodeFrames(decoder, FRAMES_PER_CYCLE);
+            result.steps += stepFrames(decoder);
+            // ... and both the cached and the seeking step paths
+            if (result.cycles % 2 == 1) {
+                decoder.setFrameCacheBudget(0);
+                result.steps += stepFrames(decoder);
+            }
+            for (int i = 0; i < SEEKS_PER_CYCLE && duration > 1.0; i++) {
+                if (decoder.seek(anywhere(rng), i % 2 == 0)) {
+                    result.framesDecoded += decodeFrames(decoder, FRAMES_PER_SEEK);
+                }
+                result.seeks++;
+            }
+        }
+        if (!ok) {
+            result.failedCycles++;
+        }
+        decoder.close();
+        result.cycles++;
+
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const Profiler& profiler = Profiler::instance();
+        SoakTestResult::Sample sample{elapsed, currentRssBytes(),
+                                      profiler.gauge(Gauge::DecoderBuffers),
+                                      profiler.gauge(Gauge::DecoderBufferBytes)};
+        result.samples.push_back(sample);
+        result.leakedBuffers = std::max(result.leakedBuffers, sample.decoderBuffers);
+    }
+
+    // Highest RSS seen during the warm-up against the lowest in the last tenth of the run, so
+    // transient peaks at either end don't read as growth but a steady climb still does
+    auto warmupEnd = std::find_if(result.samples.begin(), result.samples.end(),
+        [warmupSeconds](const SoakTestResult::Sample& s) { return s.elapsedSeconds > warmupSeconds; });
+    auto tailStart = result.samples.end() - std::max<ptrdiff_t>(1, result.samples.size() / 10);
+    for (auto it = result.samples.begin(); it != warmupEnd && it != result.samples.end(); ++it) {
+        result.baselineRssBytes = std::max(result.baselineRssBytes, it->rssBytes);
+    }
+    if (result.baselineRssBytes == 0 && !result.samples.empty()) {
+        result.baselineRssBytes = result.samples.front().rssBytes;
+    }
+    result.finalRssBytes = SIZE_MAX;
+    for (auto it = tailStart; it != result.samples.end(); ++it) {
+        result.finalRssBytes = std::min(result.finalRssBytes, it->rssBytes);
+    }
+    if (result.samples.empty()) {
+        result.finalRssBytes = 0;
+    }
+
+    result.passed = result.failedCycles == 0 && result.leakedBuffers == 0 &&
+                    result.growthMb() <= options.maxGrowthMb;
+    return true;
+}
+
+void printSoakReport(const SoakTestOptions& options, const SoakTestResult& result) {
+    std::cout << std::fixed << std::setprecision(2)
+              << options.filePath << '\n'
+              << "  cycles:         " << result.cycles << " (" << result.failedCycles << " failed)\n"
+              << "  frames:         " << result.framesDecoded << '\n'
+              << "  seeks:          " << result.seeks << '\n'
+              << "  steps:          " << result.steps << '\n'
+              << "  audio frames:   " << result.audioFrames << '\n'
+              << "  baseline RSS:   " << result.baselineRssBytes / (1024.0 * 1024.0) << " MiB\n"
+              << "  final RSS:      " << result.finalRssBytes / (1024.0 * 1024.0) << " MiB\n"
+              << "  growth:         " << result.growthMb() << " MiB (limit " << options.maxGrowthMb << ")\n"
+              << "  leaked buffers: " << result.leakedBuffers << '\n'
+              << "  result:         " << (result.passed ? "PASS" : "FAIL") << std::endl;
+}
+
+bool writeSoakJson(const SoakTestResult& result, const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open " << path << " for writing." << std::endl;
+        return false;
+    }
+    file << "{\n"
+         << "  \"passed\": " << (result.passed ? "true" : "false") << ",\n"
+         << "  \"cycles\": " << result.cycles << ",\n"
+         << "  \"failed_cycles\": " << result.failedCycles << ",\n"
+         << "  \"frames\": " << result.framesDecoded << ",\n"
+         << "  \"seeks\": " << result.seeks << ",\n"
+         << "  \"steps\": " << result.steps << ",\n"
+         << "  \"audio_frames\": " << result.audioFrames << ",\n"
+         << "  \"baseline_rss_bytes\": " << result.baselineRssBytes << ",\n"
+         << "  \"final_rss_bytes\": " << result.finalRssBytes << ",\n"
+         << "  \"leaked_buffers\": " << result.leakedBuffers << ",\n"
+         << "  \"samples\": [";
+    for (size_t i = 0; i < result.samples.size(); i++) {
+        const SoakTestResult::Sample& s = result.samples[i];
+        file << (i ? ",\n    " : "\n    ")
+             << "[" << s.elapsedSeconds << ", " << s.rssBytes << ", "
+             << s.decoderBuffers << ", " << s.decoderBufferBytes << "]";
+    }
+    file << "\n  ]\n}\n";
+    return file.good();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Headless long-running open/decode/seek/step/close loop on a single reused MPDecoder, with
+// frame conversion, an audio sink behind the converter and the frame cache all in use.
+// Samples resident memory and the decoder's live frame buffers after every cycle and
+// fails when either keeps growing once the warm-up is over.
+struct SoakTestOptions {
+    std::string filePath;
+    double hours = 1.0;
+    // Allowed resident memory growth between the end of the warm-up and the end of the run
+    double maxGrowthMb = 16.0;
+    // Fraction of the run spent warming up allocator pools and caches before the baseline
+    double warmupFraction = 0.1;
+    // Empty skips the JSON report
+    std::string jsonPath;
+};
+
+struct SoakTestResult {
+    struct Sample {
+        double elapsedSeconds;
+        size_t rssBytes;
+        int64_t decoderBuffers;
+        int64_t decoderBufferBytes;
+    };
+
+    std::vector<Sample> samples;
+    int64_t cycles = 0;
+    int64_t framesDecoded = 0;
+    int64_t seeks = 0;
+    int64_t steps = 0;
+    // Sample frames delivered to the audio sink
+    int64_t audioFrames = 0;
+    int64_t failedCycles = 0;
+    size_t baselineRssBytes = 0;
+    size_t finalRssBytes = 0;
+    // Buffers still alive after close() in the worst cycle; anything but 0 is a leaked frame reference
+    int64_t leakedBuffers = 0;
+    bool passed = false;
+
+    double growthMb() const {
+        return (static_cast<double>(finalRssBytes) - static_cast<double>(baselineRssBytes)) / (1024.0 * 1024.0);
+    }
+};
+
+bool runSoakTest(const SoakTestOptions& options, SoakTestResult& result);
+void printSoakReport(const SoakTestOptions& options, const SoakTestResult& result);
+bool writeSoakJson(const SoakTestResult& result, const std::string& path);
@@ -0,0 +1,110 @@
+#include "stats_overlay.hpp"
+#include "decode_quality.hpp"
+#include "memory_usage.hpp"
+#include <imgui/imgui.h>
+
+
+StatsOverlay::StatsOverlay()
+    : m_visible(false), m_lastDecoded(0), m_lastPresented(0) {
+}
+
+void StatsOverlay::refresh() {
+    Profiler& profiler = Profiler::instance();
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - m_lastRefresh).count();
+
+    uint64_t decoded = profiler.counter(Counter::FramesDecoded);
+    uint64_t presented = profiler.counter(Counter::FramesPresented);
+    if (elapsed > 0.0) {
+        m_snapshot.decodeFps = (decoded - m_lastDecoded) / elapsed;
+        m_snapshot.presentFps = (presented - m_lastPresented) / elapsed;
+    }
+    m_lastDecoded = decoded;
+    m_lastPresented = presented;
+    m_lastRefresh = now;
+
+    m_snapshot.presented = presented;
+    m_snapshot.dropped = profiler.counter(Counter::FramesDropped);
+    m_snapshot.duplicated = profiler.counter(Counter::FramesDuplicated);
+    m_snapshot.underruns = profiler.counter(Counter::AudioUnderruns);
+    m_snapshot.videoQueueDepth = profiler.gauge(Gauge::VideoQueueDepth);
+    m_snapshot.audioQueueBytes = profiler.gauge(Gauge::AudioQueueBytes);
+    m_snapshot.avOffsetMs = profiler.gauge(Gauge::AvOffsetUs) / 1000.0;
+    m_snapshot.audioLatencyMs = profiler.gauge(Gauge::AudioLatencyUs) / 1000.0;
+    m_snapshot.audioBufferFrames = profiler.gauge(Gauge::AudioBufferFrames);
+    m_snapshot.callbackJitterMs = profiler.gauge(Gauge::AudioCallbackJitterUs) / 1000.0;
+    m_snapshot.lastUnderrunUs = profiler.gauge(Gauge::AudioLastUnderrunUs);
+    m_snapshot.driftPpm = profiler.gauge(Gauge::AudioDriftPpm);
+    m_snapshot.decodeQuality = profiler.gauge(Gauge::DecodeQuality);
+    m_snapshot.cacheHits = profiler.counter(Counter::FrameCacheHits);
+    m_snapshot.cacheMisses = profiler.counter(Counter::FrameCacheMisses);
+    m_snapshot.cacheEvictions = profiler.counter(Counter::FrameCacheEvictions);
+    m_snapshot.cacheBytes = profiler.gauge(Gauge::FrameCacheBytes);
+    for (size_t i = 0; i < m_snapshot.stages.size(); i++) {
+        m_snapshot.stages[i] = profiler.stats(static_cast<Stage>(i));
+    }
+    m_snapshot.rssBytes = currentRssBytes();
+    m_snapshot.peakRssBytes = peakRssBytes();
+}
+
+void StatsOverlay::draw() {
+    if (!m_visible) {
+        return;
+    }
+    if (std::chrono::steady_clock::now() - m_lastRefresh >= REFRESH_INTERVAL) {
+        refresh();
+    }
+
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    ImGui::Begin("Stats", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing);
+
+    ImGui::Text("Decode: %.1f fps   Present: %.1f fps", m_snapshot.decodeFps, m_snapshot.presentFps);
+    ImGui::Text("Presented: %llu  Dropped: %llu  Duplicated: %llu",
+                (unsigned long long)m_snapshot.presented,
+                (unsigned long long)m_snapshot.dropped,
+                (unsigned long long)m_snapshot.duplicated);
+    ImGui::Text("Video queue: %lld frames  Audio queue: %.1f KiB  Underruns: %llu",
+                (long long)m_snapshot.videoQueueDepth,
+                m_snapshot.audioQueueBytes / 1024.0,
+                (unsigned long long)m_snapshot.underruns);
+    ImGui::Text("A/V offset: %+.1f ms  Clock drift: %+lld ppm", m_snapshot.avOffsetMs, (long long)m_snapshot.driftPpm);
+    ImGui::Text("Audio buffer: %lld frames  Latency: %.1f ms  Callback jitter: %.1f ms",
+                (long long)m_snapshot.audioBufferFrames, m_snapshot.audioLatencyMs, m_snapshot.callbackJitterMs);
+    if (m_snapshot.lastUnderrunUs > 0) {
+        auto wallClock = std::chrono::system_clock::now().time_since_epoch();
+        int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(wallClock).count();
+        ImGui::Text("Last underrun: %.0f s ago", (nowUs - m_snapshot.lastUnderrunUs) / 1e6);
+    }
+    ImGui::Text("Decode quality: %s", decodeQualityName(static_cast<DecodeQuality>(m_snapshot.decodeQuality)));
+    uint64_t lookups = m_snapshot.cacheHits + m_snapshot.cacheMisses;
+    ImGui::Text("Frame cache: %.1f MiB  Hit rate: %.0f%%  Evictions: %llu",
+                m_snapshot.cacheBytes / (1024.0 * 1024.0),
+                lookups > 0 ? 100.0 * m_snapshot.cacheHits / lookups : 0.0,
+                (unsigned long long)m_snapshot.cacheEvictions);
+    ImGui::Text("RSS: %.1f MiB (peak %.1f MiB)",
+                m_snapshot.rssBytes / (1024.0 * 1024.0),
+                m_snapshot.peakRssBytes / (1024.0 * 1024.0));
+
+    if (ImGui::BeginTable("stages", 4, ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("stage");
+        ImGui::TableSetupColumn("p50 ms");
+        ImGui::TableSetupColumn("p99 ms");
+        ImGui::TableSetupColumn("max ms");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i < m_snapshot.stages.size(); i++) {
+            const StageStats& stats = m_snapshot.stages[i];
+            if (stats.count == 0) {
+                continue;
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(stageName(static_cast<Stage>(i)));
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", stats.p50Ms);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", stats.p99Ms);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", stats.maxMs);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include "profiler.hpp"
+
+
+// ImGui window with live pipeline statistics. The numbers are sampled a few times per
+// second into a snapshot, so drawing it every frame only formats cached values.
+class StatsOverlay {
+public:
+    StatsOverlay();
+
+    void toggle() { m_visible = !m_visible; }
+    bool isVisible() const { return m_visible; }
+    // Must be called between ImGui::NewFrame() and ImGui::Render()
+    void draw();
+
+private:
+    static constexpr std::chrono::milliseconds REFRESH_INTERVAL{250};
+
+    struct Snapshot {
+        double decodeFps = 0.0;
+        double presentFps = 0.0;
+        uint64_t presented = 0;
+        uint64_t dropped = 0;
+        uint64_t duplicated = 0;
+        uint64_t underruns = 0;
+        int64_t videoQueueDepth = 0;
+        int64_t audioQueueBytes = 0;
+        double avOffsetMs = 0.0;
+        double audioLatencyMs = 0.0;
+        int64_t audioBufferFrames = 0;
+        double callbackJitterMs = 0.0;
+        int64_t lastUnderrunUs = 0;
+        int64_t driftPpm = 0;
+        int64_t decodeQuality = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t cacheEvictions = 0;
+        int64_t cacheBytes = 0;
+        std::array<StageStats, static_cast<size_t>(Stage::Count)> stages;
+        size_t rssBytes = 0;
+        size_t peakRssBytes = 0;
+    };
+
+    void refresh();
+
+    bool m_visible;
+    Snapshot m_snapshot;
+    std::chrono::steady_clock::time_point m_lastRefresh;
+    uint64_t m_lastDecoded;
+    uint64_t m_lastPresented;
+};
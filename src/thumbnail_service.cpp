@@ -0,0 +1,232 @@
+#include "thumbnail_service.hpp"
+#include "media_cache.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'M', 'P', 'T', 'H', 'U', 'M', 'B', '1'};
+
+struct CacheHeader {
+    char magic[8];
+    int32_t count;
+    int32_t columns;
+    int32_t cellWidth;
+    int32_t cellHeight;
+};
+
+}
+
+ThumbnailService::ThumbnailService()
+    : m_duration(0.0), m_count(0), m_columns(1), m_rows(0), m_cellWidth(0), m_cellHeight(0),
+      m_maxWidth(0), m_fromCache(false), m_stop(false), m_completed(0), m_failed(0) {
+}
+
+ThumbnailService::~ThumbnailService() {
+    stop();
+}
+
+bool ThumbnailService::start(const std::string& filePath, const ThumbnailOptions& options) {
+    stop();
+    m_count = 0;
+    if (options.count <= 0) {
+        return false;
+    }
+    m_stop = false;
+    m_completed = 0;
+    m_failed = 0;
+    m_fromCache = false;
+    m_filePath = filePath;
+    m_maxWidth = options.maxWidth;
+
+    // The first worker's decoder doubles as the probe for duration and cell size
+    auto probe = std::make_unique<KeyframeDecoder>();
+    if (!probe->open(filePath, options.maxWidth, [this] { return m_stop.load(); })) {
+        return false;
+    }
+    m_duration = probe->getDuration();
+    m_cellWidth = probe->outputWidth();
+    m_cellHeight = probe->outputHeight();
+    if (m_duration <= 0.0 || m_cellWidth <= 0 || m_cellHeight <= 0) {
+        std::cerr << "Thumbnails: no duration or frame size for " << filePath << std::endl;
+        return false;
+    }
+    m_count = options.count;
+    m_columns = std::clamp(options.columns, 1, m_count);
+    m_rows = (m_count + m_columns - 1) / m_columns;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_atlas.assign(static_cast<size_t>(atlasWidth()) * atlasHeight() * 3, 0);
+        m_seconds.assign(m_count, 0.0);
+        m_pending.clear();
+    }
+
+    m_cachePath.clear();
+    std::string cacheDir = options.cacheDir.empty() ? mediaCacheDir("thumbnails") : options.cacheDir;
+    if (!cacheDir.empty()) {
+        int32_t layout[3] = {m_count, m_columns, m_maxWidth};
+        m_cachePath = mediaCachePath(cacheDir, filePath, layout, sizeof(layout), ".thumbs");
+    }
+    if (!m_cachePath.empty() && loadCache()) {
+        m_fromCache = true;
+        return true;
+    }
+
+    int workers = options.workers;
+    if (workers <= 0) {
+        // Leave most cores to playback
+        workers = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 4);
+    }
+    workers = std::min(workers, m_count);
+    m_decoders.push_back(std::move(probe));
+    for (int i = 1; i < workers; i++) {
+        m_decoders.push_back(std::make_unique<KeyframeDecoder>());
+    }
+    for (int i = 0; i < workers; i++) {
+        int begin = m_count * i / workers;
+        int end = m_count * (i + 1) / workers;
+        m_workers.emplace_back(&ThumbnailService::run, this, i, begin, end);
+    }
+    return true;
+}
+
+void ThumbnailService::stop() {
+    m_stop = true;
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+    m_decoders.clear();
+}
+
+double ThumbnailService::thumbnailSeconds(int index) const {
+    // Cell centres, so the first and last thumbnails aren't the very first and last frames
+    return (index + 0.5) * m_duration / m_count;
+}
+
+bool ThumbnailService::takeUpdates(std::vector<ThumbnailUpdate>& updates) {
+    updates.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t rowBytes = static_cast<size_t>(m_cellWidth) * 3;
+    size_t atlasStride = static_cast<size_t>(atlasWidth()) * 3;
+    for (int index : m_pending) {
+        ThumbnailUpdate update;
+        update.index = index;
+        update.seconds = m_seconds[index];
+        update.x = (index % m_columns) * m_cellWidth;
+        update.y = (index / m_columns) * m_cellHeight;
+        update.width = m_cellWidth;
+        update.height = m_cellHeight;
+        update.rgb.resize(rowBytes * m_cellHeight);
+        for (int row = 0; row < m_cellHeight; row++) {
+            std::memcpy(update.rgb.data() + row * rowBytes,
+                        m_atlas.data() + (update.y + row) * atlasStride + update.x * 3, rowBytes);
+        }
+        updates.push_back(std::move(update));
+    }
+    m_pending.clear();
+    return !updates.empty();
+}
+
+void ThumbnailService::run(int worker, int begin, int end) {
+    Tracer::instance().setThreadName("thumbnails-" + std::to_string(worker));
+    KeyframeDecoder& decoder = *m_decoders[worker];
+    if (!decoder.isOpen() && !decoder.open(m_filePath, m_maxWidth, [this] { return m_stop.load(); })) {
+        for (int i = begin; i < end; i++) {
+            finishCell(false);
+        }
+        return;
+    }
+
+    PreviewFrame frame;
+    for (int i = begin; i < end && !m_stop; i++) {
+        bool ok = decoder.decodeNear(thumbnailSeconds(i), frame);
+        if (ok) {
+            store(i, frame);
+        }
+        finishCell(ok);
+    }
+}
+
+void ThumbnailService::store(int index, const PreviewFrame& frame) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int x = (index % m_columns) * m_cellWidth;
+    int y = (index / m_columns) * m_cellHeight;
+    size_t atlasStride = static_cast<size_t>(atlasWidth()) * 3;
+    size_t rowBytes = static_cast<size_t>(std::min(frame.width, m_cellWidth)) * 3;
+    for (int row = 0; row < std::min(frame.height, m_cellHeight); row++) {
+        std::memcpy(m_atlas.data() + (y + row) * atlasStride + x * 3,
+                    frame.rgb.data() + static_cast<size_t>(row) * frame.width * 3, rowBytes);
+    }
+    m_seconds[index] = frame.seconds;
+    m_pending.push_back(index);
+}
+
+void ThumbnailService::finishCell(bool ok) {
+    if (!ok) {
+        m_failed++;
+    }
+    // The last cell to finish writes the cache, and only for a complete atlas
+    if (++m_completed == m_count && m_failed == 0 && !m_stop && !m_cachePath.empty()) {
+        writeCache();
+    }
+}
+
+bool ThumbnailService::loadCache() {
+    std::ifstream file(m_cachePath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.count != m_count || header.columns != m_columns ||
+        header.cellWidth != m_cellWidth || header.cellHeight != m_cellHeight) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!file.read(reinterpret_cast<char*>(m_seconds.data()), m_seconds.size() * sizeof(double)) ||
+        !file.read(reinterpret_cast<char*>(m_atlas.data()), m_atlas.size())) {
+        std::fill(m_atlas.begin(), m_atlas.end(), 0);
+        return false;
+    }
+    for (int i = 0; i < m_count; i++) {
+        m_pending.push_back(i);
+    }
+    m_completed = m_count;
+    return true;
+}
+
+void ThumbnailService::writeCache() const {
+    // Write then rename so a crash never leaves a truncated cache entry behind
+    std::string tempPath = m_cachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header;
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.count = m_count;
+        header.columns = m_columns;
+        header.cellWidth = m_cellWidth;
+        header.cellHeight = m_cellHeight;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(m_seconds.data()), m_seconds.size() * sizeof(double));
+        file.write(reinterpret_cast<const char*>(m_atlas.data()), m_atlas.size());
+        if (!file) {
+            std::cerr << "Couldn't write thumbnail cache " << tempPath << std::endl;
+            file.close();
+            std::remove(tempPath.c_str());
+            return;
+        }
+    }
+    if (std::rename(tempPath.c_str(), m_cachePath.c_str()) != 0) {
+        std::cerr << "Couldn't update thumbnail cache " << m_cachePath << std::endl;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "keyframe_decoder.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct ThumbnailOptions {
+    int count = 20;
+    // Worker decoders; 0 picks from the core count
+    int workers = 0;
+    int maxWidth = 160;
+    // Atlas cells per row
+    int columns = 10;
+    // Empty uses mediaCacheDir("thumbnails"); caching is skipped if there's none
+    std::string cacheDir;
+};
+
+// A thumbnail that just landed in the atlas, with its pixels for a glTexSubImage2D at (x, y)
+struct ThumbnailUpdate {
+    int index = 0;
+    double seconds = 0.0;
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+};
+
+// Evenly spaced thumbnails for a timeline strip, packed into an RGB24 atlas of
+// `columns` x ceil(count / columns) cells. The timeline is split into contiguous ranges,
+// one per worker thread, and each worker runs its own KeyframeDecoder, so the strip
+// fills in from several places at once. Finished atlases are written to a disk cache
+// keyed by path, size, modification time and layout, and come back without decoding.
+class ThumbnailService {
+public:
+    ThumbnailService();
+    ~ThumbnailService();
+    ThumbnailService (const ThumbnailService &) =delete;
+    ThumbnailService& operator=(const ThumbnailService &) =delete;
+
+    bool start(const std::string& filePath, const ThumbnailOptions& options = ThumbnailOptions());
+    void stop();
+
+    // Thumbnails finished since the last call, in completion order
+    bool takeUpdates(std::vector<ThumbnailUpdate>& updates);
+    bool finished() const { return m_completed.load() == m_count; }
+    int completed() const { return m_completed.load(); }
+    bool loadedFromCache() const { return m_fromCache; }
+
+    int count() const { return m_count; }
+    int cellWidth() const { return m_cellWidth; }
+    int cellHeight() const { return m_cellHeight; }
+    int atlasWidth() const { return m_columns * m_cellWidth; }
+    int atlasHeight() const { return m_rows * m_cellHeight; }
+    // Position of thumbnail `index` on the timeline
+    double thumbnailSeconds(int index) const;
+
+private:
+    void run(int worker, int begin, int end);
+    void store(int index, const PreviewFrame& frame);
+    void finishCell(bool ok);
+    bool loadCache();
+    void writeCache() const;
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<KeyframeDecoder>> m_decoders;
+    std::string m_filePath;
+    std::string m_cachePath;
+    double m_duration;
+    int m_count;
+    int m_columns;
+    int m_rows;
+    int m_cellWidth;
+    int m_cellHeight;
+    int m_maxWidth;
+    bool m_fromCache;
+
+    std::atomic<bool> m_stop;
+    std::atomic<int> m_completed;
+    std::atomic<int> m_failed;
+    mutable std::mutex m_mutex;
+    std::vector<uint8_t> m_atlas;
+    // Seconds of the frame actually shown in each cell
+    std::vector<double> m_seconds;
+    std::vector<int> m_pending;
+};
+
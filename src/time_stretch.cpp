@@ -0,0 +1,191 @@
+#include "time_stretch.hpp"
+#include "audio_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+namespace {
+
+// Offsets tried in the first pass of the search; the second pass fills in around the winner
+constexpr int COARSE_STEP = 4;
+// Consumed input is only erased in batches this many hops long
+constexpr int DISCARD_HOPS = 4;
+
+}
+
+TimeStretcher::TimeStretcher(int sampleRate, int channels)
+    : m_channels(std::max(channels, 1)),
+      m_hop(std::max(64, static_cast<int>(std::lround(sampleRate * WINDOW_SECONDS / 2)))),
+      m_search(std::max(1, static_cast<int>(std::lround(sampleRate * SEARCH_SECONDS)))),
+      m_tempo(1.0), m_input(m_channels), m_inputStart(0), m_position(0.0), m_previous(-1),
+      m_tail(m_channels), m_output(m_channels), m_outputRead(0) {
+    // Periodic Hann: two copies half a window apart sum to exactly 1
+    const int windowSize = 2 * m_hop;
+    m_window.resize(windowSize);
+    for (int i = 0; i < windowSize; i++) {
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / windowSize));
+    }
+    reset();
+}
+
+void TimeStretcher::setTempo(double tempo) {
+    tempo = std::clamp(tempo, MIN_TEMPO, MAX_TEMPO);
+    if (tempo != m_tempo) {
+        m_tempo = tempo;
+        reset();
+    }
+}
+
+void TimeStretcher::reset() {
+    for (int c = 0; c < m_channels; c++) {
+        m_input[c].clear();
+        m_output[c].clear();
+        m_tail[c].assign(m_hop, 0.0f);
+    }
+    m_mix.clear();
+    m_inputStart = 0;
+    m_position = 0.0;
+    m_previous = -1;
+    m_outputRead = 0;
+}
+
+void TimeStretcher::push(const float* const* planes, int frames) {
+    if (frames <= 0) {
+        return;
+    }
+    if (m_tempo == 1.0) {
+        for (int c = 0; c < m_channels; c++) {
+            m_output[c].insert(m_output[c].end(), planes[c], planes[c] + frames);
+        }
+        return;
+    }
+
+    for (int c = 0; c < m_channels; c++) {
+        m_input[c].insert(m_input[c].end(), planes[c], planes[c] + frames);
+    }
+    size_t mixStart = m_mix.size();
+    m_mix.insert(m_mix.end(), planes[0], planes[0] + frames);
+    float* mix = m_mix.data() + mixStart;
+    for (int c = 1; c < m_channels; c++) {
+        const float* plane = planes[c];
+        for (int i = 0; i < frames; i++) {
+            mix[i] += plane[i];
+        }
+    }
+
+    while (processSegment()) {
+    }
+    discardInput();
+}
+
+int TimeStretcher::pull(float* const* planes, int maxFrames) {
+    int frames = std::min(maxFrames, available());
+    if (frames <= 0) {
+        return 0;
+    }
+    for (int c = 0; c < m_channels; c++) {
+        std::copy_n(m_output[c].data() + m_outputRead, frames, planes[c]);
+    }
+    m_outputRead += frames;
+    if (m_outputRead == m_output[0].size()) {
+        for (std::vector<float>& output : m_output) {
+            output.clear();
+        }
+        m_outputRead = 0;
+    } else if (m_outputRead >= static_cast<size_t>(DISCARD_HOPS * m_hop)) {
+        for (std::vector<float>& output : m_output) {
+            output.erase(output.begin(), output.begin() + m_outputRead);
+        }
+        m_outputRead = 0;
+    }
+    return frames;
+}
+
+bool TimeStretcher::processSegment() {
+    const int64_t inputEnd = m_inputStart + static_cast<int64_t>(m_mix.size());
+    const int64_t center = std::llround(m_position);
+    int64_t offset = center;
+    if (m_previous >= 0) {
+        // What would have followed the last segment had the input not been skipped
+        const int64_t natural = m_previous + m_hop;
+        const int64_t first = std::max(center - m_search, m_inputStart);
+        const int64_t last = center + m_search;
+        if (last + 2 * m_hop > inputEnd || natural + m_hop > inputEnd) {
+            return false;
+        }
+        offset = bestOffset(first, last, m_mix.data() + (natural - m_inputStart));
+    } else if (center + 2 * m_hop > inputEnd) {
+        return false;
+    }
+
+    const size_t index = static_cast<size_t>(offset - m_inputStart);
+    for (int c = 0; c < m_channels; c++) {
+        std::vector<float>& output = m_output[c];
+        const float* segment = m_input[c].data() + index;
+        size_t outputStart = output.size();
+        output.resize(outputStart + m_hop);
+        windowedAdd(output.data() + outputStart, m_tail[c].data(), m_window.data(), segment, m_hop);
+        windowedAdd(m_tail[c].data(), nullptr, m_window.data() + m_hop, segment + m_hop, m_hop);
+    }
+    m_previous = offset;
+    m_position += m_hop * m_tempo;
+    return true;
+}
+
+int64_t TimeStretcher::bestOffset(int64_t first, int64_t last, const float* target) {
+    const float* mix = m_mix.data() + (first - m_inputStart);
+    const int candidates = static_cast<int>(last - first) + 1;
+
+    // Prefix sums of the squared mix give every candidate's energy in O(1)
+    m_energy.resize(candidates + m_hop + 1);
+    m_energy[0] = 0.0;
+    for (int i = 0; i < candidates + m_hop; i++) {
+        m_energy[i + 1] = m_energy[i] + static_cast<double>(mix[i]) * mix[i];
+    }
+    // Normalized by the candidate's energy only; the target's is the same for all of them
+    auto score = [&](int candidate) {
+        double energy = m_energy[candidate + m_hop] - m_energy[candidate];
+        return dotProduct(target, mix + candidate, m_hop) / std::sqrt(energy + 1e-9);
+    };
+
+    int best = 0;
+    double bestScore = score(0);
+    for (int candidate = COARSE_STEP; candidate < candidates; candidate += COARSE_STEP) {
+        double value = score(candidate);
+        if (value > bestScore) {
+            bestScore = value;
+            best = candidate;
+        }
+    }
+    const int coarse = best;
+    const int from = std::max(coarse - COARSE_STEP + 1, 0);
+    const int to = std::min(coarse + COARSE_STEP - 1, candidates - 1);
+    for (int candidate = from; candidate <= to; candidate++) {
+        if (candidate == coarse) {
+            continue;
+        }
+        double value = score(candidate);
+        if (value > bestScore) {
+            bestScore = value;
+            best = candidate;
+        }
+    }
+    return first + best;
+}
+
+void TimeStretcher::discardInput() {
+    // The next segment needs the previous one's natural continuation and its search range
+    int64_t keep = std::llround(m_position) - m_search;
+    if (m_previous >= 0) {
+        keep = std::min(keep, m_previous + m_hop);
+    }
+    const int64_t drop = std::min<int64_t>(keep - m_inputStart, m_mix.size());
+    if (drop < DISCARD_HOPS * m_hop) {
+        return;
+    }
+    for (std::vector<float>& input : m_input) {
+        input.erase(input.begin(), input.begin() + drop);
+    }
+    m_mix.erase(m_mix.begin(), m_mix.begin() + drop);
+    m_inputStart += drop;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// WSOLA (waveform-similarity overlap-add) time-stretcher on float planar audio: changes
+// playback speed without changing pitch. Output is built from Hann-windowed segments at
+// a fixed hop of half a window; each next segment is taken around tempo * hop further
+// into the input, shifted within +-SEARCH_SECONDS to where it lines up best with the
+// natural continuation of the previous one. Matching runs on a mono mix with the SIMD
+// dot product, coarse then fine, so the cost barely grows with the channel count.
+// Tempo 1 passes samples straight through. Not thread-safe.
+class TimeStretcher {
+public:
+    static constexpr double WINDOW_SECONDS = 0.04;
+    static constexpr double SEARCH_SECONDS = 0.01;
+    static constexpr double MIN_TEMPO = 0.25;
+    static constexpr double MAX_TEMPO = 4.0;
+
+    TimeStretcher(int sampleRate, int channels);
+    TimeStretcher (const TimeStretcher &) =delete;
+    TimeStretcher& operator=(const TimeStretcher &) =delete;
+
+    // Output seconds per input second is 1 / tempo. Changing it drops anything buffered.
+    void setTempo(double tempo);
+    double tempo() const { return m_tempo; }
+    void reset();
+
+    // `planes` holds one pointer per channel to `frames` samples
+    void push(const float* const* planes, int frames);
+    // Moves up to `maxFrames` stretched frames out; returns how many
+    int pull(float* const* planes, int maxFrames);
+    int available() const { return static_cast<int>(m_output[0].size() - m_outputRead); }
+    int channels() const { return m_channels; }
+
+private:
+    bool processSegment();
+    int64_t bestOffset(int64_t first, int64_t last, const float* target);
+    void discardInput();
+
+    int m_channels;
+    int m_hop;
+    int m_search;
+    double m_tempo;
+    std::vector<float> m_window;
+
+    // Input not yet consumed, per channel and mixed to mono; index 0 is m_inputStart
+    std::vector<std::vector<float>> m_input;
+    std::vector<float> m_mix;
+    int64_t m_inputStart;
+    // Ideal input position of the next segment, and where the last one really started
+    double m_position;
+    int64_t m_previous;
+    // Second half of the last windowed segment, waiting for the next one to overlap it
+    std::vector<std::vector<float>> m_tail;
+    std::vector<std::vector<float>> m_output;
+    size_t m_outputRead;
+    std::vector<double> m_energy;
+};
@@ -0,0 +1,145 @@
+#include "tracer.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+
+// Writes text as a JSON string literal; thread names come from callers and may hold anything
+static void writeJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+Tracer::Tracer()
+    : m_enabled(false), m_epoch(std::chrono::steady_clock::now()), m_nextThreadId(1) {
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        for (auto& buffer : m_buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->next = 0;
+            buffer->wrapped = false;
+        }
+    }
+    m_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop() {
+    m_enabled.store(false, std::memory_order_relaxed);
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.resize(EVENTS_PER_THREAD);
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        buffer->threadId = m_nextThreadId++;
+        buffer->name = "thread " + std::to_string(buffer->threadId);
+        m_buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Tracer::addEvent(const char* name, int64_t startUs, int64_t durationUs, int64_t pts) {
+    if (!isEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    // Only contended while a flush is reading this buffer
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events[buffer.next] = Event{name, startUs, durationUs, pts};
+    buffer.next++;
+    if (buffer.next == buffer.events.size()) {
+        buffer.next = 0;
+        buffer.wrapped = true;
+    }
+}
+
+int64_t Tracer::nowUs() const {
+    auto elapsed = std::chrono::steady_clock::now() - m_epoch;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+bool Tracer::writeJson(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Couldn't open trace file " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        buffers = m_buffers;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+
+        if (!first) file << ",\n";
+        first = false;
+        file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, buffer->name);
+        file << "}}";
+
+        size_t count = buffer->wrapped ? buffer->events.size() : buffer->next;
+        size_t begin = buffer->wrapped ? buffer->next : 0;
+        for (size_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[(begin + i) % buffer->events.size()];
+            file << ",\n{\"ph\":\"X\",\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs;
+            if (event.pts != NO_PTS) {
+                file << ",\"args\":{\"pts\":" << event.pts << "}";
+            }
+            file << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    std::cout << "Wrote trace to " << path << std::endl;
+    return file.good();
+}
+
+TraceScope::TraceScope(const char* name, int64_t pts)
+    : m_name(name), m_pts(pts), m_startUs(0), m_enabled(Tracer::instance().isEnabled()) {
+    if (m_enabled) {
+        m_startUs = Tracer::instance().nowUs();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (m_enabled) {
+        Tracer& tracer = Tracer::instance();
+        tracer.addEvent(m_name, m_startUs, tracer.nowUs() - m_startUs, m_pts);
+    }
+}
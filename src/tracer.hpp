@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Records timeline events into per-thread ring buffers and writes them as a Chrome
+// trace-event JSON file, which chrome://tracing and ui.perfetto.dev both open.
+// Recording is off until start() is called, so disabled tracing costs one atomic load.
+class Tracer {
+public:
+    static constexpr int64_t NO_PTS = INT64_MIN;
+    // Per-thread capacity; older events are overwritten once a thread fills its buffer
+    static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+    struct Event {
+        const char* name;
+        int64_t startUs;
+        int64_t durationUs;
+        int64_t pts;
+    };
+
+    static Tracer& instance();
+
+    void start();
+    void stop();
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // Names the calling thread in the trace
+    void setThreadName(const std::string& name);
+    void addEvent(const char* name, int64_t startUs, int64_t durationUs, int64_t pts);
+    int64_t nowUs() const;
+
+    // Writes everything captured since start(). Safe to call while recording.
+    bool writeJson(const std::string& path);
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        std::string name;
+        uint64_t threadId = 0;
+        std::vector<Event> events;
+        size_t next = 0;
+        bool wrapped = false;
+    };
+
+    Tracer();
+    ThreadBuffer& threadBuffer();
+
+    std::atomic<bool> m_enabled;
+    std::chrono::steady_clock::time_point m_epoch;
+    std::mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    uint64_t m_nextThreadId;
+};
+
+// Emits one complete ("X") event covering the enclosing scope
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, int64_t pts = Tracer::NO_PTS);
+    ~TraceScope();
+    TraceScope(const TraceScope &) =delete;
+    TraceScope& operator=(const TraceScope &) =delete;
+
+    // For stages that only learn the frame PTS halfway through (e.g. decode)
+    void setPts(int64_t pts) { m_pts = pts; }
+
+private:
+    const char* m_name;
+    int64_t m_pts;
+    int64_t m_startUs;
+    bool m_enabled;
+};
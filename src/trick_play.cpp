@@ -0,0 +1,262 @@
+#include "trick_play.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "video_decoder.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+TrickPlay::TrickPlay(MPDecoder& decoder)
+    : m_decoder(decoder), m_rate(1.0), m_mode(Mode::Forward), m_indexBuilt(false),
+      m_position(0.0), m_lastPts(AV_NOPTS_VALUE), m_shownKeyframe(AV_NOPTS_VALUE),
+      m_reverseFrame(av_frame_alloc()), m_reverseDisplay(nullptr),
+      m_loopStart(AV_NOPTS_VALUE), m_loopEnd(AV_NOPTS_VALUE) {
+}
+
+TrickPlay::~TrickPlay() {
+    m_reverse.reset();
+    av_frame_free(&m_reverseFrame);
+}
+
+TrickPlay::Mode TrickPlay::modeForRate(double rate) {
+    if (std::fabs(rate) >= KEYFRAME_RATE) {
+        return Mode::Keyframes;
+    }
+    return rate < 0.0 ? Mode::Reverse : Mode::Forward;
+}
+
+void TrickPlay::setRate(double rate) {
+    if (rate == 0.0) {
+        return;
+    }
+    m_rate = std::clamp(rate, -MAX_RATE, MAX_RATE);
+    Mode mode = modeForRate(m_rate);
+    if (mode != m_mode) {
+        enterMode(mode);
+    }
+}
+
+void TrickPlay::faster() {
+    if (m_rate < -1.0) {
+        setRate(m_rate / 2.0);
+    } else if (m_rate < 0.0) {
+        setRate(1.0);
+    } else {
+        setRate(m_rate * 2.0);
+    }
+}
+
+void TrickPlay::slower() {
+    if (m_rate > 1.0) {
+        setRate(m_rate / 2.0);
+    } else if (m_rate > 0.0) {
+        setRate(-1.0);
+    } else {
+        setRate(m_rate * 2.0);
+    }
+}
+
+TrickPlay::AudioMode TrickPlay::audioMode() const {
+    if (m_rate == 1.0) {
+        return AudioMode::Normal;
+    }
+    if (m_rate > 0.0 && m_rate <= 2.0) {
+        return AudioMode::TimeStretch;
+    }
+    return AudioMode::Mute;
+}
+
+void TrickPlay::enterMode(Mode mode) {
+    TraceScope trace("trick_play_mode");
+    // Every mode picks up from the frame on screen
+    double position = m_mode == Mode::Keyframes ? m_position
+                    : m_lastPts != AV_NOPTS_VALUE ? m_decoder.ptsToSeconds(m_lastPts)
+                    : 0.0;
+    position = std::max(0.0, position);
+    if (m_reverse) {
+        m_reverse->stop();
+    }
+    m_reverseDisplay = nullptr;
+
+    switch (mode) {
+        case Mode::Forward:
+            m_decoder.setDecodeQuality(DecodeQuality::Full);
+            m_decoder.seek(position, true);
+            m_lastPts = AV_NOPTS_VALUE;
+            break;
+        case Mode::Keyframes:
+            // One scan up front; without it every tick would need the demuxer to search for its keyframe
+            if (!m_indexBuilt) {
+                m_indexBuilt = m_decoder.buildKeyframeIndex();
+            }
+            m_decoder.setDecodeQuality(DecodeQuality::KeyframesOnly);
+            m_position = position;
+            m_shownKeyframe = AV_NOPTS_VALUE;
+            break;
+        case Mode::Reverse:
+            // Kept across mode changes: its decoder and index are reused on every J press
+            if (!m_reverse) {
+                m_reverse = std::make_unique<ReversePlayback>(m_decoder.getFilePath());
+            }
+            m_reverse->start(m_decoder.secondsToPts(position), m_decoder.keyframeIndex());
+            break;
+    }
+    m_mode = mode;
+    discontinuity();
+}
+
+void TrickPlay::discontinuity() {
+    if (m_onDiscontinuity) {
+        m_onDiscontinuity();
+    }
+}
+
+bool TrickPlay::nextFrame(double& displaySeconds) {
+    switch (m_mode) {
+        case Mode::Forward:   return nextDecodedFrame(displaySeconds);
+        case Mode::Keyframes: return nextKeyframe(displaySeconds);
+        case Mode::Reverse:   return nextReverseFrame(displaySeconds);
+    }
+    return false;
+}
+
+bool TrickPlay::isCatchingUp() const {
+    return m_mode == Mode::Reverse && m_reverse && !m_reverse->finished();
+}
+
+AVFrame* TrickPlay::displayFrame() {
+    if (m_mode != Mode::Reverse) {
+        return m_decoder.getVideoFrame();
+    }
+    if (!m_reverseDisplay && m_reverseFrame->data[0]) {
+        m_reverseDisplay = m_decoder.convertFrame(m_reverseFrame);
+    }
+    return m_reverseDisplay;
+}
+
+void TrickPlay::setLoop(int64_t start, int64_t end) {
+    if (start == AV_NOPTS_VALUE || end == AV_NOPTS_VALUE || end <= start) {
+        return;
+    }
+    m_loopStart = start;
+    m_loopEnd = end;
+}
+
+void TrickPlay::clearLoop() {
+    m_loopStart = AV_NOPTS_VALUE;
+    m_loopEnd = AV_NOPTS_VALUE;
+}
+
+bool TrickPlay::step(int direction) {
+    if (m_mode != Mode::Forward || m_rate != 1.0) {
+        // Reverse and keyframe playback leave the main decoder elsewhere; step from the
+        // frame on screen, which entering forward mode forgets
+        int64_t shown = m_lastPts;
+        bool resync = m_mode != Mode::Forward;
+        setRate(1.0);
+        if (resync && shown != AV_NOPTS_VALUE) {
+            if (!m_decoder.showFrameAt(shown)) {
+                return false;
+            }
+            m_lastPts = shown;
+        }
+    }
+    discontinuity();
+    bool ok = direction > 0 ? m_decoder.stepForward() : m_decoder.stepBackward();
+    if (ok) {
+        m_lastPts = m_decoder.getVideoPts();
+    }
+    return ok;
+}
+
+bool TrickPlay::nextDecodedFrame(double& displaySeconds) {
+    bool ok = m_decoder.stepForward();
+    if (hasLoop() && (!ok || m_decoder.getVideoPts() >= m_loopEnd)) {
+        TraceScope trace("loop_restart", m_loopStart);
+        // Before the seek, which goes on to decode audio from the loop start; what the
+        // decoder demuxes ahead of the start on the way there is trimmed, not played
+        discontinuity();
+        ok = m_decoder.showFrameAt(m_loopStart);
+        // The jump back isn't a frame gap to wait for
+        m_lastPts = AV_NOPTS_VALUE;
+    }
+    if (!ok) {
+        return false;
+    }
+    AVRational frameRate = m_decoder.getFrameRate();
+    double duration = frameRate.num > 0 ? av_q2d(av_inv_q(frameRate)) : 1.0 / 30.0;
+    // Pace by timestamp gaps where they're known; degraded decoding and VFR both skip frames
+    int64_t pts = m_decoder.getVideoPts();
+    if (m_lastPts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts > m_lastPts) {
+        duration = m_decoder.ptsToSeconds(pts) - m_decoder.ptsToSeconds(m_lastPts);
+    }
+    m_lastPts = pts;
+    displaySeconds = duration / m_rate;
+    return true;
+}
+
+bool TrickPlay::nextReverseFrame(double& displaySeconds) {
+    if (!m_reverse || !m_reverse->nextFrame(m_reverseFrame)) {
+        return false;
+    }
+    m_reverseDisplay = nullptr;
+
+    AVRational frameRate = m_decoder.getFrameRate();
+    double duration = frameRate.num > 0 ? av_q2d(av_inv_q(frameRate)) : 1.0 / 30.0;
+    int64_t pts = m_reverseFrame->best_effort_timestamp;
+    if (m_lastPts != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts < m_lastPts) {
+        duration = m_decoder.ptsToSeconds(m_lastPts) - m_decoder.ptsToSeconds(pts);
+    }
+    m_lastPts = pts;
+    displaySeconds = duration / std::fabs(m_rate);
+    return true;
+}
+
+bool TrickPlay::nextKeyframe(double& displaySeconds) {
+    const double tick = 1.0 / KEYFRAME_DISPLAY_FPS;
+    const double duration = m_decoder.getDuration();
+    displaySeconds = tick;
+
+    m_position += m_rate * tick;
+    if (m_position < 0.0 || (duration > 0.0 && m_position > duration)) {
+        // Park at the end so turning around starts from there
+        m_position = std::clamp(m_position, 0.0, std::max(duration, 0.0));
+        return false;
+    }
+
+    if (!m_decoder.hasKeyframeIndex()) {
+        // No index: let the demuxer find the keyframe, then check whether it is a new one
+        if (!m_decoder.seek(m_position, false) || !m_decoder.decodeFrame()) {
+            return false;
+        }
+        int64_t pts = m_decoder.getVideoPts();
+        if (pts == m_lastPts) {
+            Profiler::instance().increment(Counter::FramesDuplicated);
+        }
+        m_lastPts = pts;
+        return true;
+    }
+
+    int64_t keyframe = m_decoder.keyframeAtOrBefore(m_decoder.secondsToPts(m_position));
+    if (keyframe == AV_NOPTS_VALUE) {
+        return false;
+    }
+    if (keyframe == m_shownKeyframe) {
+        // Still the keyframe on screen; show it for another tick instead of decoding it again
+        Profiler::instance().increment(Counter::FramesDuplicated);
+        return true;
+    }
+
+    TraceScope trace("trick_play_keyframe", keyframe);
+    bool sequential = m_rate > 0.0 && m_shownKeyframe != AV_NOPTS_VALUE &&
+                      keyframe == m_decoder.keyframeAfter(m_shownKeyframe);
+    if (!sequential && !m_decoder.seek(m_decoder.ptsToSeconds(keyframe), false)) {
+        return false;
+    }
+    if (!m_decoder.decodeFrame()) {
+        return false;
+    }
+    m_lastPts = m_decoder.getVideoPts();
+    m_shownKeyframe = keyframe;
+    return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+extern "C" {
+    #include <libavutil/frame.h>
+}
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "reverse_playback.hpp"
+
+class MPDecoder;
+
+
+// Playback rate control for fast-forward and rewind on top of MPDecoder.
+// Below KEYFRAME_RATE forward, every frame is decoded and shown for its duration divided
+// by the rate; the player's late-frame dropping thins them out. Slow reverse rates play
+// every frame backwards through ReversePlayback. From KEYFRAME_RATE up in either direction
+// only keyframes are decoded: a media position advances at the requested rate on a fixed
+// display clock, and each tick shows the keyframe at or before it, located through the
+// keyframe index. Consecutive keyframes are read on sequentially with non-key packets
+// discarded; anything else is a seek.
+class TrickPlay {
+public:
+    static constexpr double KEYFRAME_RATE = 4.0;
+    static constexpr double MAX_RATE = 32.0;
+    // Display clock in keyframe mode; frames are repeated until the next keyframe is due
+    static constexpr double KEYFRAME_DISPLAY_FPS = 12.0;
+
+    enum class Mode {
+        Forward,
+        Keyframes,
+        Reverse
+    };
+
+    enum class AudioMode {
+        Normal,
+        // Pitch-preserving speed-up is bearable up to 2x
+        TimeStretch,
+        Mute
+    };
+
+    explicit TrickPlay(MPDecoder& decoder);
+    ~TrickPlay();
+    TrickPlay (const TrickPlay &) =delete;
+    TrickPlay& operator=(const TrickPlay &) =delete;
+
+    // Multiple of real time, negative for reverse. Clamped to MAX_RATE; 0 is ignored.
+    void setRate(double rate);
+    double rate() const { return m_rate; }
+    // J/K/L shuttle: faster() moves the rate one step towards fast forward
+    // (..., -2, -1, 1, 2, 4, ...), slower() one step towards fast rewind, normal() returns to 1x
+    void faster();
+    void slower();
+    void normal() { setRate(1.0); }
+    Mode mode() const { return m_mode; }
+    AudioMode audioMode() const;
+
+    // Advances to the next frame to show and returns how long to show it. False when
+    // there is nothing to show: at either end of the file, or while reverse decoding
+    // hasn't caught up yet.
+    bool nextFrame(double& displaySeconds);
+    // The frame nextFrame() advanced to, converted for display
+    AVFrame* displayFrame();
+    int64_t displayPts() const { return m_lastPts; }
+    // Reverse decoding hasn't produced the next frame yet, but will
+    bool isCatchingUp() const;
+
+    // Single frame steps, e.g. while paused. Switches back to 1x forward first.
+    bool step(int direction);
+    // Forward playback jumps back to `start` whenever it reaches `end` (video stream PTS).
+    // Short loops replay out of the decoder's frame cache. Audio only comes with passes
+    // that are actually decoded, so passes served from the cache are silent.
+    void setLoop(int64_t start, int64_t end);
+    void clearLoop();
+    bool hasLoop() const { return m_loopEnd != AV_NOPTS_VALUE; }
+    // Called whenever playback jumps instead of running on: a mode change, a step or a
+    // loop restart. Anything queued from before the jump, e.g. audio, is stale by then.
+    void setDiscontinuityHandler(std::function<void()> handler) { m_onDiscontinuity = std::move(handler); }
+
+private:
+    static Mode modeForRate(double rate);
+    bool nextDecodedFrame(double& displaySeconds);
+    bool nextKeyframe(double& displaySeconds);
+    bool nextReverseFrame(double& displaySeconds);
+    void enterMode(Mode mode);
+    void discontinuity();
+
+    MPDecoder& m_decoder;
+    double m_rate;
+    Mode m_mode;
+    bool m_indexBuilt;
+    // Keyframe mode: media position in seconds the display clock has reached
+    double m_position;
+    // PTS of the frame on screen
+    int64_t m_lastPts;
+    // Index entry of the keyframe currently in the decoder
+    int64_t m_shownKeyframe;
+    std::unique_ptr<ReversePlayback> m_reverse;
+    // Reverse mode: the frame on screen, still in the decoder's pixel format
+    AVFrame* m_reverseFrame;
+    AVFrame* m_reverseDisplay;
+    int64_t m_loopStart;
+    int64_t m_loopEnd;
+    std::function<void()> m_onDiscontinuity;
+};
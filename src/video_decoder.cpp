@@ -1,13 +1,55 @@
 #include "video_decoder.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 
+namespace {
+
+void releaseCountedBuffer(void* opaque, uint8_t*) {
+    AVBufferRef* original = static_cast<AVBufferRef*>(opaque);
+    Profiler::instance().addGauge(Gauge::DecoderBuffers, -1);
+    Profiler::instance().addGauge(Gauge::DecoderBufferBytes, -static_cast<int64_t>(original->size));
+    av_buffer_unref(&original);
+}
+
+// Wraps the default allocator so every frame buffer handed out by the codec's pool is
+// counted until its last reference goes away. A count that doesn't return to zero after
+// close() means some frame reference leaked.
+int countingGetBuffer(AVCodecContext* context, AVFrame* frame, int flags) {
+    int ret = avcodec_default_get_buffer2(context, frame, flags);
+    if (ret < 0) {
+        return ret;
+    }
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++) {
+        AVBufferRef* original = frame->buf[i];
+        AVBufferRef* counted = av_buffer_create(original->data, original->size, releaseCountedBuffer, original, 0);
+        if (!counted) {
+            return AVERROR(ENOMEM);
+        }
+        frame->buf[i] = counted;
+        Profiler::instance().addGauge(Gauge::DecoderBuffers, 1);
+        Profiler::instance().addGauge(Gauge::DecoderBufferBytes, static_cast<int64_t>(original->size));
+    }
+    return 0;
+}
+
+} // namespace
+
 MPDecoder::MPDecoder()
     : m_formatContext(nullptr), m_videoCodecContext(nullptr), m_audioCodecContext(nullptr),
       m_videoFrame(nullptr), m_audioFrame(nullptr), m_packet(nullptr),
       m_videoStreamIndex(-1), m_audioStreamIndex(-1),
-      m_swsContext(nullptr), m_swrContext(nullptr),
-      m_rgbFrame(nullptr), m_videoBuffer(nullptr), m_audioBuffer(nullptr) {
+      m_swsContext(nullptr),
+      m_rgbFrame(nullptr), m_videoBuffer(nullptr),
+      m_lastBytesRead(0), m_converted(false), m_displayFrame(nullptr), m_draining(false),
+      m_seekTarget(AV_NOPTS_VALUE), m_audioSeekSeconds(std::nan("")), m_pendingDecodeNs(0), m_quality(DecodeQuality::Full),
+      m_awaitKeyframe(false), m_resendPacket(false),
+      m_lastDecodedPts(AV_NOPTS_VALUE) {
 }
 
 MPDecoder::~MPDecoder() {
@@ -15,6 +57,17 @@ MPDecoder::~MPDecoder() {
 }
 
 bool MPDecoder::open(const std::string& filePath) {
+    // Reopening is allowed; a failed open leaves the decoder closed rather than half set up
+    close();
+    if (!openStreams(filePath)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MPDecoder::openStreams(const std::string& filePath) {
+    m_filePath = filePath;
     // Open the input file
     if (avformat_open_input(&m_formatContext, filePath.c_str(), nullptr, nullptr) != 0) {
         std::cerr << "Couldn't open file." << std::endl;
@@ -53,6 +106,7 @@ bool MPDecoder::open(const std::string& filePath) {
 
         m_videoCodecContext = avcodec_alloc_context3(videoCodec);
         avcodec_parameters_to_context(m_videoCodecContext, videoCodecParameters);
+        m_videoCodecContext->get_buffer2 = countingGetBuffer;
 
         if (avcodec_open2(m_videoCodecContext, videoCodec, nullptr) < 0) {
             std::cerr << "Couldn't open video codec." << std::endl;
@@ -63,96 +117,532 @@ bool MPDecoder::open(const std::string& filePath) {
         initSWSContext();
     }
 
-    // Initialize audio codec context
-    if (m_audioStreamIndex != -1) {
-        AVCodecParameters* audioCodecParameters = m_formatContext->streams[m_audioStreamIndex]->codecpar;
-        const AVCodec* audioCodec = avcodec_find_decoder(audioCodecParameters->codec_id);
-        if (!audioCodec) {
-            std::cerr << "Unsupported audio codec." << std::endl;
+    // Initialize audio codec context. A track that can't be decoded or converted only
+    // costs the sound; the video still plays.
+    if (m_audioStreamIndex != -1 && !openAudio()) {
+        disableAudio();
+        if (m_videoStreamIndex == -1) {
             return false;
         }
+        std::cerr << "Playing without audio." << std::endl;
+    }
+
+    m_packet = av_packet_alloc();
+    return true;
+}
 
-        m_audioCodecContext = avcodec_alloc_context3(audioCodec);
-        avcodec_parameters_to_context(m_audioCodecContext, audioCodecParameters);
+bool MPDecoder::openAudio() {
+    AVCodecParameters* audioCodecParameters = m_formatContext->streams[m_audioStreamIndex]->codecpar;
+    const AVCodec* audioCodec = avcodec_find_decoder(audioCodecParameters->codec_id);
+    if (!audioCodec) {
+        std::cerr << "Unsupported audio codec." << std::endl;
+        return false;
+    }
 
-        if (avcodec_open2(m_audioCodecContext, audioCodec, nullptr) < 0) {
-            std::cerr << "Couldn't open audio codec." << std::endl;
-            return false;
-        }
+    m_audioCodecContext = avcodec_alloc_context3(audioCodec);
+    avcodec_parameters_to_context(m_audioCodecContext, audioCodecParameters);
 
-        m_audioFrame = av_frame_alloc();
-        initSWRContext();
+    if (avcodec_open2(m_audioCodecContext, audioCodec, nullptr) < 0) {
+        std::cerr << "Couldn't open audio codec." << std::endl;
+        return false;
     }
 
-    m_packet = av_packet_alloc();
-    return true;
+    m_audioFrame = av_frame_alloc();
+    return setAudioOutput(m_audioCodecContext->ch_layout.nb_channels, m_audioCodecContext->sample_rate);
+}
+
+void MPDecoder::disableAudio() {
+    m_audioConverter.close();
+    av_frame_free(&m_audioFrame);
+    avcodec_free_context(&m_audioCodecContext);
+    m_audioStreamIndex = -1;
 }
 
 void MPDecoder::close() {
-    if (m_swsContext) sws_freeContext(m_swsContext);
-    if (m_swrContext) swr_free(&m_swrContext);
-    if (m_rgbFrame) av_frame_free(&m_rgbFrame);
-    if (m_videoBuffer) av_free(m_videoBuffer);
-    if (m_audioBuffer) av_free(m_audioBuffer);
-    if (m_videoFrame) av_frame_free(&m_videoFrame);
-    if (m_audioFrame) av_frame_free(&m_audioFrame);
-    if (m_videoCodecContext) avcodec_free_context(&m_videoCodecContext);
-    if (m_audioCodecContext) avcodec_free_context(&m_audioCodecContext);
-    if (m_formatContext) avformat_close_input(&m_formatContext);
-    if (m_packet) av_packet_free(&m_packet);
+    // Every free below nulls its pointer, so close() is idempotent and open() can follow it
+    sws_freeContext(m_swsContext);
+    m_swsContext = nullptr;
+    av_frame_free(&m_rgbFrame);
+    av_freep(&m_videoBuffer);
+    m_audioConverter.close();
+    av_frame_free(&m_videoFrame);
+    av_frame_free(&m_audioFrame);
+    avcodec_free_context(&m_videoCodecContext);
+    avcodec_free_context(&m_audioCodecContext);
+    avformat_close_input(&m_formatContext);
+    av_packet_free(&m_packet);
+
+    m_videoStreamIndex = -1;
+    m_audioStreamIndex = -1;
+    m_lastBytesRead = 0;
+    m_converted = false;
+    m_displayFrame = nullptr;
+    m_draining = false;
+    m_seekTarget = AV_NOPTS_VALUE;
+    m_audioSeekSeconds = std::nan("");
+    m_pendingDecodeNs = 0;
+    m_keyframes.clear();
+    m_quality = DecodeQuality::Full;
+    m_awaitKeyframe = false;
+    m_resendPacket = false;
+    m_lastDecodedPts = AV_NOPTS_VALUE;
+    if (m_frameCache) {
+        m_frameCache->clear();
+    }
 }
 
 bool MPDecoder::decodeFrame() {
-    while (av_read_frame(m_formatContext, m_packet) >= 0) 
+    if (!m_videoCodecContext) {
+        return false;
+    }
+    while (true)
     {
-        if (m_packet->stream_index == m_videoStreamIndex)
+        // Frames already buffered in the decoder (B-frame reordering, threads) come first
+        int ret;
+        {
+            auto start = std::chrono::steady_clock::now();
+            ret = avcodec_receive_frame(m_videoCodecContext, m_videoFrame);
+            m_pendingDecodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (ret == 0)
         {
-            if (avcodec_send_packet(m_videoCodecContext, m_packet) == 0)
-            {
-                int ret = avcodec_receive_frame(m_videoCodecContext, m_videoFrame);
-                if (ret == 0)
-                {
-                    sws_scale(
-                        m_swsContext,
-                        m_videoFrame->data,
-                        m_videoFrame->linesize,
-                        0,
-                        m_videoCodecContext->height,
-                        m_rgbFrame->data,
-                        m_rgbFrame->linesize
-                    );
-                    av_packet_unref(m_packet);
-                    return true;
+            Profiler::instance().record(Stage::Decode, m_pendingDecodeNs);
+            Profiler::instance().increment(Counter::FramesDecoded);
+            m_pendingDecodeNs = 0;
+
+            // Degraded frames aren't the real picture and may have gaps between them
+            int64_t pts = m_videoFrame->best_effort_timestamp;
+            if (m_frameCache && m_quality == DecodeQuality::Full && pts != AV_NOPTS_VALUE) {
+                m_frameCache->insert(m_videoFrame);
+                if (m_lastDecodedPts != AV_NOPTS_VALUE) {
+                    m_frameCache->link(m_lastDecodedPts, pts);
                 }
             }
+            m_lastDecodedPts = pts;
+
+            // After an accurate seek, frames before the target are decoded but never shown
+            if (m_seekTarget != AV_NOPTS_VALUE && pts != AV_NOPTS_VALUE && pts < m_seekTarget) {
+                continue;
+            }
+            m_seekTarget = AV_NOPTS_VALUE;
+            m_converted = false;
+            return true;
+        }
+
+        if (ret == AVERROR_EOF || (m_draining && ret != AVERROR(EAGAIN))) {
+            // Everything the codec held has come out
+            return false;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            // A frame that failed to decode is skipped, like a rejected packet
+            char error[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, error, sizeof(error));
+            std::cerr << "Skipping a video frame that failed to decode: " << error << std::endl;
         }
-        //  else if (m_packet->stream_index == m_audioStreamIndex) {
-        //     if (avcodec_send_packet(m_audioCodecContext, m_packet) == 0) {
-        //         if (avcodec_receive_frame(m_audioCodecContext, m_audioFrame) == 0) {
-        //             av_packet_unref(m_packet);
-        //             return true;
-        //         }
-        //     }
-        // }
+
+        if (!sendNextVideoPacket()) {
+            if (m_draining) {
+                return false;
+            }
+            // End of file: flush out the frames the decoder still holds
+            if (avcodec_send_packet(m_videoCodecContext, nullptr) < 0) {
+                return false;
+            }
+            m_draining = true;
+        }
+    }
+}
+
+bool MPDecoder::sendNextVideoPacket() {
+    if (m_resendPacket) {
+        m_resendPacket = false;
+        if (sendVideoPacket()) {
+            return true;
+        }
+    }
+    while (true)
+    {
+        int readResult;
+        {
+            ScopedStageTimer timer(Stage::Demux);
+            TraceScope trace("demux");
+            readResult = av_read_frame(m_formatContext, m_packet);
+        }
+        if (m_formatContext->pb) {
+            int64_t bytesRead = m_formatContext->pb->bytes_read;
+            Profiler::instance().increment(Counter::IoBytesRead, bytesRead - m_lastBytesRead);
+            m_lastBytesRead = bytesRead;
+        }
+        if (readResult < 0) {
+            return false;
+        }
+
+        // Keyframes-only playback doesn't even hand the rest to the decoder
+        if (m_packet->stream_index == m_videoStreamIndex &&
+            (m_quality == DecodeQuality::KeyframesOnly || m_awaitKeyframe)) {
+            if (!(m_packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(m_packet);
+                continue;
+            }
+            m_awaitKeyframe = false;
+        }
+
+        if (m_packet->stream_index == m_videoStreamIndex)
+        {
+            if (sendVideoPacket()) {
+                return true;
+            }
+            continue;
+        }
+        if (m_packet->stream_index == m_audioStreamIndex && m_audioSink) {
+            decodeAudioPacket();
+        }
+        av_packet_unref(m_packet);
+    }
+}
+
+bool MPDecoder::sendVideoPacket() {
+    int ret;
+    auto start = std::chrono::steady_clock::now();
+    {
+        TraceScope trace("decode", m_packet->pts);
+        ret = avcodec_send_packet(m_videoCodecContext, m_packet);
+    }
+    m_pendingDecodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (ret == AVERROR(EAGAIN)) {
+        // The decoder wants its output taken first; keep the packet for the next call
+        m_resendPacket = true;
+        return true;
+    }
+    if (ret < 0) {
+        char error[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, error, sizeof(error));
+        std::cerr << "Skipping a video packet the decoder rejected: " << error << std::endl;
+    }
+    av_packet_unref(m_packet);
+    return ret >= 0;
+}
+
+void MPDecoder::decodeAudioPacket() {
+    TraceScope trace("audio_decode", m_packet->pts);
+    if (avcodec_send_packet(m_audioCodecContext, m_packet) < 0) {
+        return;
+    }
+    while (avcodec_receive_frame(m_audioCodecContext, m_audioFrame) == 0) {
+        const float* const* planes = nullptr;
+        int frames = m_audioConverter.convert(m_audioFrame, planes);
+        if (frames > 0) {
+            deliverAudio(planes, frames);
+        }
+    }
+}
+
+void MPDecoder::deliverAudio(const float* const* planes, int frames) {
+    if (std::isnan(m_audioSeekSeconds)) {
+        m_audioSink(planes, frames);
+        return;
+    }
+    // The audio from the keyframe up to the target goes with video frames that are never shown
+    double end = getAudioFrameEndSeconds();
+    int skip = 0;
+    if (!std::isnan(end)) {
+        double start = end - frames / static_cast<double>(m_audioConverter.outputRate());
+        skip = static_cast<int>(std::lround((m_audioSeekSeconds - start) * m_audioConverter.outputRate()));
+        if (skip >= frames) {
+            return;
+        }
+    }
+    m_audioSeekSeconds = std::nan("");
+    if (skip <= 0) {
+        m_audioSink(planes, frames);
+        return;
+    }
+    m_trimmedPlanes.resize(m_audioConverter.outputChannels());
+    for (size_t channel = 0; channel < m_trimmedPlanes.size(); channel++) {
+        m_trimmedPlanes[channel] = planes[channel] + skip;
+    }
+    m_audioSink(m_trimmedPlanes.data(), frames - skip);
+}
+
+bool MPDecoder::setAudioOutput(int channels, int sampleRate) {
+    if (!m_audioCodecContext) {
+        return false;
+    }
+    return m_audioConverter.configure(m_audioCodecContext->ch_layout, m_audioCodecContext->sample_fmt,
+                                      m_audioCodecContext->sample_rate, channels, sampleRate);
+}
+
+void MPDecoder::setDecodeQuality(DecodeQuality quality) {
+    if (m_quality == DecodeQuality::KeyframesOnly && quality != DecodeQuality::KeyframesOnly) {
+        m_awaitKeyframe = true;
+    }
+    m_quality = quality;
+    if (!m_videoCodecContext) {
+        return;
+    }
+    // Not every decoder honours every option; the ones that don't simply ignore them
+    m_videoCodecContext->skip_loop_filter = quality >= DecodeQuality::SkipLoopFilter ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    m_videoCodecContext->skip_idct = quality >= DecodeQuality::SkipIdct ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    m_videoCodecContext->skip_frame = quality >= DecodeQuality::KeyframesOnly ? AVDISCARD_NONKEY
+                                    : quality >= DecodeQuality::SkipNonRef ? AVDISCARD_NONREF
+                                    : AVDISCARD_DEFAULT;
+}
+
+bool MPDecoder::seek(double seconds, bool accurate) {
+    if (m_videoStreamIndex == -1) {
+        return false;
+    }
+    return seekToPts(secondsToPts(seconds), accurate);
+}
+
+bool MPDecoder::seekToPts(int64_t target, bool accurate) {
+    TraceScope trace("seek");
+
+    // With an index we know the exact keyframe to land on and the demuxer needn't search
+    int64_t seekTimestamp = target;
+    int64_t keyframe = keyframeAtOrBefore(target);
+    if (keyframe != AV_NOPTS_VALUE) {
+        seekTimestamp = keyframe;
+    }
+
+    if (av_seek_frame(m_formatContext, m_videoStreamIndex, seekTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "Seek to " << ptsToSeconds(target) << "s failed." << std::endl;
+        return false;
+    }
+    avcodec_flush_buffers(m_videoCodecContext);
+    if (m_audioCodecContext) {
+        avcodec_flush_buffers(m_audioCodecContext);
+        m_audioConverter.flush();
+    }
+    m_draining = false;
+    m_pendingDecodeNs = 0;
+    m_seekTarget = accurate ? target : AV_NOPTS_VALUE;
+    m_audioSeekSeconds = accurate ? target * av_q2d(getVideoTimeBase()) : std::nan("");
+    m_lastDecodedPts = AV_NOPTS_VALUE;
+    // Seeks land on a keyframe
+    m_awaitKeyframe = false;
+    if (m_resendPacket) {
         av_packet_unref(m_packet);
+        m_resendPacket = false;
+    }
+    return true;
+}
+
+void MPDecoder::setFrameCacheBudget(size_t bytes) {
+    // Without the cache the next frame comes straight from the codec, which may still be
+    // wherever stepping left it; put it back on the frame that is shown
+    int64_t current = m_videoFrame ? m_videoFrame->best_effort_timestamp : AV_NOPTS_VALUE;
+    if (bytes == 0 && m_frameCache && current != AV_NOPTS_VALUE && m_videoFrame->data[0] &&
+        m_lastDecodedPts != current) {
+        if (!seekToPts(current, true) || !decodeFrame()) {
+            std::cerr << "Couldn't return to the frame at " << ptsToSeconds(current) << "s." << std::endl;
+        }
+    }
+    m_frameCache = bytes > 0 ? std::make_unique<FrameCache>(bytes) : nullptr;
+}
+
+void MPDecoder::showCachedFrame(const AVFrame* frame) {
+    av_frame_unref(m_videoFrame);
+    av_frame_ref(m_videoFrame, frame);
+    m_converted = false;
+}
+
+bool MPDecoder::stepForward() {
+    int64_t current = m_videoFrame ? m_videoFrame->best_effort_timestamp : AV_NOPTS_VALUE;
+    // Plain sequential playback: the codec's next frame is the one we want
+    if (!m_frameCache || current == AV_NOPTS_VALUE || !m_videoFrame->data[0] || m_lastDecodedPts == current) {
+        return decodeFrame();
+    }
+
+    if (const AVFrame* cached = m_frameCache->findNext(current)) {
+        showCachedFrame(cached);
+        return true;
+    }
+
+    // We've stepped around in the cache, so the codec has to be put back on the current frame first
+    if (!seekToPts(current, true) || !decodeFrame()) {
+        return false;
+    }
+    return decodeFrame();
+}
+
+bool MPDecoder::stepBackward() {
+    int64_t current = m_videoFrame ? m_videoFrame->best_effort_timestamp : AV_NOPTS_VALUE;
+    if (current == AV_NOPTS_VALUE) {
+        return false;
+    }
+
+    if (m_frameCache) {
+        if (const AVFrame* cached = m_frameCache->findPrevious(current)) {
+            showCachedFrame(cached);
+            return true;
+        }
+    }
+
+    // Decode from the keyframe before the current frame up to it; everything decoded on the
+    // way lands in the cache, so the following steps back are hits
+    TraceScope trace("step_back_decode", current);
+    if (!seekToPts(current - 1, false)) {
+        return false;
     }
-    return false;
+    int64_t previous = AV_NOPTS_VALUE;
+    AVFrame* previousFrame = av_frame_alloc();
+    bool found = false;
+    while (decodeFrame()) {
+        int64_t pts = m_videoFrame->best_effort_timestamp;
+        if (pts >= current) {
+            found = previous != AV_NOPTS_VALUE;
+            break;
+        }
+        previous = pts;
+        av_frame_unref(previousFrame);
+        av_frame_ref(previousFrame, m_videoFrame);
+    }
+    // The codec is left after `current`, which the cache link back to it accounts for
+    if (found) {
+        showCachedFrame(previousFrame);
+    }
+    av_frame_free(&previousFrame);
+    return found;
+}
+
+bool MPDecoder::showFrameAt(int64_t pts) {
+    if (m_frameCache) {
+        if (const AVFrame* cached = m_frameCache->find(pts)) {
+            showCachedFrame(cached);
+            return true;
+        }
+    }
+    return seekToPts(pts, true) && decodeFrame();
 }
 
-AVFrame* MPDecoder::getVideoFrame() const{
+bool MPDecoder::buildKeyframeIndex() {
+    if (m_videoStreamIndex == -1) {
+        return false;
+    }
+
+    // Scan on a separate demuxer so the playback position is left alone
+    AVFormatContext* scanContext = nullptr;
+    if (avformat_open_input(&scanContext, m_filePath.c_str(), nullptr, nullptr) != 0) {
+        return false;
+    }
+    if (avformat_find_stream_info(scanContext, nullptr) < 0) {
+        avformat_close_input(&scanContext);
+        return false;
+    }
+    for (unsigned int i = 0; i < scanContext->nb_streams; i++) {
+        if (static_cast<int>(i) != m_videoStreamIndex) {
+            scanContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    std::vector<int64_t> keyframes;
+    AVPacket* packet = av_packet_alloc();
+    while (av_read_frame(scanContext, packet) >= 0) {
+        if (packet->stream_index == m_videoStreamIndex && (packet->flags & AV_PKT_FLAG_KEY)) {
+            keyframes.push_back(packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&scanContext);
+
+    std::sort(keyframes.begin(), keyframes.end());
+    m_keyframes = std::move(keyframes);
+    return !m_keyframes.empty();
+}
+
+int64_t MPDecoder::keyframeAtOrBefore(int64_t pts) const {
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), pts);
+    if (it == m_keyframes.begin()) {
+        return AV_NOPTS_VALUE;
+    }
+    return *(it - 1);
+}
+
+int64_t MPDecoder::keyframeAfter(int64_t pts) const {
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), pts);
+    return it == m_keyframes.end() ? AV_NOPTS_VALUE : *it;
+}
+
+int64_t MPDecoder::secondsToPts(double seconds) const {
+    AVStream* stream = m_formatContext->streams[m_videoStreamIndex];
+    int64_t pts = av_rescale_q(static_cast<int64_t>(seconds * AV_TIME_BASE), AV_TIME_BASE_Q, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        pts += stream->start_time;
+    }
+    return pts;
+}
+
+double MPDecoder::ptsToSeconds(int64_t pts) const {
+    AVStream* stream = m_formatContext->streams[m_videoStreamIndex];
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        pts -= stream->start_time;
+    }
+    return pts * av_q2d(stream->time_base);
+}
+
+AVFrame* MPDecoder::getVideoFrame() {
+    if (!m_videoFrame || !m_videoFrame->data[0]) {
+        return nullptr;
+    }
+    if (!m_converted) {
+        m_displayFrame = convertFrame(m_videoFrame);
+        m_converted = true;
+    }
+    return m_displayFrame;
+}
+
+AVFrame* MPDecoder::convertFrame(AVFrame* frame) {
+    // The renderer uploads tightly packed RGB24, so such frames need no conversion at all
+    if (frame->format == AV_PIX_FMT_RGB24 && frame->linesize[0] == frame->width * 3) {
+        return frame;
+    }
+
+    ScopedStageTimer timer(Stage::Convert);
+    TraceScope trace("convert", frame->best_effort_timestamp);
+    sws_scale(
+        m_swsContext,
+        frame->data,
+        frame->linesize,
+        0,
+        m_videoCodecContext->height,
+        m_rgbFrame->data,
+        m_rgbFrame->linesize
+    );
     return m_rgbFrame;
 }
 
+int64_t MPDecoder::getVideoPts() const {
+    return m_videoFrame->best_effort_timestamp;
+}
+
 AVFrame* MPDecoder::getAudioFrame() const {
     return m_audioFrame;
 }
 
+double MPDecoder::getAudioFrameEndSeconds() const {
+    if (!m_audioFrame || m_audioFrame->best_effort_timestamp == AV_NOPTS_VALUE || m_audioFrame->sample_rate <= 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    AVRational timeBase = m_formatContext->streams[m_audioStreamIndex]->time_base;
+    return m_audioFrame->best_effort_timestamp * av_q2d(timeBase) +
+           m_audioFrame->nb_samples / static_cast<double>(m_audioFrame->sample_rate);
+}
+
 int MPDecoder::getVideoWidth() const {
-    return m_videoCodecContext->width;
+    return m_videoCodecContext ? m_videoCodecContext->width : 0;
 }
 
 int MPDecoder::getVideoHeight() const {
-    return m_videoCodecContext->height;
+    return m_videoCodecContext ? m_videoCodecContext->height : 0;
+}
+
+AVPixelFormat MPDecoder::getVideoPixelFormat() const {
+    return m_videoCodecContext ? m_videoCodecContext->pix_fmt : AV_PIX_FMT_NONE;
 }
 
 int MPDecoder::getAudioSampleRate() const {
@@ -168,9 +658,30 @@ AVSampleFormat MPDecoder::getAudioFormat() const {
 }
 
 AVRational MPDecoder::getFrameRate() const {
+    if (m_videoStreamIndex == -1) {
+        return AVRational{0, 1};
+    }
     return m_formatContext->streams[m_videoStreamIndex]->avg_frame_rate;
 }
 
+double MPDecoder::getDuration() const {
+    if (m_formatContext->duration == AV_NOPTS_VALUE) {
+        return 0.0;
+    }
+    return m_formatContext->duration / static_cast<double>(AV_TIME_BASE);
+}
+
+AVRational MPDecoder::getVideoTimeBase() const {
+    if (m_videoStreamIndex == -1) {
+        return AVRational{0, 1};
+    }
+    return m_formatContext->streams[m_videoStreamIndex]->time_base;
+}
+
+const char* MPDecoder::getVideoCodecName() const {
+    return m_videoCodecContext ? avcodec_get_name(m_videoCodecContext->codec_id) : "none";
+}
+
 void MPDecoder::initSWSContext() {
     m_swsContext = sws_getContext(
         m_videoCodecContext->width, m_videoCodecContext->height, m_videoCodecContext->pix_fmt,
@@ -182,19 +693,3 @@ void MPDecoder::initSWSContext() {
     m_videoBuffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
     av_image_fill_arrays(m_rgbFrame->data, m_rgbFrame->linesize, m_videoBuffer, AV_PIX_FMT_RGB24, m_videoCodecContext->width, m_videoCodecContext->height, 1);
 }
-
-void MPDecoder::initSWRContext() {
-    m_swrContext = swr_alloc();
-    av_opt_set_chlayout(m_swrContext, "in_chlayout", &m_audioCodecContext->ch_layout, 0);
-    av_opt_set_int(m_swrContext, "in_sample_rate", m_audioCodecContext->sample_rate, 0);
-    av_opt_set_sample_fmt(m_swrContext, "in_sample_fmt", m_audioCodecContext->sample_fmt, 0);
-
-    AVChannelLayout out_chlayout = AV_CHANNEL_LAYOUT_STEREO; // Example: Stereo output
-    av_opt_set_chlayout(m_swrContext, "out_chlayout", &out_chlayout, 0);
-    av_opt_set_int(m_swrContext, "out_sample_rate", m_audioCodecContext->sample_rate, 0);
-    av_opt_set_sample_fmt(m_swrContext, "out_sample_fmt", AV_SAMPLE_FMT_S16, 0);
-
-    swr_init(m_swrContext);
-
-    m_audioBuffer = (uint8_t*)av_malloc(av_samples_get_buffer_size(nullptr, out_chlayout.nb_channels, m_audioCodecContext->frame_size, AV_SAMPLE_FMT_S16, 1));
-}
\ No newline at end of file
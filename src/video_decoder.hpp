@@ -4,34 +4,105 @@ extern "C" {
     #include <libavcodec/avcodec.h>
     #include <libavformat/avformat.h>
     #include <libswscale/swscale.h>
-    #include <libswresample/swresample.h>
     #include <libavutil/imgutils.h>
     #include <libavutil/channel_layout.h>
     #include <libavutil/opt.h>
 }
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+#include "audio_converter.hpp"
+#include "decode_quality.hpp"
+#include "frame_cache.hpp"
 
 
 class MPDecoder {
     
 public:
+    // Decoded audio as float planar at the output rate: one pointer per output channel
+    using AudioSink = std::function<void(const float* const* planes, int frames)>;
+
     MPDecoder();
     ~MPDecoder();
     MPDecoder (const MPDecoder &) =delete;
     MPDecoder (MPDecoder &&) =delete;
     MPDecoder& operator=(const MPDecoder &) =delete;
 
+    // May be called again on the same object, with or without close() in between
     bool open(const std::string& filePath);
     void close();
     bool decodeFrame();
-    AVFrame* getVideoFrame() const;
+    // The next decodeFrame() returns the first frame at or after `seconds`, or with
+    // accurate=false the keyframe before it
+    bool seek(double seconds, bool accurate = true);
+    // Scans the file once for keyframe timestamps so seeks land directly on the right keyframe
+    bool buildKeyframeIndex();
+    bool hasKeyframeIndex() const { return !m_keyframes.empty(); }
+    // The index, e.g. to hand to another decoder on the same file instead of scanning again
+    const std::vector<int64_t>& keyframeIndex() const { return m_keyframes; }
+    void setKeyframeIndex(std::vector<int64_t> keyframes) { m_keyframes = std::move(keyframes); }
+    // Keyframe PTS at or before `pts` (stream time base); AV_NOPTS_VALUE without an index
+    int64_t keyframeAtOrBefore(int64_t pts) const;
+    // First keyframe PTS after `pts`; AV_NOPTS_VALUE past the last one or without an index
+    int64_t keyframeAfter(int64_t pts) const;
+    // Conversions between video stream PTS and seconds from the start of the stream
+    int64_t secondsToPts(double seconds) const;
+    double ptsToSeconds(int64_t pts) const;
+    // Last decoded frame in a displayable format. Converted on the first call after each
+    // decodeFrame(), so frames that are never shown never pay for sws_scale.
+    AVFrame* getVideoFrame();
+    // Last video frame as it came out of the codec, before conversion
+    AVFrame* getDecodedFrame() const { return m_videoFrame; }
+    // Converts any frame from this decoder, e.g. one held in a FrameQueue, into the shared
+    // RGB frame. Frames that are already packed RGB24 are returned as they are.
+    AVFrame* convertFrame(AVFrame* frame);
+    // PTS of the last decoded video frame, in stream time base
+    int64_t getVideoPts() const;
     AVFrame* getAudioFrame() const;
+    // Inside the audio sink: container time just past the frame being delivered, in
+    // seconds, comparable with video PTS times the video time base. NaN without a timestamp.
+    double getAudioFrameEndSeconds() const;
     int getVideoWidth() const;
     int getVideoHeight() const;
+    // Pixel format the codec decodes to; AV_PIX_FMT_NONE without video
+    AVPixelFormat getVideoPixelFormat() const;
     int getAudioSampleRate() const;
     int getAudioChannels() const;
     AVSampleFormat getAudioFormat() const;
+    bool hasAudio() const { return m_audioCodecContext != nullptr; }
+    // Audio-only files have none: decodeFrame() returns false and the video size is 0x0
+    bool hasVideo() const { return m_videoCodecContext != nullptr; }
+    // Receives every audio frame, converted, as its packet is demuxed alongside the video.
+    // Without a sink audio packets are skipped undecoded.
+    void setAudioSink(AudioSink sink) { m_audioSink = std::move(sink); }
+    // Channel count and rate the sink receives: whatever the output device opened with, so
+    // the converter's pass is the only one. Defaults to the source's own.
+    bool setAudioOutput(int channels, int sampleRate);
+    const AudioConverter& getAudioConverter() const { return m_audioConverter; }
+    // Resamples audio by 1 - correction to follow a master clock; see DriftController
+    void setAudioCompensation(double correction) { m_audioConverter.setCompensation(correction); }
     AVRational getFrameRate() const;
+    // Container duration in seconds, 0 when unknown
+    double getDuration() const;
+    AVRational getVideoTimeBase() const;
+    const char* getVideoCodecName() const;
+    const std::string& getFilePath() const { return m_filePath; }
+    // Trades picture quality for decode speed; takes effect from the next packet
+    void setDecodeQuality(DecodeQuality quality);
+    DecodeQuality getDecodeQuality() const { return m_quality; }
+
+    // Keeps every full-quality decoded frame in a FrameCache so stepping and short loops
+    // are served without seeking or decoding again. 0 disables it; decoding then carries on
+    // from the frame shown, even if stepping had moved the codec elsewhere.
+    void setFrameCacheBudget(size_t bytes);
+    const FrameCache* getFrameCache() const { return m_frameCache.get(); }
+    // Frame-accurate navigation from the current frame. Each leaves the new frame in
+    // getDecodedFrame()/getVideoFrame() like decodeFrame() does, from the cache when possible.
+    bool stepForward();
+    bool stepBackward();
+    // Makes the first frame at or after `pts` current
+    bool showFrameAt(int64_t pts);
 
 private:
     AVFormatContext* m_formatContext;
@@ -43,12 +114,54 @@ private:
     int m_videoStreamIndex;
     int m_audioStreamIndex;
     SwsContext* m_swsContext;
-    SwrContext* m_swrContext;
     AVFrame* m_rgbFrame;
     uint8_t* m_videoBuffer;
-    uint8_t* m_audioBuffer;
+    AudioConverter m_audioConverter;
+    AudioSink m_audioSink;
+    // AVIOContext::bytes_read at the previous packet, for I/O accounting
+    int64_t m_lastBytesRead;
+    // Whether getVideoFrame() has already converted the current m_videoFrame
+    bool m_converted;
+    // What getVideoFrame() returns: m_rgbFrame, or m_videoFrame itself when already displayable
+    AVFrame* m_displayFrame;
+    std::string m_filePath;
+    // Set once end of file has been signalled to the video decoder
+    bool m_draining;
+    // Frames before this PTS are dropped after an accurate seek
+    int64_t m_seekTarget;
+    // The same target in container seconds for audio, which is trimmed up to it; NaN once
+    // audio has reached it. Kept apart from m_seekTarget because the two streams reach it
+    // at different points in the demux order.
+    double m_audioSeekSeconds;
+    // Channel pointers into a converted chunk whose start was trimmed
+    std::vector<const float*> m_trimmedPlanes;
+    // Send + receive time accumulated towards the next output frame
+    int64_t m_pendingDecodeNs;
+    std::vector<int64_t> m_keyframes;
+    DecodeQuality m_quality;
+    // Set when keyframes-only decoding ends mid-GOP: the frames up to the next keyframe
+    // reference pictures that were never decoded, so their packets are skipped too
+    bool m_awaitKeyframe;
+    // The codec refused m_packet with EAGAIN; it is sent again once output has been taken
+    bool m_resendPacket;
+    std::unique_ptr<FrameCache> m_frameCache;
+    // PTS of the last frame the codec produced; the next one it produces follows it.
+    // Reset by seeks, so cache links are only made between truly adjacent frames.
+    int64_t m_lastDecodedPts;
 
+    bool openStreams(const std::string& filePath);
+    bool openAudio();
+    // Frees the audio decoder and forgets the stream, as if the file had none
+    void disableAudio();
+    bool sendNextVideoPacket();
+    // Sends the video packet in m_packet; false if the decoder rejected it
+    bool sendVideoPacket();
+    void decodeAudioPacket();
+    // Hands a converted chunk to the sink, minus any part before an accurate seek's target
+    void deliverAudio(const float* const* planes, int frames);
+    bool seekToPts(int64_t target, bool accurate);
+    // Makes a cached frame the current one
+    void showCachedFrame(const AVFrame* frame);
     void initSWSContext();
-    void initSWRContext();
 };
 
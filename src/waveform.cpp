@@ -0,0 +1,290 @@
+#include "waveform.hpp"
+#include "audio_kernels.hpp"
+#include "media_cache.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'M', 'P', 'W', 'A', 'V', 'E', '0', '1'};
+
+// Work unit handed to one worker at a time: 4096 base buckets, about 22 s at 48 kHz
+constexpr int64_t CHUNK_BUCKETS = 4096;
+
+struct CacheHeader {
+    char magic[8];
+    int32_t sampleRate;
+    int32_t baseBucketSamples;
+    int64_t totalSamples;
+    int32_t levels;
+};
+
+WaveformBucket combine(const WaveformBucket& a, const WaveformBucket& b) {
+    WaveformBucket result;
+    result.min = std::min(a.min, b.min);
+    result.max = std::max(a.max, b.max);
+    result.rms = std::sqrt((a.rms * a.rms + b.rms * b.rms) * 0.5f);
+    return result;
+}
+
+}
+
+void WaveformPyramid::build(int sampleRate, int64_t totalSamples, std::vector<WaveformBucket> base) {
+    m_sampleRate = sampleRate;
+    m_totalSamples = totalSamples;
+    m_levels.clear();
+    if (base.empty()) {
+        return;
+    }
+    m_levels.push_back(std::move(base));
+    while (m_levels.back().size() > 1) {
+        const std::vector<WaveformBucket>& fine = m_levels.back();
+        std::vector<WaveformBucket> coarse((fine.size() + 1) / 2);
+        for (size_t i = 0; i < coarse.size(); i++) {
+            coarse[i] = 2 * i + 1 < fine.size() ? combine(fine[2 * i], fine[2 * i + 1]) : fine[2 * i];
+        }
+        m_levels.push_back(std::move(coarse));
+    }
+}
+
+void WaveformPyramid::query(double startSeconds, double endSeconds, int pixels,
+                            std::vector<WaveformBucket>& columns) const {
+    columns.assign(std::max(pixels, 0), WaveformBucket());
+    if (empty() || pixels <= 0 || endSeconds <= startSeconds) {
+        return;
+    }
+    const double samplesPerPixel = (endSeconds - startSeconds) * m_sampleRate / pixels;
+    int level = 0;
+    while (level + 1 < levelCount() &&
+           static_cast<double>(int64_t(BASE_BUCKET_SAMPLES) << (level + 1)) <= samplesPerPixel) {
+        level++;
+    }
+    const std::vector<WaveformBucket>& buckets = m_levels[level];
+    const double bucketSamples = static_cast<double>(int64_t(BASE_BUCKET_SAMPLES) << level);
+    const double startSample = startSeconds * m_sampleRate;
+
+    // Each column spans at most a couple of buckets at the chosen level
+    for (int p = 0; p < pixels; p++) {
+        double from = startSample + p * samplesPerPixel;
+        int64_t first = static_cast<int64_t>(std::floor(from / bucketSamples));
+        int64_t last = std::max(first + 1, static_cast<int64_t>(std::ceil((from + samplesPerPixel) / bucketSamples)));
+        first = std::max<int64_t>(first, 0);
+        last = std::min<int64_t>(last, buckets.size());
+        if (first >= last) {
+            continue;
+        }
+        WaveformBucket column = buckets[first];
+        float squares = column.rms * column.rms;
+        for (int64_t b = first + 1; b < last; b++) {
+            column.min = std::min(column.min, buckets[b].min);
+            column.max = std::max(column.max, buckets[b].max);
+            squares += buckets[b].rms * buckets[b].rms;
+        }
+        column.rms = std::sqrt(squares / (last - first));
+        columns[p] = column;
+    }
+}
+
+bool WaveformPyramid::save(const std::string& path) const {
+    // Write then rename so a crash never leaves a truncated cache entry behind
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header;
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.sampleRate = m_sampleRate;
+        header.baseBucketSamples = BASE_BUCKET_SAMPLES;
+        header.totalSamples = m_totalSamples;
+        header.levels = levelCount();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const std::vector<WaveformBucket>& level : m_levels) {
+            int64_t size = static_cast<int64_t>(level.size());
+            file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            file.write(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(WaveformBucket));
+        }
+        if (!file) {
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool WaveformPyramid::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.baseBucketSamples != BASE_BUCKET_SAMPLES || header.sampleRate <= 0 || header.levels <= 0) {
+        return false;
+    }
+    std::vector<std::vector<WaveformBucket>> levels(header.levels);
+    int64_t expected = (header.totalSamples + BASE_BUCKET_SAMPLES - 1) / BASE_BUCKET_SAMPLES;
+    for (std::vector<WaveformBucket>& level : levels) {
+        int64_t size = 0;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size != expected) {
+            return false;
+        }
+        level.resize(size);
+        if (!file.read(reinterpret_cast<char*>(level.data()), size * sizeof(WaveformBucket))) {
+            return false;
+        }
+        expected = (expected + 1) / 2;
+    }
+    m_sampleRate = header.sampleRate;
+    m_totalSamples = header.totalSamples;
+    m_levels = std::move(levels);
+    return true;
+}
+
+WaveformAnalyzer::WaveformAnalyzer()
+    : m_sampleRate(0), m_totalSamples(0), m_chunkSamples(0), m_chunkCount(0), m_fromCache(false),
+      m_stop(false), m_finished(false), m_nextChunk(0), m_samplesScanned(0), m_activeWorkers(0) {
+}
+
+WaveformAnalyzer::~WaveformAnalyzer() {
+    stop();
+}
+
+bool WaveformAnalyzer::start(const std::string& filePath, const WaveformOptions& options) {
+    stop();
+    m_stop = false;
+    m_finished = false;
+    m_fromCache = false;
+    m_nextChunk = 0;
+    m_samplesScanned = 0;
+    m_chunksComplete = 0;
+    m_filePath = filePath;
+
+    {
+        AudioScanner probe;
+        if (!probe.open(filePath, true)) {
+            return false;
+        }
+        m_sampleRate = probe.sampleRate();
+        m_totalSamples = probe.totalSamples();
+    }
+    if (m_sampleRate <= 0 || m_totalSamples <= 0) {
+        std::cerr << "Waveform: no audio duration for " << filePath << std::endl;
+        return false;
+    }
+
+    m_cachePath.clear();
+    std::string cacheDir = options.cacheDir.empty() ? mediaCacheDir("waveforms") : options.cacheDir;
+    if (!cacheDir.empty()) {
+        int32_t layout[1] = {WaveformPyramid::BASE_BUCKET_SAMPLES};
+        m_cachePath = mediaCachePath(cacheDir, filePath, layout, sizeof(layout), ".wave");
+    }
+    if (!m_cachePath.empty() && m_pyramid.load(m_cachePath)) {
+        m_fromCache = true;
+        m_finished = true;
+        return true;
+    }
+
+    const int64_t bucketCount = (m_totalSamples + WaveformPyramid::BASE_BUCKET_SAMPLES - 1) /
+                                WaveformPyramid::BASE_BUCKET_SAMPLES;
+    m_base.assign(bucketCount, WaveformBucket());
+    m_chunkSamples = CHUNK_BUCKETS * WaveformPyramid::BASE_BUCKET_SAMPLES;
+    m_chunkCount = (m_totalSamples + m_chunkSamples - 1) / m_chunkSamples;
+
+    int workers = options.workers;
+    if (workers <= 0) {
+        // Leave most cores to playback
+        workers = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 4);
+    }
+    workers = static_cast<int>(std::min<int64_t>(workers, m_chunkCount));
+    m_activeWorkers = workers;
+    for (int i = 0; i < workers; i++) {
+        m_workers.emplace_back(&WaveformAnalyzer::run, this, i);
+    }
+    return true;
+}
+
+void WaveformAnalyzer::stop() {
+    m_stop = true;
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+}
+
+double WaveformAnalyzer::progress() const {
+    if (m_finished) {
+        return 1.0;
+    }
+    return m_totalSamples > 0 ? std::min(1.0, static_cast<double>(m_samplesScanned) / m_totalSamples) : 0.0;
+}
+
+void WaveformAnalyzer::run(int worker) {
+    Tracer::instance().setThreadName("waveform-" + std::to_string(worker));
+    AudioScanner scanner;
+    if (scanner.open(m_filePath, true, [this] { return m_stop.load(); })) {
+        for (int64_t chunk = m_nextChunk++; chunk < m_chunkCount && !m_stop; chunk = m_nextChunk++) {
+            if (scanChunk(scanner, chunk)) {
+                m_chunksComplete++;
+            }
+        }
+    }
+    // The last worker out builds the pyramid
+    if (--m_activeWorkers == 0 && !m_stop) {
+        finish();
+    }
+}
+
+bool WaveformAnalyzer::scanChunk(AudioScanner& scanner, int64_t chunk) {
+    const int64_t bucketSamples = WaveformPyramid::BASE_BUCKET_SAMPLES;
+    const int64_t begin = chunk * m_chunkSamples;
+    const int64_t end = std::min(begin + m_chunkSamples, m_totalSamples);
+    int64_t position = begin;
+    SampleStats stats;
+
+    auto flush = [&]() {
+        size_t index = static_cast<size_t>((position - 1) / bucketSamples);
+        if (stats.count > 0 && index < m_base.size()) {
+            m_base[index].min = stats.min;
+            m_base[index].max = stats.max;
+            m_base[index].rms = static_cast<float>(std::sqrt(stats.sumSquares / stats.count));
+        }
+        stats = SampleStats();
+    };
+    bool complete = scanner.scan(begin, end, [&](const float* const* planes, int count) {
+        const float* samples = planes[0];
+        int offset = 0;
+        while (offset < count) {
+            int64_t bucketEnd = (position / bucketSamples + 1) * bucketSamples;
+            int take = static_cast<int>(std::min<int64_t>(count - offset, bucketEnd - position));
+            accumulateSampleStats(samples + offset, take, stats);
+            offset += take;
+            position += take;
+            if (position == bucketEnd) {
+                flush();
+            }
+        }
+        m_samplesScanned += count;
+    });
+    // Partial bucket at the end of the file, or where the file ended early
+    flush();
+    // The duration is an estimate, so the last chunk may legitimately run out of file
+    return !m_stop && !scanner.failed() && (complete || chunk == m_chunkCount - 1);
+}
+
+void WaveformAnalyzer::finish() {
+    m_pyramid.build(m_sampleRate, m_totalSamples, std::move(m_base));
+    m_base.clear();
+    // A chunk that failed, or a worker that couldn't open the file, leaves zeroed buckets;
+    // those are shown this time but never cached
+    bool complete = m_chunksComplete == m_chunkCount && m_samplesScanned > 0;
+    if (complete && !m_cachePath.empty() && !m_pyramid.save(m_cachePath)) {
+        std::cerr << "Couldn't write waveform cache " << m_cachePath << std::endl;
+    }
+    m_finished = true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "audio_scanner.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct WaveformBucket {
+    float min = 0.0f;
+    float max = 0.0f;
+    float rms = 0.0f;
+};
+
+// Min/max/RMS of the mono downmix at power-of-two bucket sizes, from BASE_BUCKET_SAMPLES
+// up to the whole file. A query picks the level whose buckets are just finer than a pixel,
+// so drawing costs O(visible pixels) at any zoom.
+class WaveformPyramid {
+public:
+    static constexpr int BASE_BUCKET_SAMPLES = 256;
+
+    // Builds the coarser levels from the finest one
+    void build(int sampleRate, int64_t totalSamples, std::vector<WaveformBucket> base);
+    // One bucket per pixel column for [startSeconds, endSeconds)
+    void query(double startSeconds, double endSeconds, int pixels, std::vector<WaveformBucket>& columns) const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    bool empty() const { return m_levels.empty(); }
+    int sampleRate() const { return m_sampleRate; }
+    int64_t totalSamples() const { return m_totalSamples; }
+    int levelCount() const { return static_cast<int>(m_levels.size()); }
+
+private:
+    int m_sampleRate = 0;
+    int64_t m_totalSamples = 0;
+    std::vector<std::vector<WaveformBucket>> m_levels;
+};
+
+struct WaveformOptions {
+    // Worker decoders; 0 picks from the core count
+    int workers = 0;
+    // Empty uses mediaCacheDir("waveforms"); caching is skipped if there's none
+    std::string cacheDir;
+};
+
+// Builds a WaveformPyramid for a file in the background. The audio is cut into
+// bucket-aligned chunks that worker threads claim one at a time, each seeking its own
+// AudioScanner to the chunk start, so a long file is scanned by all workers at once.
+// The result is cached on disk and reloaded without decoding next time.
+class WaveformAnalyzer {
+public:
+    WaveformAnalyzer();
+    ~WaveformAnalyzer();
+    WaveformAnalyzer (const WaveformAnalyzer &) =delete;
+    WaveformAnalyzer& operator=(const WaveformAnalyzer &) =delete;
+
+    bool start(const std::string& filePath, const WaveformOptions& options = WaveformOptions());
+    void stop();
+
+    bool finished() const { return m_finished.load(); }
+    // Fraction of the audio scanned so far
+    double progress() const;
+    bool loadedFromCache() const { return m_fromCache; }
+    // Only valid once finished()
+    const WaveformPyramid& pyramid() const { return m_pyramid; }
+
+private:
+    void run(int worker);
+    // False if the chunk couldn't be scanned in full
+    bool scanChunk(AudioScanner& scanner, int64_t chunk);
+    void finish();
+
+    std::vector<std::thread> m_workers;
+    std::string m_filePath;
+    std::string m_cachePath;
+    int m_sampleRate;
+    int64_t m_totalSamples;
+    int64_t m_chunkSamples;
+    int64_t m_chunkCount;
+    bool m_fromCache;
+
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_finished;
+    std::atomic<int64_t> m_nextChunk;
+    std::atomic<int64_t> m_samplesScanned;
+    // Only a pyramid built from every chunk is cached
+    std::atomic<int64_t> m_chunksComplete;
+    std::atomic<int> m_activeWorkers;
+    // Chunks write disjoint ranges, so the workers fill it without locking
+    std::vector<WaveformBucket> m_base;
+    WaveformPyramid m_pyramid;
+};
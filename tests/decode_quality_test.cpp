@@ -0,0 +1,83 @@
+#include "decode_quality.hpp"
+#include <iostream>
+
+
+static bool expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << std::endl;
+    }
+    return condition;
+}
+
+// Feeds `seconds` of frames lasting `frameSeconds` each; returns how many level changes came back
+static int play(DecodeQualityController& quality, double seconds, double frameSeconds, bool missed) {
+    int changes = 0;
+    for (double t = 0.0; t < seconds - 1e-9; t += frameSeconds) {
+        if (quality.record(missed, frameSeconds)) {
+            changes++;
+        }
+    }
+    return changes;
+}
+
+static void degradeTo(DecodeQualityController& quality, DecodeQuality level) {
+    while (quality.level() != level) {
+        play(quality, DecodeQualityController::WINDOW_SECONDS, 1.0 / 30.0, true);
+    }
+}
+
+int main() {
+    const double frame = 1.0 / 30.0;
+    const double restoreSeconds = DecodeQualityController::RESTORE_WINDOWS * DecodeQualityController::WINDOW_SECONDS;
+    bool ok = true;
+
+    {
+        DecodeQualityController quality;
+        ok = expect(play(quality, 10.0, frame, false) == 0 && quality.level() == DecodeQuality::Full,
+                    "clean playback stays at full quality") && ok;
+        ok = expect(play(quality, DecodeQualityController::WINDOW_SECONDS, frame, true) == 1 &&
+                    quality.level() == DecodeQuality::SkipLoopFilter, "one missed window degrades one level") && ok;
+    }
+
+    {
+        // A miss rate at the threshold isn't enough
+        DecodeQualityController quality;
+        for (int i = 0; i < 60; i++) {
+            quality.record(i % 20 == 0, frame);
+        }
+        ok = expect(quality.level() == DecodeQuality::Full, "5% misses are tolerated") && ok;
+    }
+
+    {
+        // At one frame per two-second GOP a window is a single frame, so recovery takes the
+        // same playback time as at full rate instead of minutes
+        DecodeQualityController quality;
+        degradeTo(quality, DecodeQuality::KeyframesOnly);
+        play(quality, restoreSeconds, 2.0, false);
+        ok = expect(quality.level() == DecodeQuality::SkipNonRef, "keyframes-only restores after clean windows") && ok;
+    }
+
+    {
+        // A restore that fails straight away doubles the clean time asked for next
+        DecodeQualityController quality;
+        degradeTo(quality, DecodeQuality::SkipIdct);
+        play(quality, restoreSeconds, frame, false);
+        ok = expect(quality.level() == DecodeQuality::SkipLoopFilter, "restored one level") && ok;
+        play(quality, DecodeQualityController::WINDOW_SECONDS, frame, true);
+        ok = expect(quality.level() == DecodeQuality::SkipIdct, "failed restore degrades again") && ok;
+        play(quality, restoreSeconds, frame, false);
+        ok = expect(quality.level() == DecodeQuality::SkipIdct, "next restore waits longer") && ok;
+        play(quality, restoreSeconds, frame, false);
+        ok = expect(quality.level() == DecodeQuality::SkipLoopFilter, "restores after the doubled wait") && ok;
+    }
+
+    {
+        DecodeQualityController quality;
+        degradeTo(quality, DecodeQuality::SkipNonRef);
+        quality.reset();
+        ok = expect(quality.level() == DecodeQuality::Full, "reset returns to full quality") && ok;
+    }
+
+    std::cerr << (ok ? "PASS" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
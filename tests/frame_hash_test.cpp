@@ -0,0 +1,50 @@
+#include "frame_hash.hpp"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+static uint64_t xxh64(const std::string& text, uint64_t seed = 0) {
+    Xxh64 hasher(seed);
+    hasher.update(text.data(), text.size());
+    return hasher.digest();
+}
+
+static bool expectHash(uint64_t actual, uint64_t expected, const char* what) {
+    if (actual != expected) {
+        std::cerr << "FAIL: " << what << ": " << std::hex << actual << ", expected " << expected << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    // Reference XXH64 vectors: the short-input tail paths, and past 32 bytes the four lanes
+    ok = expectHash(xxh64(""), 0xEF46DB3751D8E999ULL, "empty input, seed 0") && ok;
+    ok = expectHash(xxh64("a"), 0xD24EC4F1A98C6E5BULL, "\"a\"") && ok;
+    ok = expectHash(xxh64("abc"), 0x44BC2CF5AD770999ULL, "\"abc\"") && ok;
+    ok = expectHash(xxh64("Nobody inspects the spammish repetition"), 0xFBCEA83C8A378BF1ULL,
+                    "39 bytes through the lanes") && ok;
+
+    // Streaming in uneven pieces, as hashImage() does row by row, matches one call
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    Xxh64 whole(12345);
+    whole.update(data.data(), data.size());
+    Xxh64 pieces(12345);
+    size_t offset = 0;
+    for (size_t piece = 1; offset < data.size(); piece = piece * 3 % 61 + 1) {
+        size_t size = std::min(piece, data.size() - offset);
+        pieces.update(data.data() + offset, size);
+        offset += size;
+    }
+    ok = expectHash(pieces.digest(), whole.digest(), "streamed in pieces") && ok;
+
+    std::cerr << (ok ? "PASS" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
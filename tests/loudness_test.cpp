@@ -0,0 +1,99 @@
+#include "loudness.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+// Conformance checks after EBU Tech 3341's minimum requirements. The reference signals are
+// plain tone sequences, so they are synthesised here rather than read from the WAV files.
+namespace {
+
+constexpr int SAMPLE_RATE = 48000;
+// Tech 3341 tolerances: +-0.1 LU for loudness, +0.2/-0.4 dB for true peak
+constexpr double LOUDNESS_TOLERANCE = 0.1;
+constexpr double TRUE_PEAK_OVER = 0.2;
+constexpr double TRUE_PEAK_UNDER = 0.4;
+
+struct Segment {
+    double seconds;
+    double levelDbfs;
+};
+
+// Stereo sine sequence, the same tone on both channels, at peak levels in dBFS
+LoudnessResult measure(const std::vector<Segment>& segments, double frequency = 1000.0, double phase = 0.0) {
+    AVChannelLayout layout;
+    av_channel_layout_default(&layout, 2);
+    LoudnessMeter meter(SAMPLE_RATE, layout);
+
+    const int chunk = SAMPLE_RATE / 10;
+    std::vector<float> left(chunk);
+    std::vector<float> right(chunk);
+    const float* planes[2] = {left.data(), right.data()};
+    const double pi = 3.14159265358979323846;
+    int64_t position = 0;
+    for (const Segment& segment : segments) {
+        const double amplitude = std::pow(10.0, segment.levelDbfs / 20.0);
+        int64_t remaining = std::llround(segment.seconds * SAMPLE_RATE);
+        while (remaining > 0) {
+            int count = static_cast<int>(std::min<int64_t>(chunk, remaining));
+            for (int i = 0; i < count; i++) {
+                double t = static_cast<double>(position + i) / SAMPLE_RATE;
+                left[i] = static_cast<float>(amplitude * std::sin(2.0 * pi * frequency * t + phase));
+                right[i] = left[i];
+            }
+            meter.process(planes, count);
+            position += count;
+            remaining -= count;
+        }
+    }
+    LoudnessResult result;
+    meter.finish(result);
+    return result;
+}
+
+bool expectNear(double value, double expected, double under, double over, const char* what) {
+    bool ok = value >= expected - under && value <= expected + over;
+    if (!ok) {
+        std::cerr << "FAIL: " << what << ": " << value << ", expected " << expected << std::endl;
+    }
+    return ok;
+}
+
+bool expectLoudness(double value, double expected, const char* what) {
+    return expectNear(value, expected, LOUDNESS_TOLERANCE, LOUDNESS_TOLERANCE, what);
+}
+
+}
+
+int main() {
+    bool ok = true;
+
+    // Cases 1 and 2: steady 1 kHz tones; every measure reads the tone's level
+    LoudnessResult steady = measure({{20.0, -23.0}});
+    ok = expectLoudness(steady.integratedLufs, -23.0, "case 1 integrated") && ok;
+    ok = expectLoudness(steady.maxMomentaryLufs, -23.0, "case 1 momentary") && ok;
+    ok = expectLoudness(steady.maxShortTermLufs, -23.0, "case 1 short-term") && ok;
+    ok = expectLoudness(measure({{20.0, -33.0}}).integratedLufs, -33.0, "case 2 integrated") && ok;
+
+    // Case 3: the relative gate leaves out the quieter passages
+    ok = expectLoudness(measure({{10.0, -36.0}, {60.0, -23.0}, {10.0, -36.0}}).integratedLufs, -23.0,
+                        "case 3 relative gate") && ok;
+    // Case 4: the absolute gate leaves out near-silence
+    ok = expectLoudness(measure({{10.0, -72.0}, {10.0, -36.0}, {60.0, -23.0}, {10.0, -36.0}, {10.0, -72.0}}).integratedLufs,
+                        -23.0, "case 4 absolute gate") && ok;
+    // Case 5: both passages pass the gates and are power-averaged
+    ok = expectLoudness(measure({{20.0, -26.0}, {20.1, -20.0}, {20.0, -26.0}}).integratedLufs, -23.0,
+                        "case 5 gated average") && ok;
+
+    // True peak: an fs/4 tone sampled 45 degrees off its crests peaks 3 dB above its samples
+    const double sampleLevel = -6.0;
+    double truePeak = measure({{1.0, sampleLevel + 20.0 * std::log10(std::sqrt(2.0))}}, SAMPLE_RATE / 4.0,
+                              3.14159265358979323846 / 4.0).truePeakDbtp;
+    ok = expectNear(truePeak, sampleLevel + 3.01, TRUE_PEAK_UNDER, TRUE_PEAK_OVER, "inter-sample true peak") && ok;
+    // ... and a tone well inside the band reads its own peak
+    ok = expectNear(measure({{1.0, -6.0}}, 997.0).truePeakDbtp, -6.0, TRUE_PEAK_UNDER, TRUE_PEAK_OVER,
+                    "1 kHz true peak") && ok;
+
+    std::cerr << (ok ? "PASS" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include "metrics_exporter.hpp"
+#include "profiler.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+
+
+static bool expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << std::endl;
+    }
+    return condition;
+}
+
+// Histogram series carry the family name plus one of these suffixes
+static std::string familyOf(const std::string& name, const std::set<std::string>& histograms) {
+    for (const char* suffix : {"_bucket", "_sum", "_count"}) {
+        std::string s(suffix);
+        if (name.size() > s.size() && name.compare(name.size() - s.size(), s.size(), s) == 0) {
+            std::string family = name.substr(0, name.size() - s.size());
+            if (histograms.count(family)) {
+                return family;
+            }
+        }
+    }
+    return name;
+}
+
+int main() {
+    // Past 2^53 a double can't hold every integer, so a value that went through one changes
+    const uint64_t bigCounter = (1ULL << 53) + 1;
+    Profiler& profiler = Profiler::instance();
+    profiler.increment(Counter::IoBytesRead, bigCounter);
+    profiler.setGauge(Gauge::AudioDriftPpm, -12345678901LL);
+    profiler.record(Stage::Decode, 3000000);
+    profiler.record(Stage::Decode, 2000000000);
+
+    std::istringstream text(MetricsExporter::render());
+    std::set<std::string> helped;
+    std::map<std::string, std::string> types;
+    std::map<std::string, std::string> samples;
+    std::set<std::string> histograms;
+    bool ok = true;
+    std::string line;
+    while (std::getline(text, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        if (line[0] == '#') {
+            std::string hash, keyword, name, rest;
+            fields >> hash >> keyword >> name;
+            std::getline(fields, rest);
+            if (keyword == "HELP") {
+                ok = expect(!rest.empty(), "help text for " + name) && ok;
+                helped.insert(name);
+            } else if (keyword == "TYPE") {
+                ok = expect(rest == " counter" || rest == " gauge" || rest == " histogram",
+                            "known type for " + name) && ok;
+                types[name] = rest.substr(1);
+                if (types[name] == "histogram") {
+                    histograms.insert(name);
+                }
+            }
+            continue;
+        }
+
+        // name{labels} value
+        size_t space = line.rfind(' ');
+        if (!expect(space != std::string::npos, "sample has a value: " + line)) {
+            ok = false;
+            continue;
+        }
+        std::string series = line.substr(0, space);
+        std::string value = line.substr(space + 1);
+        std::string name = series.substr(0, series.find('{'));
+        std::string family = familyOf(name, histograms);
+        ok = expect(helped.count(family) && types.count(family), "HELP and TYPE precede " + name) && ok;
+        char* end = nullptr;
+        std::strtod(value.c_str(), &end);
+        ok = expect(!value.empty() && *end == '\0', "numeric value for " + series + ": " + value) && ok;
+        if (types[family] == "counter" && name != "mp_io_wait_seconds_total") {
+            ok = expect(value.find_first_not_of("0123456789") == std::string::npos,
+                        "integer counter " + series + ": " + value) && ok;
+        }
+        samples[series] = value;
+    }
+
+    ok = expect(samples["mp_io_read_bytes_total"] == std::to_string(bigCounter),
+                "exact counter, got " + samples["mp_io_read_bytes_total"]) && ok;
+    ok = expect(samples["mp_audio_clock_drift_ppm"] == "-12345678901",
+                "exact negative gauge, got " + samples["mp_audio_clock_drift_ppm"]) && ok;
+
+    // Cumulative buckets never decrease and end at the count
+    const std::string decode = "stage=\"" + std::string(stageName(Stage::Decode)) + "\"";
+    uint64_t previous = 0;
+    for (double bound : LATENCY_BUCKETS) {
+        std::ostringstream series;
+        series << "mp_stage_duration_seconds_bucket{" << decode << ",le=\"" << bound << "\"}";
+        uint64_t count = std::strtoull(samples[series.str()].c_str(), nullptr, 10);
+        ok = expect(count >= previous, "cumulative bucket " + series.str()) && ok;
+        previous = count;
+    }
+    const std::string inf = samples["mp_stage_duration_seconds_bucket{" + decode + ",le=\"+Inf\"}"];
+    const std::string count = samples["mp_stage_duration_seconds_count{" + decode + "}"];
+    ok = expect(previous == 1, "the 3 ms sample is in the last finite bucket, the 2 s one isn't") && ok;
+    ok = expect(inf == "2" && count == "2", "+Inf bucket equals the count") && ok;
+
+    std::cerr << (ok ? "PASS" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include "frame_cache.hpp"
+#include "media_generator.hpp"
+#include "trick_play.hpp"
+#include "video_decoder.hpp"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+
+// Frame index drawn into the picture the decoder currently holds
+static int64_t decodedIndex(MPDecoder& decoder) {
+    const AVFrame* frame = decoder.getDecodedFrame();
+    return frame && frame->data[0] ? readFrameIndex(frame) : -1;
+}
+
+static bool expect(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAIL: " << what << std::endl;
+    }
+    return condition;
+}
+
+// Pausing during reverse playback and stepping must move one frame from the frame on
+// screen, not from where the main decoder was left when reverse playback began.
+static bool stepAfterReverse(const std::string& path, int fps) {
+    MPDecoder decoder;
+    if (!expect(decoder.open(path), "open")) {
+        return false;
+    }
+    decoder.setFrameCacheBudget(FrameCache::DEFAULT_BYTE_BUDGET);
+    TrickPlay trickPlay(decoder);
+
+    double delay = 0.0;
+    for (int i = 0; i < 3 * fps; i++) {
+        if (!expect(trickPlay.nextFrame(delay), "forward playback")) {
+            return false;
+        }
+    }
+
+    // The reverse worker decodes in the background; give it time to catch up
+    trickPlay.setRate(-1.0);
+    int shownBackwards = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (shownBackwards < fps && std::chrono::steady_clock::now() < deadline) {
+        if (trickPlay.nextFrame(delay)) {
+            shownBackwards++;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    if (!expect(shownBackwards == fps, "reverse playback")) {
+        return false;
+    }
+
+    const int64_t shown = std::llround(decoder.ptsToSeconds(trickPlay.displayPts()) * fps);
+    bool ok = expect(trickPlay.step(1), "step forward after reverse");
+    ok = ok && expect(decodedIndex(decoder) == shown + 1, "step forward lands after the frame on screen");
+    ok = ok && expect(trickPlay.step(-1), "step backward");
+    ok = ok && expect(decodedIndex(decoder) == shown, "step backward returns to the frame on screen");
+    return ok;
+}
+
+// Dropping the cache after stepping back, as unpausing does, must not let playback jump to
+// where the codec was left by the step.
+static bool playAfterStepBack(const std::string& path, int fps) {
+    MPDecoder decoder;
+    if (!expect(decoder.open(path), "open")) {
+        return false;
+    }
+    decoder.setFrameCacheBudget(FrameCache::DEFAULT_BYTE_BUDGET);
+    for (int i = 0; i < fps; i++) {
+        if (!expect(decoder.decodeFrame(), "forward playback")) {
+            return false;
+        }
+    }
+    if (!expect(decoder.stepBackward() && decoder.stepBackward(), "step backward")) {
+        return false;
+    }
+    const int64_t shown = decodedIndex(decoder);
+    decoder.setFrameCacheBudget(0);
+    bool ok = expect(decoder.decodeFrame(), "play after dropping the cache");
+    ok = ok && expect(decodedIndex(decoder) == shown + 1, "playback continues after the frame on screen");
+    return ok;
+}
+
+int main() {
+    MediaGeneratorOptions options;
+    options.width = 320;
+    options.height = 240;
+    options.durationSeconds = 5.0;
+    options.audioChannels = 0;
+    options.outputPath = (std::filesystem::temp_directory_path() / "mp_test_trick_play.mkv").string();
+    // generateMedia only puts finished clips under this name, so one left by an earlier run is reused
+    if (!std::filesystem::exists(options.outputPath) && !generateMedia(options)) {
+        std::cerr << "Couldn't generate the test clip." << std::endl;
+        return 1;
+    }
+
+    bool ok = stepAfterReverse(options.outputPath, options.fps);
+    ok = playAfterStepBack(options.outputPath, options.fps) && ok;
+    std::cerr << (ok ? "PASS" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
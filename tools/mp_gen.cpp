@@ -0,0 +1,117 @@
+#include "command_line.hpp"
+#include "media_generator.hpp"
+extern "C" {
+    #include <libavutil/log.h>
+}
+#include <iostream>
+#include <sstream>
+#include <string>
+
+
+static void printUsage() {
+    std::cerr << "usage: mp_gen <output> [options]\n"
+              << "  --duration S         clip length in seconds (10)\n"
+              << "  --size WxH           frame size (1280x720)\n"
+              << "  --fps N              nominal frame rate (30)\n"
+              << "  --vcodec NAME        video encoder (mpeg4)\n"
+              << "  --pix-fmt NAME       encoder pixel format (yuv420p)\n"
+              << "  --gop N              keyframe interval in frames (30)\n"
+              << "  --bframes N          max consecutive B-frames (0)\n"
+              << "  --vfr A,B,...        frame durations in 1/fps units, repeated\n"
+              << "  --channels N         audio channels, 0 for no audio (2)\n"
+              << "  --rate HZ            audio sample rate (48000)\n"
+              << "  --acodec NAME        audio encoder (aac)\n"
+              << "  --tone HZ            tone burst frequency (1000)\n"
+              << "  --burst MS           tone burst length at the start of every second (100)\n";
+}
+
+int main(int argc, char** argv) {
+    MediaGeneratorOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--duration" && hasValue) {
+            if (!parseNumber(argv[++i], options.durationSeconds, 0.001, 24.0 * 3600.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--size" && hasValue) {
+            std::string size = argv[++i];
+            size_t separator = size.find('x');
+            if (separator == std::string::npos ||
+                !parseNumber(size.substr(0, separator).c_str(), options.width, 16, 8192) ||
+                !parseNumber(size.substr(separator + 1).c_str(), options.height, 16, 8192)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--fps" && hasValue) {
+            if (!parseNumber(argv[++i], options.fps, 1, 1000)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--vcodec" && hasValue) {
+            options.videoCodec = argv[++i];
+        } else if (arg == "--pix-fmt" && hasValue) {
+            options.pixelFormat = argv[++i];
+        } else if (arg == "--gop" && hasValue) {
+            if (!parseNumber(argv[++i], options.gopSize, 0, 10000)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--bframes" && hasValue) {
+            if (!parseNumber(argv[++i], options.maxBFrames, 0, 16)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--vfr" && hasValue) {
+            std::istringstream pattern(argv[++i]);
+            std::string duration;
+            int frames;
+            while (std::getline(pattern, duration, ',')) {
+                if (!parseNumber(duration.c_str(), frames, 1, 1000)) {
+                    printUsage();
+                    return -1;
+                }
+                options.vfrPattern.push_back(frames);
+            }
+        } else if (arg == "--channels" && hasValue) {
+            if (!parseNumber(argv[++i], options.audioChannels, 0, 8)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--rate" && hasValue) {
+            if (!parseNumber(argv[++i], options.sampleRate, 8000, 192000)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--acodec" && hasValue) {
+            options.audioCodec = argv[++i];
+        } else if (arg == "--tone" && hasValue) {
+            if (!parseNumber(argv[++i], options.toneHz, 1.0, 20000.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (arg == "--burst" && hasValue) {
+            if (!parseNumber(argv[++i], options.burstMs, 0.0, 1000.0)) {
+                printUsage();
+                return -1;
+            }
+        } else if (options.outputPath.empty() && arg[0] != '-') {
+            options.outputPath = arg;
+        } else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (options.outputPath.empty()) {
+        printUsage();
+        return -1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    if (!generateMedia(options)) {
+        std::cerr << "Failed to generate " << options.outputPath << std::endl;
+        return -1;
+    }
+    return 0;
+}